@@ -1,111 +1,180 @@
 #include <chrono>
+#include <cmath>
 #include <iostream>
+#include <optional>
+#include <seagull/cube.h>
 #include <seagull/seagull.h>
+#include <seagull/voxel.h>
 
 using namespace seagull;
 
-enum class CubeTextureType {
-  SIDES,
-  TOP_BOTTOM_SIDES,
-  TOP_BOTTOM_FRONT_BACK_LEFT_RIGHT,
-};
+// The world is WORLD_CHUNKS x WORLD_CHUNKS chunks across.
+static constexpr unsigned WORLD_CHUNKS = 16;
+static constexpr unsigned WORLD_SIZE = WORLD_CHUNKS * VoxelChunk::SIZE;
+// Where the corner of the first chunk is in the world.
+static constexpr Point3d WORLD_ORIGIN = {-(float)WORLD_SIZE / 2, -20, 0};
 
-static TexturedMesh generateCubeMesh(Image image, CubeTextureType textureType) {
-  Mesh mesh;
-  mesh.addQuad({-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1}); // front
-  mesh.addQuad({-1, -1, 1}, {-1, -1, 1}, {1, 1, 1}, {-1, 1, 1});    // back
-  mesh.addQuad({-1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {-1, 1, -1}); // left
-  mesh.addQuad({1, -1, -1}, {1, -1, 1}, {1, 1, 1}, {1, 1, -1}); // left
-  mesh.addQuad({-1, 1, -1}, {1, 1, -1}, {1, 1, 1}, {-1, 1, 1});     // top
-  mesh.addQuad({-1, -1, -1}, {-1, -1, 1}, {1, -1, 1}, {1, -1, -1}); // bottom
-  // Now we have to make a texture which matches the above cube (the sides have
-  // to be in the same order).
-  Texture texture(std::move(image));
-  switch (textureType) {
-  case CubeTextureType::SIDES: {
-    texture.addQuad({0, 1}, {1, 1}, {1, 0}, {0, 0}); // front
-    texture.addQuad({0, 1}, {1, 1}, {1, 0}, {0, 0}); // back
-    texture.addQuad({0, 1}, {1, 1}, {1, 0}, {0, 0}); // left
-    texture.addQuad({0, 1}, {1, 1}, {1, 0}, {0, 0}); // right
-    texture.addQuad({0, 1}, {1, 1}, {1, 0}, {0, 0}); // top
-    texture.addQuad({0, 1}, {1, 1}, {1, 0}, {0, 0}); // bottom
-    break;
-  }
-  case CubeTextureType::TOP_BOTTOM_SIDES: {
-    // The image is divided into vertical thirds: top, sides, bottom. The sides
-    // are the front, back, left and right.
-    static constexpr float ONE_THIRD = 1.0f / 3.0f;
-    static constexpr float TWO_THIRDS = 2.0f / 3.0f;
-    texture.addQuad({0, TWO_THIRDS}, {1, TWO_THIRDS}, {1, ONE_THIRD},
-                    {0, ONE_THIRD}); // front
-    texture.addQuad({0, TWO_THIRDS}, {1, TWO_THIRDS}, {1, ONE_THIRD},
-                    {0, ONE_THIRD}); // back
-    texture.addQuad({0, TWO_THIRDS}, {1, TWO_THIRDS}, {1, ONE_THIRD},
-                    {0, ONE_THIRD}); // left
-    texture.addQuad({0, TWO_THIRDS}, {1, TWO_THIRDS}, {1, ONE_THIRD},
-                    {0, ONE_THIRD});                                   // right
-    texture.addQuad({0, ONE_THIRD}, {1, ONE_THIRD}, {1, 0}, {0, 0});   // top
-    texture.addQuad({0, 1}, {1, 1}, {1, TWO_THIRDS}, {0, TWO_THIRDS}); // bottom
-    break;
-  }
-  case CubeTextureType::TOP_BOTTOM_FRONT_BACK_LEFT_RIGHT: {
-    // The image is divided into thirds vertically and quarters horizontally. It
-    // is layed out like a cube net: _t__ lfrb _b__ Where t is the top, l is the
-    // left, f is the front, r is the right, b is the back and b is also the
-    // bottom (you can probably figure it out though).
-    static constexpr float ONE_THIRD = 1.0f / 3.0f;
-    static constexpr float TWO_THIRDS = 2.0f / 3.0f;
-    static constexpr float ONE_QUARTER = 1.0f / 4.0f;
-    static constexpr float TWO_QUARTERS = 2.0f / 4.0f;
-    static constexpr float THREE_QUARTERS = 3.0f / 4.0f;
-    texture.addQuad({ONE_QUARTER, TWO_THIRDS}, {TWO_QUARTERS, TWO_THIRDS},
-                    {TWO_QUARTERS, ONE_THIRD},
-                    {ONE_QUARTER, ONE_THIRD}); // front
-    texture.addQuad({THREE_QUARTERS, TWO_THIRDS}, {1, TWO_THIRDS},
-                    {1, ONE_THIRD}, {THREE_QUARTERS, ONE_THIRD}); // back
-    texture.addQuad({0, TWO_THIRDS}, {ONE_QUARTER, TWO_THIRDS},
-                    {ONE_QUARTER, ONE_THIRD}, {0, ONE_THIRD}); // left
-    texture.addQuad({TWO_QUARTERS, TWO_THIRDS}, {THREE_QUARTERS, TWO_THIRDS},
-                    {THREE_QUARTERS, ONE_THIRD},
-                    {TWO_QUARTERS, ONE_THIRD}); // right
-    texture.addQuad({ONE_QUARTER, ONE_THIRD}, {TWO_QUARTERS, ONE_THIRD},
-                    {TWO_QUARTERS, 0}, {ONE_QUARTER, 0}); // top
-    texture.addQuad({ONE_QUARTER, 1}, {TWO_QUARTERS, 1},
-                    {TWO_QUARTERS, TWO_THIRDS},
-                    {ONE_QUARTER, TWO_THIRDS}); // bottom
-    break;
-  }
+// Some gently rolling hills, made entirely of grass.
+static std::vector<VoxelChunk> generateTerrain(BlockId grass) {
+  std::vector<VoxelChunk> chunks(WORLD_CHUNKS * WORLD_CHUNKS);
+  for (unsigned x = 0; x < WORLD_SIZE; x++) {
+    for (unsigned z = 0; z < WORLD_SIZE; z++) {
+      unsigned height = 4 + (unsigned)(3 * (std::sin(x * 0.1f) + 1) +
+                                       3 * (std::cos(z * 0.13f) + 1));
+      VoxelChunk &chunk = chunks[(z / VoxelChunk::SIZE) * WORLD_CHUNKS +
+                                 x / VoxelChunk::SIZE];
+      for (unsigned y = 0; y < height; y++) {
+        chunk.set(x % VoxelChunk::SIZE, y, z % VoxelChunk::SIZE, grass);
+      }
+    }
   }
-  return TexturedMesh(std::move(mesh), std::move(texture));
+  return chunks;
 }
 
 int main() {
   try {
+    auto grassImage = std::make_shared<const Image>(
+        loadPngImage("assets/digbuild/grass.png"));
+    // Each chunk is drawn as three meshes (its tops, its sides and its
+    // bottoms), with the hidden faces left out. Each has a palette whose
+    // blocks use the whole of its image, so that neighbouring faces merge in
+    // both directions.
+    struct ChunkLayer {
+      BlockPalette palette;
+      ChunkFaces faces;
+      BlockId grass;
+    };
+    auto createLayer = [](const char *fileName, ChunkFaces faces) {
+      BlockPalette palette(
+          std::make_shared<const Image>(loadPngImage(fileName)));
+      BlockId grass = palette.addBlockType(CubeTextureType::SIDES);
+      return ChunkLayer{std::move(palette), faces, grass};
+    };
+    const ChunkLayer layers[] = {
+        createLayer("assets/digbuild/grassTop.png",
+                    {false, false, false, false, true, false}),
+        createLayer("assets/digbuild/grassSides.png",
+                    {true, true, true, true, false, false}),
+        createLayer("assets/digbuild/grassBottom.png",
+                    {false, false, false, false, false, true}),
+    };
+    // Each palette only has grass, so it has the same id in all of them.
+    std::vector<VoxelChunk> chunks = generateTerrain(layers[0].grass);
+    auto chunkAt = [&](unsigned x, unsigned z) -> const VoxelChunk * {
+      if (x >= WORLD_CHUNKS || z >= WORLD_CHUNKS) {
+        return nullptr; // Also catches -1, since these are unsigned
+      }
+      return &chunks[z * WORLD_CHUNKS + x];
+    };
+    // The chunk meshing jobs use the chunks and the palettes, and the game
+    // waits for any which are still running when it is destroyed, so it has
+    // to be destroyed first.
     Game game;
-    auto &grassCubeTemplate = game.createGameObject(
-        generateCubeMesh(loadPngImage("assets/digbuild/grass.png"),
-                         CubeTextureType::TOP_BOTTOM_SIDES),
-        false);
+    // Nothing reads the meshes back, so there's no need for a second copy of
+    // every chunk.
+    game.setRetainMeshData(false);
+    // Every corner of a chunk's faces is on a texture seam, so the
+    // simplifier can't collapse anything. Working that out for every chunk
+    // is a waste of time.
+    game.setGenerateLods(false);
+    auto grassCubeTemplate = game.createGameObject(
+        createCubeMesh(grassImage, CubeTextureType::TOP_BOTTOM_SIDES), false);
     grassCubeTemplate.setTranslateZ(5);
-    auto &grass1 = game.duplicateGameObject(grassCubeTemplate);
+    auto grass1 = game.duplicateGameObject(grassCubeTemplate);
     grass1.setTranslateX(2);
-    auto &grass2 = game.duplicateGameObject(grassCubeTemplate);
+    auto grass2 = game.duplicateGameObject(grassCubeTemplate);
     grass2.setTranslateX(-2);
+
+    // The chunks are meshed in the background, and each one appears as soon
+    // as it is ready. The grass cubes above are there in the meantime.
+    for (unsigned chunkZ = 0; chunkZ < WORLD_CHUNKS; chunkZ++) {
+      for (unsigned chunkX = 0; chunkX < WORLD_CHUNKS; chunkX++) {
+        for (const ChunkLayer &layer : layers) {
+          game.loadGameObject(
+              [&, chunkX, chunkZ]() {
+                ChunkNeighbours neighbours{};
+                neighbours[(unsigned)CubeFace::FRONT] =
+                    chunkAt(chunkX, chunkZ - 1);
+                neighbours[(unsigned)CubeFace::BACK] =
+                    chunkAt(chunkX, chunkZ + 1);
+                neighbours[(unsigned)CubeFace::LEFT] =
+                    chunkAt(chunkX - 1, chunkZ);
+                neighbours[(unsigned)CubeFace::RIGHT] =
+                    chunkAt(chunkX + 1, chunkZ);
+                return meshChunk(*chunkAt(chunkX, chunkZ), layer.palette,
+                                 neighbours, layer.faces);
+              },
+              true,
+              [chunkX, chunkZ](GameObject &chunkObject) {
+                chunkObject.setTranslateX((float)chunkX * VoxelChunk::SIZE +
+                                          WORLD_ORIGIN.x);
+                chunkObject.setTranslateY(WORLD_ORIGIN.y);
+                chunkObject.setTranslateZ((float)chunkZ * VoxelChunk::SIZE +
+                                          WORLD_ORIGIN.z);
+              });
+        }
+      }
+    }
+    // Which blocks are solid, for picking the one under the crosshair
+    // without going anywhere near the meshes.
+    VoxelGrid grid(WORLD_SIZE, VoxelChunk::SIZE, WORLD_SIZE);
+    for (unsigned chunkZ = 0; chunkZ < WORLD_CHUNKS; chunkZ++) {
+      for (unsigned chunkX = 0; chunkX < WORLD_CHUNKS; chunkX++) {
+        grid.setChunk(chunkX * VoxelChunk::SIZE, 0, chunkZ * VoxelChunk::SIZE,
+                      *chunkAt(chunkX, chunkZ));
+      }
+    }
+    // The camera sits at the origin looking down the z axis, so this is a
+    // little below the middle of the screen.
+    static constexpr Point3d CROSSHAIR_DIRECTION = {0, -0.5f, 1};
+    auto printPickedBlock = [&]() {
+      Ray ray{{-WORLD_ORIGIN.x, -WORLD_ORIGIN.y, -WORLD_ORIGIN.z},
+              CROSSHAIR_DIRECTION};
+      static constexpr const char *FACE_NAMES[] = {
+          "front", "back", "left", "right", "top", "bottom"};
+      if (std::optional<VoxelHit> hit = grid.raycast(ray)) {
+        std::cout << "Looking at the " << FACE_NAMES[(unsigned)hit->face]
+                  << " of block (" << hit->x << ", " << hit->y << ", "
+                  << hit->z << "), " << hit->distance << " away";
+      } else {
+        std::cout << "Looking at nothing";
+      }
+      // The same ray against the meshes themselves.
+      ray.origin = {0, 0, 0};
+      if (std::optional<RaycastHit> hit = game.raycast(ray)) {
+        std::cout << " (triangle " << hit->triangle << " of a mesh, "
+                  << hit->distance << " away)";
+      }
+      std::cout << std::endl;
+    };
     auto previousSecondStart = std::chrono::steady_clock::now();
     unsigned framesThisSecond = 0;
     game.addUpdateFunction([&]() {
       if (std::chrono::duration_cast<std::chrono::seconds>(
               std::chrono::steady_clock::now() - previousSecondStart)
               .count() >= 1) {
-        std::cout << "FPS: " << framesThisSecond << std::endl;
+        FrameProfile profile = game.getFrameProfile();
+        std::cout << "FPS: " << framesThisSecond << " (CPU "
+                  << profile.cpuMilliseconds << " ms, GPU "
+                  << profile.gpuMilliseconds
+                  << " ms, chunks loading: " << game.getPendingLoadCount()
+                  << ", matrix recomputations saved: "
+                  << game.getTransformStats().savedRecomputations() << ")"
+                  << std::endl;
+        printPickedBlock();
         framesThisSecond = 0;
         previousSecondStart = std::chrono::steady_clock::now();
       } else {
         framesThisSecond++;
       }
-      grass1.setRotateY(grass1.getRotateY() + 0.01f);
-      grass2.setRotateY(grass2.getRotateY() - 0.01f);
     });
+    // Each of these only touches its own cube, so they can run in parallel.
+    game.addUpdateFunction(
+        [&]() { grass1.setRotateY(grass1.getRotateY() + 0.01f); },
+        {.parallelSafe = true});
+    game.addUpdateFunction(
+        [&]() { grass2.setRotateY(grass2.getRotateY() - 0.01f); },
+        {.parallelSafe = true});
     game.run("Digbuild", 0, 0);
     return 0;
   } catch (const std::exception &e) {
@@ -0,0 +1,117 @@
+#ifndef SEAGULL_ASSET_PACK_FORMAT_H
+#define SEAGULL_ASSET_PACK_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// This file is header-only and doesn't depend on the rest of the engine so
+// that the asset packer (in tools/digbuild) writes exactly what the engine
+// reads.
+//
+// An asset pack holds data which is ready to be handed straight to OpenGL, so
+// that loading it is just a matter of memory mapping the file. It is laid out
+// as follows (all little-endian):
+//
+//   AssetPackHeader
+//   PackedTexture[textureCount]
+//   PackedMesh[meshCount]
+//   data, each block starting on a DATA_ALIGNMENT boundary:
+//     textures: every mip level as RGBA8, largest first, one after the other
+//     meshes: vertices (5 floats each: x, y, z, u, v), then 32 bit indices
+
+namespace seagull {
+static constexpr char ASSET_PACK_MAGIC[8] = {'S', 'G', 'L', 'P',
+                                             'A', 'C', 'K', '\0'};
+static constexpr uint32_t ASSET_PACK_VERSION = 1;
+static constexpr size_t ASSET_PACK_NAME_LENGTH = 64; // Including the null
+static constexpr size_t ASSET_PACK_DATA_ALIGNMENT = 16;
+static constexpr size_t ASSET_PACK_FLOATS_PER_VERTEX = 5;
+// Part of every packed mesh's content hash. The packer builds meshes with the
+// engine's own cube and vertex indexing code, so bump this whenever either of
+// them changes what it produces, and packed meshes get rebuilt.
+static constexpr uint32_t ASSET_PACK_MESHER_VERSION = 1;
+
+struct AssetPackHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t textureCount;
+  uint32_t meshCount;
+  uint32_t reserved;
+};
+
+struct PackedTexture {
+  char name[ASSET_PACK_NAME_LENGTH];
+  // A hash of whatever the texture was built from, so that the packer can
+  // tell whether it is out of date.
+  uint64_t contentHash;
+  uint32_t width, height;
+  uint32_t mipLevelCount;
+  uint32_t transparent; // Whether any of the image is see-through
+  uint64_t dataOffset;  // From the start of the file
+  uint64_t dataSize;    // Of every mip level together
+};
+
+struct PackedMesh {
+  char name[ASSET_PACK_NAME_LENGTH];
+  uint64_t contentHash;
+  uint32_t textureIndex;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t reserved;
+  // The same bounds the engine would work out for the mesh.
+  float boundsMin[3], boundsMax[3];
+  float sphereCenter[3];
+  float sphereRadius;
+  uint64_t vertexOffset; // From the start of the file
+  uint64_t indexOffset;  // From the start of the file
+};
+
+static_assert(sizeof(AssetPackHeader) == 24);
+static_assert(sizeof(PackedTexture) == 104);
+static_assert(sizeof(PackedMesh) == 144);
+
+static inline size_t getMipLevelSize(size_t size, unsigned level) {
+  size >>= level;
+  return size > 0 ? size : 1;
+}
+
+static inline size_t alignAssetPackOffset(size_t offset) {
+  return (offset + ASSET_PACK_DATA_ALIGNMENT - 1) /
+         ASSET_PACK_DATA_ALIGNMENT * ASSET_PACK_DATA_ALIGNMENT;
+}
+
+/**
+ * @brief hash some bytes (64 bit FNV-1a)
+ *
+ * @note pass the previous result as the hash to hash several things together.
+ */
+static inline uint64_t hashAssetSource(const void *data, size_t size,
+                                       uint64_t hash = 0xcbf29ce484222325) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+// The names are stored null-terminated in a fixed size array.
+static inline std::string_view
+getPackedName(const char (&name)[ASSET_PACK_NAME_LENGTH]) {
+  return std::string_view(name, strnlen(name, ASSET_PACK_NAME_LENGTH));
+}
+
+static inline bool setPackedName(char (&name)[ASSET_PACK_NAME_LENGTH],
+                                 std::string_view value) {
+  if (value.size() >= ASSET_PACK_NAME_LENGTH) {
+    return false;
+  }
+  std::memset(name, 0, ASSET_PACK_NAME_LENGTH);
+  std::memcpy(name, value.data(), value.size());
+  return true;
+}
+} // namespace seagull
+
+#endif
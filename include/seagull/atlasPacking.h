@@ -0,0 +1,114 @@
+#ifndef SEAGULL_ATLAS_PACKING_H
+#define SEAGULL_ATLAS_PACKING_H
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+// This file is header-only and doesn't depend on the rest of the engine so
+// that offline tools (like the digbuild texture composer) can pack atlases in
+// exactly the same way as the engine does at load time.
+
+namespace seagull {
+struct AtlasSize {
+  size_t width, height;
+};
+
+struct AtlasRect {
+  size_t x, y, width, height;
+};
+
+struct AtlasLayout {
+  size_t width = 0, height = 0;
+  std::vector<AtlasRect> rects; // In the same order as the sizes were given
+};
+
+static inline size_t nextPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result *= 2;
+  }
+  return result;
+}
+
+/**
+ * @brief work out where to put each image in an atlas
+ *
+ * @note this is a simple shelf packer: the images are placed from tallest to
+ * shortest in rows, starting a new row whenever the current one is full. The
+ * atlas dimensions are powers of two, which keeps mipmapping well behaved.
+ *
+ * @param padding the number of pixels to leave around each image (so that
+ * filtering doesn't bleed neighbouring images into each other)
+ */
+static inline AtlasLayout packAtlas(const std::vector<AtlasSize> &sizes,
+                                    size_t padding) {
+  AtlasLayout layout;
+  layout.rects.resize(sizes.size());
+  size_t totalArea = 0;
+  size_t widest = 0;
+  for (const AtlasSize &size : sizes) {
+    totalArea += (size.width + padding * 2) * (size.height + padding * 2);
+    widest = std::max(widest, size.width + padding * 2);
+  }
+  // Aim for a roughly square atlas.
+  size_t side = 1;
+  while (side * side < totalArea) {
+    side *= 2;
+  }
+  layout.width = std::max(side, nextPowerOfTwo(widest));
+
+  std::vector<size_t> order(sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return sizes[a].height > sizes[b].height;
+  });
+  size_t shelfX = 0, shelfY = 0, shelfHeight = 0;
+  for (size_t index : order) {
+    size_t paddedWidth = sizes[index].width + padding * 2;
+    size_t paddedHeight = sizes[index].height + padding * 2;
+    if (shelfX + paddedWidth > layout.width) {
+      shelfY += shelfHeight;
+      shelfX = shelfHeight = 0;
+    }
+    layout.rects[index] = {shelfX + padding, shelfY + padding,
+                           sizes[index].width, sizes[index].height};
+    shelfX += paddedWidth;
+    shelfHeight = std::max(shelfHeight, paddedHeight);
+  }
+  layout.height = nextPowerOfTwo(shelfY + shelfHeight);
+  return layout;
+}
+
+/**
+ * @brief copy an RGBA8 image into its place in an RGBA8 atlas
+ *
+ * @note the edge pixels are repeated out into the padding, so that sampling
+ * just outside of the image (which filtering and mipmapping both do) gives the
+ * image's own colours rather than its neighbours'.
+ */
+static inline void blitIntoAtlas(unsigned char *atlas, size_t atlasWidth,
+                                 const unsigned char *image,
+                                 const AtlasRect &rect, size_t padding) {
+  static constexpr size_t BYTES_PER_PIXEL = 4;
+  if (rect.width == 0 || rect.height == 0) {
+    return;
+  }
+  for (size_t y = 0; y < rect.height + padding * 2; y++) {
+    size_t sourceY = std::clamp<size_t>(y, padding, padding + rect.height - 1) -
+                     padding;
+    for (size_t x = 0; x < rect.width + padding * 2; x++) {
+      size_t sourceX =
+          std::clamp<size_t>(x, padding, padding + rect.width - 1) - padding;
+      size_t atlasX = rect.x - padding + x;
+      size_t atlasY = rect.y - padding + y;
+      std::memcpy(atlas + (atlasY * atlasWidth + atlasX) * BYTES_PER_PIXEL,
+                  image + (sourceY * rect.width + sourceX) * BYTES_PER_PIXEL,
+                  BYTES_PER_PIXEL);
+    }
+  }
+}
+} // namespace seagull
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SEAGULL_COMPRESSED_TEXTURE_FORMAT_H
+#define SEAGULL_COMPRESSED_TEXTURE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// This file is header-only and doesn't depend on the rest of the engine so
+// that the texture composer (in tools/digbuild) writes exactly what the engine
+// reads.
+//
+// A compressed texture file holds a block-compressed image and all of its mip
+// levels, ready to be handed straight to glCompressedTexImage2D. It is laid
+// out as follows (all little-endian):
+//
+//   CompressedTextureHeader
+//   every mip level, largest first, one after the other. Each level is a row
+//   major grid of 4x4 pixel blocks (partial blocks at the right and bottom
+//   edges are padded), in the standard BC1 (8 bytes per block) or BC3 (16
+//   bytes per block) encoding.
+
+namespace seagull {
+static constexpr char COMPRESSED_TEXTURE_MAGIC[8] = {'S', 'G', 'L', 'T',
+                                                     'E', 'X', 'B', '\0'};
+static constexpr uint32_t COMPRESSED_TEXTURE_VERSION = 1;
+
+// The values of CompressedTextureHeader::format.
+static constexpr uint32_t COMPRESSED_TEXTURE_BC1 = 1; // RGB and 1-bit alpha
+static constexpr uint32_t COMPRESSED_TEXTURE_BC3 = 3; // RGB and 8-bit alpha
+
+struct CompressedTextureHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t format;
+  uint32_t width, height;
+  uint32_t mipLevelCount;
+  uint32_t transparent; // Whether any of the image is see-through
+};
+
+static_assert(sizeof(CompressedTextureHeader) == 32);
+
+static inline size_t getCompressedBlockSize(uint32_t format) {
+  return format == COMPRESSED_TEXTURE_BC1 ? 8 : 16;
+}
+
+/**
+ * @brief get the number of bytes in a mip level of the given size
+ */
+static inline size_t getCompressedLevelSize(uint32_t format, size_t width,
+                                            size_t height) {
+  return (width + 3) / 4 * ((height + 3) / 4) * getCompressedBlockSize(format);
+}
+} // namespace seagull
+
+#endif
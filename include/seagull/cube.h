@@ -0,0 +1,80 @@
+#ifndef SEAGULL_CUBE_H
+#define SEAGULL_CUBE_H
+
+#include <seagull/mesh.h>
+
+namespace seagull {
+/**
+ * @brief the ways a cube's faces can be laid out in its image
+ */
+enum class CubeTextureType {
+  // Every face uses the whole image.
+  SIDES,
+  // The image is divided into horizontal thirds: top, sides, bottom. The sides
+  // are the front, back, left and right.
+  TOP_BOTTOM_SIDES,
+  // The image is divided into thirds vertically and quarters horizontally. It
+  // is layed out like a cube net: _t__ lfrb _b__ Where t is the top, l is the
+  // left, f is the front, r is the right, b is the back and b is also the
+  // bottom (you can probably figure it out though).
+  TOP_BOTTOM_FRONT_BACK_LEFT_RIGHT,
+};
+
+enum class CubeFace {
+  FRONT,  // -z
+  BACK,   // +z
+  LEFT,   // -x
+  RIGHT,  // +x
+  TOP,    // +y
+  BOTTOM, // -y
+};
+static constexpr unsigned CUBE_FACE_COUNT = 6;
+
+/**
+ * @brief the part of an image used by a face of a cube
+ */
+struct TextureRegion {
+  Point2d min, max;
+};
+
+/**
+ * @brief get the region of a cube's image which one of its faces uses
+ *
+ * @param imageRegion the part of the image the cube's layout occupies (for
+ * example its entry in a texture atlas)
+ */
+TextureRegion getCubeFaceRegion(CubeTextureType textureType, CubeFace face,
+                                TextureRegion imageRegion = {{0, 0}, {1, 1}});
+
+/**
+ * @brief the orientation of a face of a cube
+ *
+ * @note u and v are the texture coordinate axes (v points down the image).
+ * Each face is oriented so that its image is the right way round (and the
+ * right way up for the sides) when looking at the face from outside the cube.
+ */
+struct CubeFaceFrame {
+  unsigned normalAxis; // 0 = x, 1 = y, 2 = z
+  bool normalPositive;
+  unsigned uAxis;
+  bool uPositive;
+  unsigned vAxis;
+  bool vPositive;
+};
+
+const CubeFaceFrame &getCubeFaceFrame(CubeFace face);
+
+/**
+ * @brief create a cube from (-1, -1, -1) to (1, 1, 1) with the given texture
+ * layout
+ */
+TexturedMesh createCubeMesh(std::shared_ptr<const Image> image,
+                            CubeTextureType textureType);
+static inline TexturedMesh createCubeMesh(Image image,
+                                          CubeTextureType textureType) {
+  return createCubeMesh(std::make_shared<const Image>(std::move(image)),
+                        textureType);
+}
+} // namespace seagull
+
+#endif
@@ -3,33 +3,59 @@
 
 #include <memory>
 #include <seagull/mesh.h>
+#include <seagull/slotHandle.h>
 
 namespace seagull {
 // Forward-declare to be able to befriend later
 class Game;
+struct GameContext;
+struct GameObjectGeometry;
+template <typename T> class SlotMap;
 
 // Forward-declare so that no pesky clients can get their grubby mits on
 // our implementation details
 struct GameObjectState;
 
+/**
+ * @brief refers to a game object
+ *
+ * @note this is only a handle (the game object itself lives in the game
+ * context), so it is cheap to copy, and every copy refers to the same game
+ * object. It stays valid when other game objects are created or destroyed.
+ * Using a handle to a game object which has been destroyed throws
+ * std::logic_error.
+ */
 class GameObject {
 private:
-  std::unique_ptr<GameObjectState> state;
+  // Either the scene or the templates
+  SlotMap<GameObjectState> *objects = nullptr;
+  SlotHandle handle;
 
-  // The constructors are marked private so that only our friends (Game) are
+  // The constructor is marked private so that only our friends (Game) are
   // allowed to create instances of us.
-  GameObject(TexturedMesh mesh);
-  GameObject(GameObjectState state);
+  GameObject(SlotMap<GameObjectState> &objects, SlotHandle handle)
+      : objects(&objects), handle(handle) {}
+
+  GameObjectState &getState() const;
 
   friend class Game;
+  friend GameObject
+  addGameObject(GameContext &gameContext,
+                std::shared_ptr<GameObjectGeometry> geometry,
+                bool addToScene);
 
 public:
-  ~GameObject(); // I'd rather have this private, but it doesn't work very well
-                 // in a vector unless this is public.
+  /**
+   * @brief create a handle which doesn't refer to any game object
+   */
+  GameObject() = default;
+
+  /**
+   * @brief whether the game object exists (it hasn't been destroyed)
+   */
+  bool isValid() const;
 
-  // It doesn't work very well unless we put this in too.
-  GameObject(GameObject &&) = default;
-  GameObject &operator=(GameObject &&) = default;
+  bool operator==(const GameObject &other) const = default;
 
   void setTranslateX(float x);
   void setTranslateY(float y);
@@ -41,6 +67,18 @@ public:
 
   void setScale(float scale);
 
+  /**
+   * @brief set the translation, rotation and scale at once
+   *
+   * @note this is cheaper than calling each of the individual setters, since
+   * the game object is only marked as changed once.
+   *
+   * @param translation the translation along each axis
+   * @param rotation the rotation around each axis, in radians
+   * @param scale the scale
+   */
+  void setTransform(Point3d translation, Point3d rotation, float scale);
+
   float getTranslateX() const;
   float getTranslateY() const;
   float getTranslateZ() const;
@@ -0,0 +1,132 @@
+#ifndef SEAGULL_INDEXED_MESH_H
+#define SEAGULL_INDEXED_MESH_H
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <seagull/mesh.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief a textured mesh whose triangles share their vertices
+ *
+ * @note a TexturedMesh repeats every vertex for each triangle it is part of,
+ * and the repeats have to be found and welded together again before it can be
+ * uploaded. If you already know which vertices are shared (procedural
+ * generators usually do), build one of these instead: it is laid out exactly
+ * the way the GPU wants it, so it is uploaded as is.
+ *
+ * @note each vertex has a position and a texture coordinate (in the same
+ * [0, 1] range as Texture), and each triangle is three indices into the
+ * vertices.
+ */
+class IndexedMesh {
+private:
+  std::vector<float> positions;          // 3 floats per vertex
+  std::vector<float> textureCoordinates; // 2 floats per vertex
+  std::vector<uint32_t> indices;         // 3 indices per triangle
+  std::shared_ptr<const Image> image;
+
+public:
+  IndexedMesh(Image image)
+      : image(std::make_shared<const Image>(std::move(image))) {}
+  IndexedMesh(std::shared_ptr<const Image> image) : image(std::move(image)) {}
+  /**
+   * @brief take over arrays which have already been filled in
+   *
+   * @note see the members for the layout. Game::createGameObject throws
+   * std::invalid_argument if the positions or indices don't come in threes or
+   * any of the indices are out of range.
+   */
+  IndexedMesh(std::shared_ptr<const Image> image, std::vector<float> positions,
+              std::vector<float> textureCoordinates,
+              std::vector<uint32_t> indices)
+      : positions(std::move(positions)),
+        textureCoordinates(std::move(textureCoordinates)),
+        indices(std::move(indices)), image(std::move(image)) {
+    assert(this->positions.size() % 3 == 0 &&
+           "Every position must have 3 coordinates");
+    assert(this->indices.size() % 3 == 0 &&
+           "Every triangle must have 3 indices");
+    assert(this->positions.size() / 3 == this->textureCoordinates.size() / 2 &&
+           "Every vertex must have a position and a texture coordinate");
+  }
+
+  /**
+   * @brief make room for some vertices and triangles, to avoid reallocating
+   * as they are added
+   */
+  void reserve(size_t vertexCount, size_t triangleCount) {
+    positions.reserve(vertexCount * 3);
+    textureCoordinates.reserve(vertexCount * 2);
+    indices.reserve(triangleCount * 3);
+  }
+
+  /**
+   * @return the index of the new vertex
+   */
+  uint32_t addVertex(Point3d position, Point2d textureCoordinate) {
+    uint32_t index = getVertexCount();
+    positions.insert(positions.end(), {position.x, position.y, position.z});
+    textureCoordinates.insert(textureCoordinates.end(),
+                              {textureCoordinate.x, textureCoordinate.y});
+    return index;
+  }
+  IndexedMesh &addTriangle(uint32_t a, uint32_t b, uint32_t c) {
+    assert(a < getVertexCount() && b < getVertexCount() &&
+           c < getVertexCount() && "The vertices must be added first");
+    indices.insert(indices.end(), {a, b, c});
+    return *this;
+  }
+  IndexedMesh &addQuad(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    addTriangle(a, b, c);
+    return addTriangle(a, c, d);
+  }
+
+  size_t getVertexCount() const { return positions.size() / 3; }
+  size_t getTriangleCount() const { return indices.size() / 3; }
+
+  Point3d getPosition(size_t vertex) const {
+    const float *position = &positions[vertex * 3];
+    return {position[0], position[1], position[2]};
+  }
+  Point2d getTextureCoordinate(size_t vertex) const {
+    const float *coordinate = &textureCoordinates[vertex * 2];
+    return {coordinate[0], coordinate[1]};
+  }
+
+  const std::vector<float> &getPositions() const { return positions; }
+  const std::vector<float> &getTextureCoordinates() const {
+    return textureCoordinates;
+  }
+  const std::vector<uint32_t> &getIndices() const { return indices; }
+  /**
+   * @brief replace the triangles (keeping the vertices)
+   */
+  void setIndices(std::vector<uint32_t> newIndices) {
+    indices = std::move(newIndices);
+  }
+
+  const Image &getImage() const { return *image; }
+  const std::shared_ptr<const Image> &getSharedImage() const { return image; }
+
+  /**
+   * @brief write every triangle out separately
+   */
+  TexturedMesh toTexturedMesh() const {
+    Mesh mesh;
+    Texture texture(image);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      mesh.addTriangle({getPosition(indices[i]), getPosition(indices[i + 1]),
+                        getPosition(indices[i + 2])});
+      texture.addTriangle({getTextureCoordinate(indices[i]),
+                           getTextureCoordinate(indices[i + 1]),
+                           getTextureCoordinate(indices[i + 2])});
+    }
+    return TexturedMesh(std::move(mesh), std::move(texture));
+  }
+};
+} // namespace seagull
+
+#endif
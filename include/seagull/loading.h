@@ -0,0 +1,44 @@
+#ifndef SEAGULL_LOADING_H
+#define SEAGULL_LOADING_H
+
+#include <memory>
+
+namespace seagull {
+class GameObject;
+struct PendingLoad;
+
+/**
+ * @brief a game object which is being loaded in the background
+ *
+ * @note see Game::loadGameObject. This is cheap to copy: every copy refers to
+ * the same load.
+ */
+class PendingGameObject {
+private:
+  std::shared_ptr<PendingLoad> load;
+
+public:
+  PendingGameObject(std::shared_ptr<PendingLoad> load)
+      : load(std::move(load)) {}
+
+  /**
+   * @brief whether the game object has been created
+   */
+  bool isReady() const;
+
+  /**
+   * @brief whether loading the game object threw an exception
+   */
+  bool hasFailed() const;
+
+  /**
+   * @brief get the game object
+   *
+   * @note this throws std::logic_error if the game object isn't ready yet, and
+   * rethrows the exception if loading it failed.
+   */
+  GameObject get() const;
+};
+} // namespace seagull
+
+#endif
@@ -68,10 +68,7 @@ public:
                                                const Color &fillColor) {
     // Create a texture with a single pixel of the given color which all points
     // of the triangles point to.
-    Image image;
-    image.width = image.height = 1;
-    image.pixels = {fillColor};
-    Texture texture(std::move(image));
+    Texture texture(Image(1, 1, std::vector<Color>{fillColor}));
     for (size_t i = 0; i < mesh.size(); i++) {
       texture.addTriangle({{0, 0}, {0, 0}, {0, 0}});
     }
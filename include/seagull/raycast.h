@@ -0,0 +1,117 @@
+#ifndef SEAGULL_RAYCAST_H
+#define SEAGULL_RAYCAST_H
+
+#include <cmath>
+#include <optional>
+#include <seagull/cube.h>
+#include <seagull/gameObject.h>
+#include <seagull/point.h>
+
+namespace seagull {
+/**
+ * @brief a ray, starting at origin and heading along direction
+ *
+ * @note the direction doesn't need to be normalised: every distance is
+ * measured in the ray's own units (the world's, or the grid's), not in
+ * lengths of direction.
+ */
+struct Ray {
+  Point3d origin;
+  Point3d direction;
+  float maxDistance = INFINITY;
+};
+
+/**
+ * @brief where a ray hit a game object
+ */
+struct RaycastHit {
+  GameObject object;
+  // Which of the object's triangles was hit, counting in threes through the
+  // indices of the mesh readBackMesh gives.
+  size_t triangle;
+  float distance; // Along the ray, from its origin
+};
+
+/**
+ * @brief where a ray hit a grid of blocks
+ */
+struct VoxelHit {
+  int x, y, z; // The block, which occupies (x, y, z) to (x + 1, y + 1, z + 1)
+  // The face the ray entered it through. If the ray started inside the block,
+  // this is the face it would have entered through along its main axis.
+  CubeFace face;
+  float distance;
+};
+
+/**
+ * @brief find the first solid block along a ray through a grid of unit blocks
+ *
+ * @note this visits every block the ray passes through, in order, stepping to
+ * whichever block boundary is nearest each time (Amanatides and Woo's DDA),
+ * so each block costs a couple of comparisons and an addition. The ray's
+ * maxDistance must be finite unless it is sure to hit something.
+ *
+ * @param isSolid isSolid(x, y, z) says whether the block at (x, y, z) is solid
+ */
+template <typename IsSolid>
+std::optional<VoxelHit> raycastVoxels(const Ray &ray, IsSolid &&isSolid) {
+  float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+  float length = std::sqrt(direction[0] * direction[0] +
+                           direction[1] * direction[1] +
+                           direction[2] * direction[2]);
+  if (!(length > 0)) {
+    return std::nullopt;
+  }
+  // The faces a ray enters a block through when it steps along each axis in
+  // the positive direction, and in the negative direction.
+  static constexpr CubeFace POSITIVE_STEP_FACES[3] = {
+      CubeFace::LEFT, CubeFace::BOTTOM, CubeFace::FRONT};
+  static constexpr CubeFace NEGATIVE_STEP_FACES[3] = {
+      CubeFace::RIGHT, CubeFace::TOP, CubeFace::BACK};
+  int block[3], step[3];
+  // The distance to the next boundary along each axis, and between
+  // boundaries along each axis.
+  float nextBoundary[3], boundarySpacing[3];
+  int mainAxis = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    direction[axis] /= length;
+    block[axis] = (int)std::floor(origin[axis]);
+    if (direction[axis] > 0) {
+      step[axis] = 1;
+      boundarySpacing[axis] = 1 / direction[axis];
+      nextBoundary[axis] =
+          (block[axis] + 1 - origin[axis]) * boundarySpacing[axis];
+    } else if (direction[axis] < 0) {
+      step[axis] = -1;
+      boundarySpacing[axis] = -1 / direction[axis];
+      nextBoundary[axis] = (origin[axis] - block[axis]) * boundarySpacing[axis];
+    } else {
+      step[axis] = 0;
+      boundarySpacing[axis] = nextBoundary[axis] = INFINITY;
+    }
+    if (std::abs(direction[axis]) > std::abs(direction[mainAxis])) {
+      mainAxis = axis;
+    }
+  }
+  CubeFace face = step[mainAxis] > 0 ? POSITIVE_STEP_FACES[mainAxis]
+                                     : NEGATIVE_STEP_FACES[mainAxis];
+  float distance = 0;
+  while (distance <= ray.maxDistance) {
+    if (isSolid(block[0], block[1], block[2])) {
+      return VoxelHit{block[0], block[1], block[2], face, distance};
+    }
+    int axis = nextBoundary[0] < nextBoundary[1]
+                   ? (nextBoundary[0] < nextBoundary[2] ? 0 : 2)
+                   : (nextBoundary[1] < nextBoundary[2] ? 1 : 2);
+    distance = nextBoundary[axis];
+    block[axis] += step[axis];
+    nextBoundary[axis] += boundarySpacing[axis];
+    face = step[axis] > 0 ? POSITIVE_STEP_FACES[axis]
+                          : NEGATIVE_STEP_FACES[axis];
+  }
+  return std::nullopt;
+}
+} // namespace seagull
+
+#endif
@@ -3,8 +3,14 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <seagull/gameObject.h>
+#include <seagull/indexedMesh.h>
+#include <seagull/loading.h>
+#include <seagull/raycast.h>
+#include <seagull/stats.h>
 #include <string>
+#include <vector>
 
 namespace seagull {
 /**
@@ -18,6 +24,30 @@ namespace seagull {
  */
 struct GameContext;
 
+using UpdateFunctionId = size_t;
+
+/**
+ * @brief how an update function may be scheduled
+ */
+struct UpdateOptions {
+  /**
+   * @brief whether the function may run on a worker thread, alongside other
+   * parallel-safe update functions
+   *
+   * @note a parallel-safe function must not create, duplicate or destroy game
+   * objects (on a worker thread, that throws std::logic_error), and must not
+   * touch anything another update function touches (unless one of them depends
+   * on the other). Changing the transforms of its own game objects is fine.
+   */
+  bool parallelSafe = false;
+  /**
+   * @brief update functions which must finish before this one starts
+   *
+   * @note these must have been added before this one.
+   */
+  std::vector<UpdateFunctionId> dependencies;
+};
+
 /**
  * @brief the main game class
  *
@@ -43,7 +73,16 @@ public:
    * (otherwise it becomes a template)
    * @return the newly created GameObject
    */
-  GameObject &createGameObject(TexturedMesh mesh, bool addToScene = true);
+  GameObject createGameObject(TexturedMesh mesh, bool addToScene = true);
+  /**
+   * @brief create a game object from a mesh which is already indexed
+   *
+   * @note the vertices are uploaded as they are, so this skips welding the
+   * repeated vertices together. It throws std::invalid_argument if the
+   * positions or indices don't come in threes, or if any of the indices are
+   * out of range.
+   */
+  GameObject createGameObject(IndexedMesh mesh, bool addToScene = true);
 
   /**
    * @brief duplicate a game object and add it to the scene
@@ -55,7 +94,185 @@ public:
    * @param gameObject the game object to duplicate (may be a template)
    * @return the new game object
    */
-  GameObject &duplicateGameObject(const GameObject &originalGameObject);
+  GameObject duplicateGameObject(const GameObject &originalGameObject);
+
+  /**
+   * @brief remove a game object (from the scene, or from the templates)
+   *
+   * @note every handle to the game object becomes invalid. Anything duplicated
+   * from it is unaffected. The geometry is freed once nothing else uses it.
+   *
+   * @return false if the game object had already been destroyed
+   */
+  bool destroyGameObject(const GameObject &gameObject);
+
+  /**
+   * @brief choose whether game objects keep their mesh in memory once it has
+   * been uploaded to the GPU
+   *
+   * @note they do by default (as indexed vertices, which is all the GPU gets).
+   * Otherwise the vertices are freed after uploading them, along with the
+   * image of the texture (unless something else still holds on to that), so
+   * the only copy is the one on the GPU. Only game objects created afterwards
+   * are affected.
+   */
+  void setRetainMeshData(bool retain);
+
+  /**
+   * @brief choose where compiled shader programs are cached between runs
+   *
+   * @note the engine's shaders are compiled and linked the first time the game
+   * runs, and the driver's binary for them is saved here so that later runs
+   * can load it instead. Binaries are keyed by the shader sources and the
+   * driver, so updating either just means compiling again. By default they
+   * go in the user's cache directory (such as ~/.cache/seagull/shaders, or
+   * %LOCALAPPDATA%\seagull\shaders on Windows), which no other user can
+   * write to. Pass an empty string not to cache them at all. This must be
+   * called before run or benchmark.
+   */
+  void setShaderCacheDirectory(const std::string &directory);
+
+  /**
+   * @brief choose whether game objects get simplified levels of detail
+   *
+   * @note they do by default. Each mesh is simplified a few times over (by
+   * collapsing the edges whose removal changes its shape the least), and
+   * every frame each object is drawn at the simplest level whose difference
+   * from the full mesh would be under about a pixel on screen. Small meshes
+   * are left alone. Only game objects created afterwards are affected.
+   */
+  void setGenerateLods(bool generate);
+
+  /**
+   * @brief choose whether the triangles of game objects are ordered to reduce
+   * overdraw
+   *
+   * @note the triangles of every mesh are reordered so that the GPU can reuse
+   * more of the vertices it has already transformed (see
+   * getVertexCacheStats). By default, they are also grouped into clusters
+   * which are drawn outermost first, so that fewer hidden pixels get shaded.
+   * That costs a few cache misses, and makes no difference to meshes which
+   * can't hide parts of themselves. Only game objects created afterwards are
+   * affected.
+   */
+  void setOptimizeOverdraw(bool optimize);
+
+  /**
+   * @brief choose whether game objects can be hit by raycasts
+   *
+   * @note they can by default. That costs a BVH of each mesh's triangles
+   * (built alongside the rest of its processing, so on a worker thread for
+   * loadGameObject). The BVH keeps its own three corners of every triangle
+   * (36 bytes), an index of it (4 bytes) and a 32-byte node per couple of
+   * triangles or so: roughly 60 bytes per triangle, several times the size of
+   * an indexed mesh's positions. Only game objects created afterwards are
+   * affected.
+   */
+  void setRaycastable(bool raycastable);
+
+  /**
+   * @brief find the nearest game object in the scene along a ray
+   *
+   * @note only the full mesh of each object is tested (never its levels of
+   * detail), from either side of each triangle. The first raycast after any
+   * game object is created, destroyed or moved rebuilds a BVH over all of
+   * them, so it is best to cast rays in one place each frame, such as an
+   * update function which isn't parallel-safe. With a tick rate (see
+   * setTickRate), only cast rays from update functions.
+   *
+   * @return the hit, or nothing if the ray didn't hit anything before its
+   * maxDistance
+   */
+  std::optional<RaycastHit> raycast(const Ray &ray);
+
+  /**
+   * @brief cast many rays at once, across all of the cores
+   *
+   * @note this is much faster than casting them one at a time, which makes it
+   * the one to use for things like checking lines of sight for every AI.
+   *
+   * @return the hit for each ray
+   */
+  std::vector<std::optional<RaycastHit>> raycast(const std::vector<Ray> &rays);
+
+  /**
+   * @brief get the mesh a game object was made from
+   *
+   * @note the triangles are the ones which were uploaded, so any vertices they
+   * share come out repeated. If the vertices weren't kept (see
+   * setRetainMeshData, and also for asset packs), they are read back from the
+   * GPU, which is slow: it waits for the GPU to catch up. The texture then has
+   * a new copy of the image, in RGBA8.
+   */
+  TexturedMesh readBackMesh(const GameObject &gameObject) const;
+
+  /**
+   * @brief create a game object in the background
+   *
+   * @note loadMesh runs on a worker thread, so it is the place to do slow
+   * things like reading and decoding images (loadPngImage is fine to call
+   * there). The mesh is then indexed on the worker too, and its texture is
+   * streamed to the GPU over the following frames. The game keeps running in
+   * the meantime, so it can show something while it waits.
+   *
+   * @note once everything is on the GPU, the game object is created and
+   * onLoaded is called with it (on the main thread, before the update
+   * functions), which is the place to position it or duplicate it.
+   *
+   * @note loads which haven't finished when the game is destroyed are
+   * finished first, so anything loadMesh uses must outlive the game.
+   *
+   * @param loadMesh builds the mesh (must not touch the game)
+   * @param addToScene whether or not to add the game object to the scene
+   * (otherwise it becomes a template)
+   * @param onLoaded called once the game object exists
+   * @return a handle to check on the game object's progress
+   */
+  PendingGameObject
+  loadGameObject(std::function<TexturedMesh()> loadMesh,
+                 bool addToScene = true,
+                 std::function<void(GameObject &)> onLoaded = {});
+  /**
+   * @brief create a game object in the background, from a mesh which is
+   * already indexed
+   */
+  PendingGameObject
+  loadGameObject(std::function<IndexedMesh()> loadMesh,
+                 bool addToScene = true,
+                 std::function<void(GameObject &)> onLoaded = {});
+
+  /**
+   * @brief get the number of game objects still being loaded
+   */
+  size_t getPendingLoadCount() const;
+
+  /**
+   * @brief memory map an asset pack, so that its meshes can be used
+   *
+   * @note asset packs are made by the asset packer (in tools/digbuild). They
+   * hold meshes and textures which are ready to upload, so creating a game
+   * object from one skips building, indexing and decoding altogether.
+   *
+   * @param fileName the file name of the pack
+   */
+  void openAssetPack(const std::string &fileName);
+
+  /**
+   * @brief create a game object from a mesh in one of the open asset packs
+   *
+   * @note the packs are searched in the order they were opened. This throws
+   * std::runtime_error if none of them has a mesh with the name.
+   *
+   * @note each mesh is only uploaded once: every game object created from it
+   * shares the same geometry, so they are drawn together.
+   *
+   * @param meshName the name of the mesh in the pack
+   * @param addToScene whether or not to add the game object to the scene
+   * (otherwise it becomes a template)
+   * @return the newly created GameObject
+   */
+  GameObject createGameObjectFromPack(const std::string &meshName,
+                                      bool addToScene = true);
 
   /**
    * @brief add a function to run every frame
@@ -67,9 +284,102 @@ public:
    * however it may be less if the game is running slowly. For this reason it
    * should not be depended upon for timing.
    *
+   * @note update functions run in the order they were added, except that
+   * parallel-safe ones (see UpdateOptions) may run at the same time as each
+   * other and as later functions which don't depend on them. All of them have
+   * finished before the scene is rendered.
+   *
    * @param updateFunction the function to run every frame
+   * @param options how the function may be scheduled
+   * @return an id which later update functions can depend on
+   */
+  UpdateFunctionId addUpdateFunction(std::function<void()> updateFunction,
+                                     UpdateOptions options = {});
+
+  /**
+   * @brief run the update functions at a fixed rate, on a thread of their own
+   *
+   * @note by default (and with a rate of 0) they run once per frame, before
+   * the frame is drawn, so a slow frame slows the game down and a slow update
+   * delays the frame. With a tick rate, they run in ticks on a simulation
+   * thread instead, and the render thread draws each game object part way
+   * between where it was at the end of the last two ticks, so that movement
+   * stays smooth whatever the frame rate. That puts everything one tick
+   * behind.
+   *
+   * @note ticks can't create, duplicate or destroy game objects (or do
+   * anything else which uses OpenGL, such as readBackMesh): that throws
+   * std::logic_error. Pass a function to runOnRenderThread to do it instead.
+   * loadGameObject is fine, and its onLoaded callbacks run on the render
+   * thread. This must be called before run or benchmark.
+   */
+  void setTickRate(double ticksPerSecond);
+  // 0 if the update functions run once per frame.
+  double getTickRate() const;
+
+  /**
+   * @brief run a function on the render thread, at the start of the next
+   * frame (between ticks)
+   *
+   * @note this may be called from anywhere, including parallel-safe update
+   * functions.
+   */
+  void runOnRenderThread(std::function<void()> function);
+
+  /**
+   * @brief run body(i) for every i in [0, count) across all of the cores
+   *
+   * @note this returns once every call has finished. It is useful for heavy
+   * work such as meshing many chunks, and may also be used from inside
+   * parallel-safe update functions.
+   */
+  void parallelFor(size_t count, const std::function<void(size_t)> &body);
+
+  /**
+   * @brief get the number of transform changes and matrix recomputations so
+   * far
+   */
+  TransformStats getTransformStats() const;
+
+  /**
+   * @brief get the number of objects which were drawn and culled in the most
+   * recent frame
    */
-  void addUpdateFunction(std::function<void()> updateFunction);
+  CullingStats getCullingStats() const;
+
+  /**
+   * @brief get how much reordering the triangles of the meshes created so far
+   * improved their vertex cache hit rate
+   */
+  VertexCacheStats getVertexCacheStats() const;
+
+  /**
+   * @brief get the number of ticks which have run (and been skipped), if
+   * there is a tick rate
+   */
+  SimulationStats getSimulationStats() const;
+
+  /**
+   * @brief get how much of the shared geometry buffers is in use, and how
+   * many draw calls the most recent frame took
+   */
+  GeometryBufferStats getGeometryBufferStats() const;
+
+  /**
+   * @brief get how long each phase of the most recent frame took
+   *
+   * @note the GPU time lags a few frames behind (see FrameProfile).
+   */
+  FrameProfile getFrameProfile() const;
+
+  /**
+   * @brief write the last few hundred frames' profiles to a file in Chrome's
+   * trace event format (for chrome://tracing or Perfetto)
+   *
+   * @note the same is done when the game closes if the SEAGULL_TRACE_FILE
+   * environment variable is set to a file name.
+   */
+  void writeChromeTrace(const std::string &fileName) const;
 
   /**
    * @brief run the game
@@ -80,11 +390,32 @@ public:
    * @note if both the width and height are set to 0, the window will take up
    * the entire screen
    *
+   * @note if the SEAGULL_BENCHMARK_FRAMES environment variable is set to a
+   * number of frames, this runs benchmark() instead (with the same size, or
+   * 1280x720 if both are 0) and prints the results. This lets a game be
+   * benchmarked without changing it.
+   *
    * @param title the title of the window
    * @param width the width of the window
    * @param height the height of the window
    */
   void run(const std::string &title, int width, int height);
+
+  /**
+   * @brief render a fixed number of frames offscreen as fast as possible
+   *
+   * @note the window is never shown: the scene is rendered into a framebuffer
+   * of the given size instead, without vsync. Each frame waits for the GPU to
+   * finish, so the times include rendering. Only an OpenGL context is needed,
+   * not a visible display, so this works in CI (for example with Mesa's
+   * llvmpipe under Xvfb).
+   *
+   * @param frameCount the number of frames to render
+   * @param width the width of the framebuffer
+   * @param height the height of the framebuffer
+   * @return how long the frames took
+   */
+  FrameTimeStats benchmark(unsigned frameCount, int width, int height);
 };
 } // namespace seagull
 
@@ -0,0 +1,22 @@
+#ifndef SEAGULL_SLOT_HANDLE_H
+#define SEAGULL_SLOT_HANDLE_H
+
+#include <cstdint>
+
+namespace seagull {
+/**
+ * @brief refers to a value in a slot map
+ *
+ * @note the generation changes every time a slot is reused, so a handle to
+ * something which has been removed never refers to whatever replaced it. A
+ * default-constructed handle never refers to anything.
+ */
+struct SlotHandle {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+
+  bool operator==(const SlotHandle &other) const = default;
+};
+} // namespace seagull
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef SEAGULL_STATS_H
+#define SEAGULL_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief counters for the transform updates of game objects
+ *
+ * @note setting a transform only marks the game object as dirty, and its
+ * matrices are recomputed at most once per frame. If they were recomputed on
+ * every change instead, there would have been one recomputation per change.
+ */
+struct TransformStats {
+  uint64_t changes;        // Calls to setters (including setTransform)
+  uint64_t recomputations; // Times a world matrix was actually recomputed
+
+  uint64_t savedRecomputations() const {
+    return changes > recomputations ? changes - recomputations : 0;
+  }
+};
+/**
+ * @brief the number of objects which were drawn or skipped in a frame
+ *
+ * @note objects are skipped (culled) when their bounding sphere is entirely
+ * outside of the view frustum.
+ */
+struct CullingStats {
+  size_t visibleObjects;
+  size_t culledObjects;
+};
+/**
+ * @brief how well the triangles of the meshes created so far reuse the
+ * vertices in the GPU's post-transform cache, before and after reordering them
+ *
+ * @note the misses are counted on a simulated cache, for the full meshes
+ * (without their levels of detail). Meshes from asset packs aren't included,
+ * since they are uploaded as they were packed.
+ */
+struct VertexCacheStats {
+  uint64_t meshes;
+  uint64_t triangles;
+  uint64_t missesBefore; // In the order the triangles were given
+  uint64_t missesAfter;  // In the order they were uploaded
+
+  // The average number of cache misses per triangle (the ACMR).
+  double acmrBefore() const {
+    return triangles ? (double)missesBefore / triangles : 0;
+  }
+  double acmrAfter() const {
+    return triangles ? (double)missesAfter / triangles : 0;
+  }
+};
+/**
+ * @brief counters for the fixed-rate ticks (see Game::setTickRate)
+ *
+ * @note ticks are skipped when they fall more than a few behind, which means
+ * the simulation runs slower than real time.
+ */
+struct SimulationStats {
+  uint64_t ticks;
+  uint64_t skippedTicks;
+};
+/**
+ * @brief how full the buffers every mesh's vertices and indices share are, and
+ * how many draw calls the most recent frame took
+ *
+ * @note destroying game objects leaves holes in the buffers, which are
+ * compacted once they add up to a good fraction of them. Each draw command
+ * draws a run of objects with the same mesh. Where multi-draw-indirect is
+ * supported, each draw call submits many commands.
+ */
+struct GeometryBufferStats {
+  size_t bufferBytes;
+  size_t usedBytes;
+  uint64_t compactions;
+  size_t drawCalls;
+  size_t drawCommands;
+};
+/**
+ * @brief a summary of how long frames took, in milliseconds
+ */
+struct FrameTimeStats {
+  size_t frames;
+  double mean;
+  double p50, p95, p99; // Percentiles
+  double max;
+};
+/**
+ * @brief how long one of the phases of a frame took on the CPU
+ */
+struct ProfileScope {
+  const char *name;
+  unsigned depth; // 0 for a top-level phase, 1 for a phase inside it, etc.
+  double milliseconds;
+};
+/**
+ * @brief where the time went in a frame
+ *
+ * @note the GPU time is measured with timer queries, which are only read once
+ * the GPU has got round to them (a few frames later) so as not to stall. That
+ * is why it comes from an earlier frame than the CPU scopes.
+ */
+struct FrameProfile {
+  uint64_t frame;
+  double cpuMilliseconds;
+  std::vector<ProfileScope> scopes; // In the order they started
+  bool gpuTimeAvailable;
+  uint64_t gpuFrame;
+  double gpuMilliseconds;
+};
+} // namespace seagull
+
+#endif
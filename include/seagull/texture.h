@@ -2,6 +2,7 @@
 #define SEAGULL_TEXTURE_H
 
 #include <cstdint>
+#include <memory>
 #include <seagull/point.h>
 #include <string>
 #include <vector>
@@ -11,18 +12,127 @@ struct Color {
   float r, g, b, a;
 };
 
+/**
+ * @brief a color with one byte per channel, which is how most image files
+ * store them
+ */
+struct Color8 {
+  uint8_t r, g, b, a;
+};
+
+enum class PixelFormat {
+  RGBA8,      // One Color8 per pixel
+  RGBA_FLOAT, // One Color per pixel
+  // Block compressed: every 4x4 block of pixels is stored in 8 (BC1) or 16
+  // (BC3) bytes. BC1 only has on/off transparency.
+  BC1,
+  BC3,
+};
+
 /**
  * @brief an image
  *
  * @note the first pixel corresponds to the top left corner of the image and the
  * last pixel corresponds to the bottom right corner of the image
+ *
+ * @note the pixels are stored as raw bytes in whichever format the image was
+ * created with. RGBA8 takes a quarter of the space of RGBA_FLOAT, and is what
+ * PNG images are loaded as by default. Block-compressed images (see
+ * loadCompressedImage) are smaller still, and go to the GPU as they are.
  */
 struct Image {
-  std::vector<Color> pixels;
-  size_t width, height;
+  size_t width = 0, height = 0;
+  PixelFormat format = PixelFormat::RGBA8;
+  // Block-compressed images carry all of their mip levels (largest first) in
+  // the data. Other images only have the one, and the rest are generated on
+  // the GPU.
+  unsigned mipLevelCount = 1;
+  std::vector<unsigned char> data;
+  // Whether any of a block-compressed image is see-through. This comes from
+  // the file, so that finding out doesn't mean decoding the blocks.
+  bool compressedTransparency = false;
+
+  Image() = default;
+  // Takes ownership of RGBA8 data (4 bytes per pixel).
+  Image(size_t width, size_t height, std::vector<unsigned char> data)
+      : width(width), height(height), data(std::move(data)) {}
+  Image(size_t width, size_t height, const std::vector<Color8> &pixels);
+  Image(size_t width, size_t height, const std::vector<Color> &pixels);
+  // Takes ownership of block-compressed data (see mipLevelCount).
+  Image(size_t width, size_t height, PixelFormat format,
+        unsigned mipLevelCount, std::vector<unsigned char> data,
+        bool transparent)
+      : width(width), height(height), format(format),
+        mipLevelCount(mipLevelCount), data(std::move(data)),
+        compressedTransparency(transparent) {}
+
+  static bool isCompressed(PixelFormat format) {
+    return format == PixelFormat::BC1 || format == PixelFormat::BC3;
+  }
+  bool isCompressed() const { return isCompressed(format); }
+  // Only for uncompressed formats.
+  static size_t getBytesPerPixel(PixelFormat format) {
+    return format == PixelFormat::RGBA8 ? sizeof(Color8) : sizeof(Color);
+  }
+  size_t getBytesPerPixel() const { return getBytesPerPixel(format); }
+  // Only for compressed formats.
+  static size_t getBytesPerBlock(PixelFormat format) {
+    return format == PixelFormat::BC1 ? 8 : 16;
+  }
+  size_t getPixelCount() const { return width * height; }
+
+  /**
+   * @brief get a pixel (converted to floats if necessary)
+   */
+  Color getPixel(size_t index) const;
+
+  /**
+   * @brief whether any of the pixels are not fully opaque
+   *
+   * @note block-compressed images answer from what they were created with,
+   * rather than decoding themselves.
+   */
+  bool hasTransparency() const;
 };
 
-Image loadPngImage(const std::string &fileName);
+/**
+ * @brief load a PNG image
+ *
+ * @param format the format to store the pixels in. RGBA8 uses the decoded
+ * bytes as-is, so it is both faster and smaller.
+ */
+Image loadPngImage(const std::string &fileName,
+                   PixelFormat format = PixelFormat::RGBA8);
+
+/**
+ * @brief load a block-compressed image, as written by the texture composer's
+ * compress mode
+ *
+ * @note the file already has every mip level, so there is nothing to decode or
+ * generate: the data is uploaded as it is.
+ *
+ * @throws std::runtime_error if the file can't be read or isn't a compressed
+ * texture
+ */
+Image loadCompressedImage(const std::string &fileName);
+
+/**
+ * @brief decode the largest mip level of a block-compressed image into RGBA8
+ *
+ * @note other images are just copied.
+ */
+Image decompressImage(const Image &image);
+
+/**
+ * @brief halve an RGBA8 image in each direction (to the next mip level),
+ * averaging each 2x2 block of pixels
+ *
+ * @note a side which is already 1 pixel stays that way, and the last row or
+ * column of an odd side is counted twice.
+ *
+ * @throws std::invalid_argument if the image isn't RGBA8
+ */
+Image downsampleImage(const Image &image);
 
 // The rest of this file is rather similar to mesh.h, except that everything is
 // 2d rather than 3d. TODO: refactor this in some way.
@@ -39,10 +149,15 @@ struct Triangle2d {
 class Texture {
 private:
   std::vector<Triangle2d> triangles;
-  Image image;
+  // This is shared so that several textures can use the same image (for
+  // example different parts of a texture atlas). Objects with textures which
+  // share an image also share the image on the GPU.
+  std::shared_ptr<const Image> image;
 
 public:
-  Texture(Image image) : image(std::move(image)) {}
+  Texture(Image image)
+      : image(std::make_shared<const Image>(std::move(image))) {}
+  Texture(std::shared_ptr<const Image> image) : image(std::move(image)) {}
 
   Texture &addTriangle(Triangle2d triangle) {
     triangles.push_back(triangle);
@@ -70,7 +185,8 @@ public:
   Triangle2d &operator[](size_t index) { return triangles[index]; }
   const Triangle2d &operator[](size_t index) const { return triangles[index]; }
 
-  const Image &getImage() const { return image; }
+  const Image &getImage() const { return *image; }
+  const std::shared_ptr<const Image> &getSharedImage() const { return image; }
 };
 } // namespace seagull
 
@@ -0,0 +1,62 @@
+#ifndef SEAGULL_TEXTURE_ATLAS_H
+#define SEAGULL_TEXTURE_ATLAS_H
+
+#include <memory>
+#include <seagull/atlasPacking.h>
+#include <seagull/texture.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief packs several images into one, so that objects using any of them can
+ * share a single texture on the GPU
+ *
+ * @note add all of the images first, then call build(). After that, textures
+ * made for the individual images can be moved onto the atlas with
+ * remapTexture().
+ *
+ * @note since each image only takes up part of the atlas, texture coordinates
+ * outside of [0, 1] no longer wrap around.
+ */
+class TextureAtlas {
+private:
+  std::vector<Image> images; // Only kept until the atlas is built
+  AtlasLayout layout;
+  size_t padding;
+  std::shared_ptr<const Image> atlasImage;
+
+public:
+  /**
+   * @param padding the number of pixels around each image which are filled
+   * with the image's edge (to stop neighbouring images bleeding in)
+   */
+  TextureAtlas(size_t padding = 4) : padding(padding) {}
+
+  /**
+   * @brief add an image to the atlas
+   *
+   * @return the entry number of the image, used to refer to it later
+   */
+  size_t addImage(Image image);
+
+  /**
+   * @brief pack all of the added images into the atlas image
+   */
+  void build();
+
+  /**
+   * @brief map a texture coordinate for an entry's image onto the atlas
+   */
+  Point2d mapCoordinate(size_t entry, Point2d coordinate) const;
+
+  /**
+   * @brief create a copy of a texture which uses the atlas instead of the
+   * entry's image
+   */
+  Texture remapTexture(const Texture &texture, size_t entry) const;
+
+  const std::shared_ptr<const Image> &getImage() const { return atlasImage; }
+};
+} // namespace seagull
+
+#endif
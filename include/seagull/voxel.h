@@ -0,0 +1,181 @@
+#ifndef SEAGULL_VOXEL_H
+#define SEAGULL_VOXEL_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <seagull/cube.h>
+#include <seagull/indexedMesh.h>
+#include <seagull/mesh.h>
+#include <seagull/raycast.h>
+#include <vector>
+
+namespace seagull {
+class TextureAtlas;
+
+using BlockId = uint16_t;
+static constexpr BlockId AIR = 0;
+
+/**
+ * @brief a cube of blocks
+ *
+ * @note the block at (x, y, z) occupies the unit cube from (x, y, z) to (x + 1,
+ * y + 1, z + 1) in the chunk's coordinates.
+ */
+class VoxelChunk {
+public:
+  static constexpr unsigned SIZE = 16;
+
+private:
+  std::array<BlockId, SIZE * SIZE * SIZE> blocks{};
+
+  static size_t indexOf(unsigned x, unsigned y, unsigned z) {
+    return (y * SIZE + z) * SIZE + x;
+  }
+
+public:
+  BlockId get(unsigned x, unsigned y, unsigned z) const {
+    return blocks[indexOf(x, y, z)];
+  }
+  void set(unsigned x, unsigned y, unsigned z, BlockId block) {
+    blocks[indexOf(x, y, z)] = block;
+  }
+  bool isSolid(unsigned x, unsigned y, unsigned z) const {
+    return get(x, y, z) != AIR;
+  }
+};
+
+/**
+ * @brief which blocks of a region are solid, for casting rays through
+ *
+ * @note this is one bit per block, so a whole world of chunks fits in the
+ * cache far better than the chunks themselves do. The block at (x, y, z)
+ * occupies (x, y, z) to (x + 1, y + 1, z + 1) in the grid's coordinates.
+ */
+class VoxelGrid {
+private:
+  unsigned width, height, depth;
+  std::vector<uint64_t> words;
+
+  size_t indexOf(unsigned x, unsigned y, unsigned z) const {
+    return ((size_t)y * depth + z) * width + x;
+  }
+
+public:
+  VoxelGrid(unsigned width, unsigned height, unsigned depth);
+
+  unsigned getWidth() const { return width; }
+  unsigned getHeight() const { return height; }
+  unsigned getDepth() const { return depth; }
+
+  /**
+   * @return whether the block is solid (blocks outside the grid never are)
+   */
+  bool isSolid(int x, int y, int z) const {
+    if (x < 0 || y < 0 || z < 0 || (unsigned)x >= width ||
+        (unsigned)y >= height || (unsigned)z >= depth) {
+      return false;
+    }
+    size_t index = indexOf(x, y, z);
+    return words[index / 64] >> (index % 64) & 1;
+  }
+  void setSolid(unsigned x, unsigned y, unsigned z, bool solid) {
+    size_t index = indexOf(x, y, z);
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    words[index / 64] = solid ? words[index / 64] | bit
+                              : words[index / 64] & ~bit;
+  }
+
+  /**
+   * @brief copy which blocks of a chunk are solid
+   *
+   * @note (x, y, z) is where the chunk's first block goes. Any of the chunk
+   * which falls outside the grid is left out.
+   */
+  void setChunk(unsigned x, unsigned y, unsigned z, const VoxelChunk &chunk);
+
+  /**
+   * @brief find the first solid block along a ray (see raycastVoxels)
+   *
+   * @note the ray is clipped to the grid first, so it may start outside it,
+   * and an infinite maxDistance is fine.
+   */
+  std::optional<VoxelHit> raycast(const Ray &ray) const;
+};
+
+/**
+ * @brief the appearance of every type of block
+ *
+ * @note all of the block types share one image (usually a texture atlas), so
+ * that a whole chunk can be drawn with one texture.
+ */
+class BlockPalette {
+private:
+  std::shared_ptr<const Image> image;
+  // Indexed by block id, so the first one (air) is never used.
+  std::vector<std::array<TextureRegion, CUBE_FACE_COUNT>> faceRegions;
+
+public:
+  BlockPalette(std::shared_ptr<const Image> image)
+      : image(std::move(image)), faceRegions(1) {}
+
+  /**
+   * @brief add a type of block
+   *
+   * @param imageRegion the part of the palette's image which holds this block's
+   * texture (laid out according to textureType)
+   * @return the id of the new block type
+   */
+  BlockId addBlockType(CubeTextureType textureType,
+                       TextureRegion imageRegion = {{0, 0}, {1, 1}});
+  /**
+   * @brief add a type of block whose texture is an entry in a texture atlas
+   *
+   * @note the palette's image must be the atlas's image.
+   */
+  BlockId addBlockType(CubeTextureType textureType, const TextureAtlas &atlas,
+                       size_t atlasEntry);
+
+  const TextureRegion &getFaceRegion(BlockId block, CubeFace face) const {
+    return faceRegions[block][(unsigned)face];
+  }
+  const std::shared_ptr<const Image> &getImage() const { return image; }
+};
+
+/**
+ * @brief the chunks next to a chunk, indexed by CubeFace
+ *
+ * @note any of these may be null, in which case the faces on that side of the
+ * chunk are always kept.
+ */
+using ChunkNeighbours = std::array<const VoxelChunk *, CUBE_FACE_COUNT>;
+
+/**
+ * @brief which faces of a chunk's blocks to mesh, indexed by CubeFace
+ */
+using ChunkFaces = std::array<bool, CUBE_FACE_COUNT>;
+static constexpr ChunkFaces ALL_CHUNK_FACES = {true, true, true,
+                                               true, true, true};
+
+/**
+ * @brief build a single mesh for a whole chunk
+ *
+ * @note faces between two solid blocks are never visible, so they are left
+ * out. Neighbouring faces which look the same are merged into larger quads
+ * (greedy meshing). A merged quad repeats its texture, which only works along a
+ * texture axis the face's region spans completely, so faces are only merged in
+ * those directions. Faces which use part of an image (such as an atlas entry,
+ * or the top third of a TOP_BOTTOM_SIDES image) therefore merge in one
+ * direction at most. For them to merge in both, give each kind of face a
+ * palette of its own, whose block types use the whole image (SIDES), and mesh
+ * just those faces with it.
+ *
+ * @param faces the faces to include (the rest are left out as if they were
+ * hidden)
+ */
+IndexedMesh meshChunk(const VoxelChunk &chunk, const BlockPalette &palette,
+                      const ChunkNeighbours &neighbours = {},
+                      const ChunkFaces &faces = ALL_CHUNK_FACES);
+} // namespace seagull
+
+#endif
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <assetLoader.h>
+#include <gameObject_internal.h>
+#include <seagull_internal.h>
+#include <stdexcept>
+
+namespace seagull {
+PendingLoad::~PendingLoad() = default;
+
+bool PendingGameObject::isReady() const {
+  return load->stage == PendingLoad::Stage::READY;
+}
+
+bool PendingGameObject::hasFailed() const {
+  return load->stage == PendingLoad::Stage::FAILED;
+}
+
+GameObject PendingGameObject::get() const {
+  switch (load->stage) {
+  case PendingLoad::Stage::READY:
+    return load->gameObject;
+  case PendingLoad::Stage::FAILED:
+    std::rethrow_exception(load->error);
+  default:
+    throw std::logic_error("The game object hasn't finished loading yet");
+  }
+}
+
+AssetLoader::~AssetLoader() {
+  for (const auto &load : loads) {
+    if (load->job) {
+      jobs.wait(load->job);
+      load->job = nullptr; // Breaks the cycle
+    }
+  }
+  if (pixelBuffer) {
+    glDeleteBuffers(1, &pixelBuffer);
+  }
+}
+
+PendingGameObject
+AssetLoader::load(std::function<PreparedGeometry()> prepare, bool addToScene,
+                  std::function<void(GameObject &)> onLoaded) {
+  auto load = std::make_shared<PendingLoad>();
+  load->prepare = std::move(prepare);
+  load->addToScene = addToScene;
+  load->onLoaded = std::move(onLoaded);
+  // The job only ever touches the load. It holds on to it too, which makes a
+  // cycle (through load->job) until the main thread picks up the result.
+  load->job = jobs.submit([load]() {
+    try {
+      load->prepared = std::make_unique<PreparedGeometry>(load->prepare());
+      load->transparent =
+          load->prepared->mesh.getImage().hasTransparency();
+      load->stage = PendingLoad::Stage::PREPARED;
+    } catch (...) {
+      load->error = std::current_exception();
+      load->stage = PendingLoad::Stage::FAILED;
+    }
+  });
+  loads.push_back(load);
+  return PendingGameObject(std::move(load));
+}
+
+void AssetLoader::update(GameContext &gameContext) {
+  using Stage = PendingLoad::Stage;
+  for (const auto &load : loads) {
+    if (load->stage != Stage::PREPARED) {
+      continue;
+    }
+    load->job = nullptr;
+    load->gpuTexture = startStreamingGpuTexture(
+        gameContext, load->prepared->mesh.getSharedImage(),
+        load->transparent);
+    if (!load->gpuTexture->isResident() &&
+        std::find(streamingTextures.begin(), streamingTextures.end(),
+                  load->gpuTexture) == streamingTextures.end()) {
+      streamingTextures.push_back(load->gpuTexture);
+    }
+    load->stage = Stage::UPLOADING;
+  }
+
+  // Textures are streamed in one at a time, so that the first ones become
+  // usable as soon as possible.
+  if (!streamingTextures.empty() && !pixelBuffer) {
+    glGenBuffers(1, &pixelBuffer);
+  }
+  size_t budget = UPLOAD_BUDGET;
+  while (!streamingTextures.empty()) {
+    GpuTexture &texture = *streamingTextures.front();
+    if (budget > 0) {
+      budget -=
+          std::min(budget, streamGpuTexture(texture, budget, pixelBuffer));
+    }
+    if (!texture.isResident()) {
+      break;
+    }
+    streamingTextures.erase(streamingTextures.begin());
+  }
+
+  // Take the finished loads out of the list before calling any callbacks, in
+  // case they start loading more things.
+  std::vector<std::shared_ptr<PendingLoad>> finishedLoads;
+  std::erase_if(loads, [&](const std::shared_ptr<PendingLoad> &load) {
+    bool finished = load->stage == Stage::FAILED ||
+                    (load->stage == Stage::UPLOADING &&
+                     load->gpuTexture->isResident());
+    if (finished) {
+      finishedLoads.push_back(load);
+    }
+    return finished;
+  });
+  for (const auto &load : finishedLoads) {
+    if (load->stage == Stage::FAILED) {
+      load->job = nullptr;
+      continue;
+    }
+    addVertexCacheStats(gameContext.vertexCacheStats,
+                        load->prepared->vertexCacheStats);
+    load->gameObject = addGameObject(
+        gameContext,
+        createGeometry(gameContext.geometryArena, std::move(*load->prepared),
+                       std::move(load->gpuTexture),
+                       gameContext.retainMeshData),
+        load->addToScene);
+    load->prepared.reset();
+    load->prepare = nullptr;
+    load->stage = Stage::READY;
+    if (load->onLoaded) {
+      std::function<void(GameObject &)> onLoaded = std::move(load->onLoaded);
+      onLoaded(load->gameObject);
+    }
+  }
+}
+} // namespace seagull
@@ -0,0 +1,91 @@
+#include <assetPack.h>
+#include <stdexcept>
+
+namespace seagull {
+// Checked like this so that a huge size can't overflow past the end.
+static bool isInFile(uint64_t offset, uint64_t size, size_t fileSize) {
+  return offset <= fileSize && size <= fileSize - offset;
+}
+
+AssetPack::AssetPack(const std::string &fileName) : file(fileName) {
+  size_t fileSize = file.getSize();
+  auto fail = [&](const std::string &reason) {
+    throw std::runtime_error("Invalid asset pack " + fileName + ": " +
+                             reason);
+  };
+  if (fileSize < sizeof(AssetPackHeader)) {
+    fail("too small");
+  }
+  // The mapping is page aligned and every structure is a multiple of 8 bytes,
+  // so these are all suitably aligned.
+  header = (const AssetPackHeader *)file.getData();
+  if (std::memcmp(header->magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC))) {
+    fail("not an asset pack");
+  }
+  if (header->version != ASSET_PACK_VERSION) {
+    fail("version " + std::to_string(header->version) + " (expected " +
+         std::to_string(ASSET_PACK_VERSION) + ")");
+  }
+  uint64_t textureTableSize =
+      (uint64_t)header->textureCount * sizeof(PackedTexture);
+  uint64_t meshTableSize = (uint64_t)header->meshCount * sizeof(PackedMesh);
+  if (!isInFile(sizeof(AssetPackHeader), textureTableSize + meshTableSize,
+                fileSize)) {
+    fail("truncated entry tables");
+  }
+  textures = (const PackedTexture *)(file.getData() + sizeof(AssetPackHeader));
+  meshes = (const PackedMesh *)(textures + header->textureCount);
+
+  for (size_t i = 0; i < header->textureCount; i++) {
+    const PackedTexture &texture = textures[i];
+    uint64_t expectedSize = 0;
+    for (unsigned level = 0; level < texture.mipLevelCount; level++) {
+      expectedSize += (uint64_t)getMipLevelSize(texture.width, level) *
+                      getMipLevelSize(texture.height, level) * 4;
+    }
+    if (texture.width == 0 || texture.height == 0 ||
+        texture.mipLevelCount == 0 || texture.mipLevelCount > 32 ||
+        texture.dataSize != expectedSize ||
+        !isInFile(texture.dataOffset, texture.dataSize, fileSize)) {
+      fail("bad texture " + std::string(getPackedName(texture.name)));
+    }
+  }
+  for (size_t i = 0; i < header->meshCount; i++) {
+    const PackedMesh &mesh = meshes[i];
+    uint64_t vertexBytes = (uint64_t)mesh.vertexCount *
+                           ASSET_PACK_FLOATS_PER_VERTEX * sizeof(float);
+    uint64_t indexBytes = (uint64_t)mesh.indexCount * sizeof(uint32_t);
+    if (mesh.textureIndex >= header->textureCount ||
+        mesh.indexCount % 3 != 0 ||
+        !isInFile(mesh.vertexOffset, vertexBytes, fileSize) ||
+        !isInFile(mesh.indexOffset, indexBytes, fileSize)) {
+      fail("bad mesh " + std::string(getPackedName(mesh.name)));
+    }
+    const uint32_t *indices = (const uint32_t *)at(mesh.indexOffset);
+    for (uint32_t index = 0; index < mesh.indexCount; index++) {
+      if (indices[index] >= mesh.vertexCount) {
+        fail("out of range index in mesh " +
+             std::string(getPackedName(mesh.name)));
+      }
+    }
+  }
+}
+
+const PackedTexture *AssetPack::findTexture(std::string_view name) const {
+  for (size_t i = 0; i < header->textureCount; i++) {
+    if (getPackedName(textures[i].name) == name) {
+      return &textures[i];
+    }
+  }
+  return nullptr;
+}
+
+const PackedMesh *AssetPack::findMesh(std::string_view name) const {
+  for (size_t i = 0; i < header->meshCount; i++) {
+    if (getPackedName(meshes[i].name) == name) {
+      return &meshes[i];
+    }
+  }
+  return nullptr;
+}
+} // namespace seagull
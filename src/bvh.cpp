@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <bvh.h>
+#include <numeric>
+
+namespace seagull {
+void Bvh::build(const std::vector<Eigen::AlignedBox3f> &boxes) {
+  nodes.clear();
+  items.resize(boxes.size());
+  std::iota(items.begin(), items.end(), 0);
+  if (boxes.empty()) {
+    return;
+  }
+  std::vector<Eigen::Vector3f> centres(boxes.size());
+  for (size_t i = 0; i < boxes.size(); i++) {
+    centres[i] = boxes[i].center();
+  }
+  // A balanced tree with up to MAX_LEAF_SIZE items per leaf has fewer than
+  // this many nodes.
+  nodes.reserve(2 * (boxes.size() / MAX_LEAF_SIZE + 1));
+  buildNode(boxes, centres, 0, boxes.size());
+}
+
+void Bvh::buildNode(const std::vector<Eigen::AlignedBox3f> &boxes,
+                    std::vector<Eigen::Vector3f> &centres, uint32_t begin,
+                    uint32_t end) {
+  uint32_t index = nodes.size();
+  nodes.emplace_back();
+  Eigen::AlignedBox3f bounds, centreBounds;
+  for (uint32_t i = begin; i < end; i++) {
+    bounds.extend(boxes[items[i]]);
+    centreBounds.extend(centres[items[i]]);
+  }
+  nodes[index].min = bounds.min();
+  nodes[index].max = bounds.max();
+  if (end - begin <= MAX_LEAF_SIZE) {
+    nodes[index].offset = begin;
+    nodes[index].count = end - begin;
+    return;
+  }
+  int axis;
+  centreBounds.sizes().maxCoeff(&axis);
+  uint32_t middle = begin + (end - begin) / 2;
+  std::nth_element(items.begin() + begin, items.begin() + middle,
+                   items.begin() + end, [&](uint32_t a, uint32_t b) {
+                     return centres[a][axis] < centres[b][axis];
+                   });
+  buildNode(boxes, centres, begin, middle);
+  // Not a reference: building the left child may have reallocated the nodes.
+  nodes[index].offset = nodes.size();
+  nodes[index].count = 0;
+  buildNode(boxes, centres, middle, end);
+}
+
+MeshBvh::MeshBvh(const float *positions, size_t positionStride,
+                 const uint32_t *indices, size_t indexCount) {
+  size_t triangleCount = indexCount / 3;
+  corners.resize(triangleCount * 3);
+  std::vector<Eigen::AlignedBox3f> boxes(triangleCount);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    corners[i] = Eigen::Vector3f(&positions[indices[i] * positionStride]);
+    boxes[i / 3].extend(corners[i]);
+  }
+  bvh.build(boxes);
+}
+
+bool MeshBvh::raycast(const Eigen::Vector3f &origin,
+                      const Eigen::Vector3f &direction, float &maxDistance,
+                      uint32_t &triangle) const {
+  bool hit = false;
+  bvh.raycast(origin, direction, maxDistance,
+              [&](uint32_t item, float &distance) {
+                // Möller-Trumbore: solve for the distance along the ray and
+                // the barycentric coordinates of the hit at the same time.
+                const Eigen::Vector3f *corner = &corners[item * 3];
+                Eigen::Vector3f edge1 = corner[1] - corner[0];
+                Eigen::Vector3f edge2 = corner[2] - corner[0];
+                Eigen::Vector3f p = direction.cross(edge2);
+                float determinant = edge1.dot(p);
+                if (std::abs(determinant) < 1e-12f) {
+                  return; // Parallel to the triangle
+                }
+                float inverse = 1 / determinant;
+                Eigen::Vector3f s = origin - corner[0];
+                float u = s.dot(p) * inverse;
+                if (u < 0 || u > 1) {
+                  return;
+                }
+                Eigen::Vector3f q = s.cross(edge1);
+                float v = direction.dot(q) * inverse;
+                if (v < 0 || u + v > 1) {
+                  return;
+                }
+                float t = edge2.dot(q) * inverse;
+                if (t >= 0 && t < distance) {
+                  distance = t;
+                  triangle = item;
+                  hit = true;
+                }
+              });
+  return hit;
+}
+} // namespace seagull
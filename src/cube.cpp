@@ -0,0 +1,139 @@
+#include <cubeHelper.h>
+
+namespace seagull {
+TextureRegion getCubeFaceRegion(CubeTextureType textureType, CubeFace face,
+                                TextureRegion imageRegion) {
+  static constexpr float ONE_THIRD = 1.0f / 3.0f;
+  static constexpr float TWO_THIRDS = 2.0f / 3.0f;
+  static constexpr float ONE_QUARTER = 1.0f / 4.0f;
+  static constexpr float TWO_QUARTERS = 2.0f / 4.0f;
+  static constexpr float THREE_QUARTERS = 3.0f / 4.0f;
+  TextureRegion region = {{0, 0}, {1, 1}};
+  switch (textureType) {
+  case CubeTextureType::SIDES:
+    break;
+  case CubeTextureType::TOP_BOTTOM_SIDES:
+    if (face == CubeFace::TOP) {
+      region = {{0, 0}, {1, ONE_THIRD}};
+    } else if (face == CubeFace::BOTTOM) {
+      region = {{0, TWO_THIRDS}, {1, 1}};
+    } else {
+      region = {{0, ONE_THIRD}, {1, TWO_THIRDS}};
+    }
+    break;
+  case CubeTextureType::TOP_BOTTOM_FRONT_BACK_LEFT_RIGHT:
+    switch (face) {
+    case CubeFace::FRONT:
+      region = {{ONE_QUARTER, ONE_THIRD}, {TWO_QUARTERS, TWO_THIRDS}};
+      break;
+    case CubeFace::BACK:
+      region = {{THREE_QUARTERS, ONE_THIRD}, {1, TWO_THIRDS}};
+      break;
+    case CubeFace::LEFT:
+      region = {{0, ONE_THIRD}, {ONE_QUARTER, TWO_THIRDS}};
+      break;
+    case CubeFace::RIGHT:
+      region = {{TWO_QUARTERS, ONE_THIRD}, {THREE_QUARTERS, TWO_THIRDS}};
+      break;
+    case CubeFace::TOP:
+      region = {{ONE_QUARTER, 0}, {TWO_QUARTERS, ONE_THIRD}};
+      break;
+    case CubeFace::BOTTOM:
+      region = {{ONE_QUARTER, TWO_THIRDS}, {TWO_QUARTERS, 1}};
+      break;
+    }
+    break;
+  }
+  // Now map the region from the layout onto the part of the image it is in.
+  float width = imageRegion.max.x - imageRegion.min.x;
+  float height = imageRegion.max.y - imageRegion.min.y;
+  return {{imageRegion.min.x + region.min.x * width,
+           imageRegion.min.y + region.min.y * height},
+          {imageRegion.min.x + region.max.x * width,
+           imageRegion.min.y + region.max.y * height}};
+}
+
+const CubeFaceFrame &getCubeFaceFrame(CubeFace face) {
+  // Looking at a face from outside the cube, u goes to the right and v goes
+  // down.
+  static const CubeFaceFrame frames[CUBE_FACE_COUNT] = {
+      {2, false, 0, true, 1, false},  // front
+      {2, true, 0, false, 1, false},  // back
+      {0, false, 2, false, 1, false}, // left
+      {0, true, 2, true, 1, false},   // right
+      {1, true, 0, true, 2, false},   // top
+      {1, false, 0, true, 2, true},   // bottom
+  };
+  return frames[(unsigned)face];
+}
+
+// Work out the corners of a face of a box of blocks (see addCubeFaceQuad).
+static void getCubeFaceCorners(CubeFace face, const unsigned base[3],
+                               unsigned uExtent, unsigned vExtent,
+                               const TextureRegion &region, Point3d origin,
+                               float blockSize, Point3d positions[4],
+                               Point2d coordinates[4]) {
+  const CubeFaceFrame &frame = getCubeFaceFrame(face);
+  // The corners in texture space, in the same order as the quads in the
+  // original cube mesh.
+  const float localCorners[4][2] = {{0, (float)vExtent},
+                                    {(float)uExtent, (float)vExtent},
+                                    {(float)uExtent, 0},
+                                    {0, 0}};
+  for (unsigned corner = 0; corner < 4; corner++) {
+    float u = localCorners[corner][0], v = localCorners[corner][1];
+    float grid[3] = {(float)base[0], (float)base[1], (float)base[2]};
+    grid[frame.normalAxis] += frame.normalPositive ? 1 : 0;
+    grid[frame.uAxis] += frame.uPositive ? u : uExtent - u;
+    grid[frame.vAxis] += frame.vPositive ? v : vExtent - v;
+    positions[corner] = {origin.x + grid[0] * blockSize,
+                         origin.y + grid[1] * blockSize,
+                         origin.z + grid[2] * blockSize};
+    coordinates[corner] = {region.min.x + u * (region.max.x - region.min.x),
+                           region.min.y + v * (region.max.y - region.min.y)};
+  }
+}
+
+void addCubeFaceQuad(Mesh &mesh, Texture &texture, CubeFace face,
+                     const unsigned base[3], unsigned uExtent, unsigned vExtent,
+                     const TextureRegion &region, Point3d origin,
+                     float blockSize) {
+  Point3d positions[4];
+  Point2d coordinates[4];
+  getCubeFaceCorners(face, base, uExtent, vExtent, region, origin, blockSize,
+                     positions, coordinates);
+  mesh.addQuad(positions[0], positions[1], positions[2], positions[3]);
+  texture.addQuad(coordinates[0], coordinates[1], coordinates[2],
+                  coordinates[3]);
+}
+
+void addCubeFaceQuad(IndexedMesh &mesh, CubeFace face, const unsigned base[3],
+                     unsigned uExtent, unsigned vExtent,
+                     const TextureRegion &region, Point3d origin,
+                     float blockSize) {
+  Point3d positions[4];
+  Point2d coordinates[4];
+  getCubeFaceCorners(face, base, uExtent, vExtent, region, origin, blockSize,
+                     positions, coordinates);
+  uint32_t corners[4];
+  for (unsigned corner = 0; corner < 4; corner++) {
+    corners[corner] = mesh.addVertex(positions[corner], coordinates[corner]);
+  }
+  mesh.addQuad(corners[0], corners[1], corners[2], corners[3]);
+}
+
+// The asset packer builds its cube meshes with this (see
+// ASSET_PACK_MESHER_VERSION).
+TexturedMesh createCubeMesh(std::shared_ptr<const Image> image,
+                            CubeTextureType textureType) {
+  Mesh mesh;
+  Texture texture(std::move(image));
+  static const unsigned base[3] = {0, 0, 0};
+  for (unsigned face = 0; face < CUBE_FACE_COUNT; face++) {
+    addCubeFaceQuad(mesh, texture, (CubeFace)face, base, 1, 1,
+                    getCubeFaceRegion(textureType, (CubeFace)face),
+                    {-1, -1, -1}, 2);
+  }
+  return TexturedMesh(std::move(mesh), std::move(texture));
+}
+} // namespace seagull
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <culling.h>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SEAGULL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace seagull {
+// Works out the bounds of every point forEachPoint passes to its callback.
+template <typename ForEachPoint>
+static Bounds fromPoints(const ForEachPoint &forEachPoint) {
+  Bounds bounds;
+  bool empty = true;
+  bounds.min.setConstant(std::numeric_limits<float>::infinity());
+  bounds.max.setConstant(-std::numeric_limits<float>::infinity());
+  forEachPoint([&](const Point3d &point) {
+    Eigen::Vector3f vector(point.x, point.y, point.z);
+    bounds.min = bounds.min.cwiseMin(vector);
+    bounds.max = bounds.max.cwiseMax(vector);
+    empty = false;
+  });
+  if (empty) {
+    return Bounds();
+  }
+  bounds.sphereCenter = (bounds.min + bounds.max) / 2;
+  float radiusSquared = 0;
+  forEachPoint([&](const Point3d &point) {
+    Eigen::Vector3f vector(point.x, point.y, point.z);
+    radiusSquared =
+        std::max(radiusSquared, (vector - bounds.sphereCenter).squaredNorm());
+  });
+  bounds.sphereRadius = std::sqrt(radiusSquared);
+  return bounds;
+}
+
+Bounds Bounds::fromMesh(const Mesh &mesh) {
+  return fromPoints([&](const auto &callback) {
+    for (const Triangle3d &triangle : mesh) {
+      for (const Point3d &point : {triangle.a, triangle.b, triangle.c}) {
+        callback(point);
+      }
+    }
+  });
+}
+
+Bounds Bounds::fromMesh(const IndexedMesh &mesh) {
+  // Each vertex is only visited once, rather than once per triangle.
+  return fromPoints([&](const auto &callback) {
+    for (size_t i = 0; i < mesh.getVertexCount(); i++) {
+      callback(mesh.getPosition(i));
+    }
+  });
+}
+
+Frustum Frustum::fromMatrix(const Eigen::Matrix4f &viewProjection) {
+  // This is the Gribb/Hartmann method: a point is inside the frustum when its
+  // clip coordinates satisfy -w <= x, y, z <= w, and each of those inequalities
+  // is a plane made from the rows of the matrix.
+  Frustum frustum;
+  Eigen::Vector4f rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = viewProjection.row(i).transpose();
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    frustum.planes[axis * 2] = rows[3] + rows[axis];
+    frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+  }
+  for (Eigen::Vector4f &plane : frustum.planes) {
+    plane /= plane.head<3>().norm();
+  }
+  return frustum;
+}
+
+void FrustumCuller::clear() {
+  centerX.clear();
+  centerY.clear();
+  centerZ.clear();
+  radius.clear();
+}
+
+void FrustumCuller::add(const Eigen::Vector3f &center, float sphereRadius) {
+  centerX.push_back(center.x());
+  centerY.push_back(center.y());
+  centerZ.push_back(center.z());
+  radius.push_back(sphereRadius);
+}
+
+size_t FrustumCuller::cull(const Frustum &frustum, JobSystem *jobs) {
+  visible.resize(size());
+  static constexpr size_t MINIMUM_BATCH_SIZE = 8192;
+  if (!jobs) {
+    return cullRange(frustum, 0, size());
+  }
+  std::atomic<size_t> visibleCount = 0;
+  jobs->parallelFor(size(), MINIMUM_BATCH_SIZE,
+                    [&](size_t begin, size_t end) {
+                      visibleCount += cullRange(frustum, begin, end);
+                    });
+  return visibleCount;
+}
+
+size_t FrustumCuller::cullRange(const Frustum &frustum, size_t begin,
+                                size_t end) {
+  size_t visibleCount = 0;
+  size_t i = begin;
+#ifdef SEAGULL_SSE2
+  for (; i + 4 <= end; i += 4) {
+    __m128 x = _mm_loadu_ps(&centerX[i]);
+    __m128 y = _mm_loadu_ps(&centerY[i]);
+    __m128 z = _mm_loadu_ps(&centerZ[i]);
+    __m128 negativeRadius =
+        _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (const Eigen::Vector4f &plane : frustum.planes) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x())),
+                     _mm_mul_ps(y, _mm_set1_ps(plane.y()))),
+          _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z())),
+                     _mm_set1_ps(plane.w())));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+    }
+    int mask = _mm_movemask_ps(inside);
+    for (unsigned lane = 0; lane < 4; lane++) {
+      bool laneVisible = (mask >> lane) & 1;
+      visible[i + lane] = laneVisible;
+      visibleCount += laneVisible;
+    }
+  }
+#endif
+  for (; i < end; i++) {
+    bool sphereVisible = true;
+    for (const Eigen::Vector4f &plane : frustum.planes) {
+      float distance = plane.x() * centerX[i] + plane.y() * centerY[i] +
+                       plane.z() * centerZ[i] + plane.w();
+      if (distance < -radius[i]) {
+        sphereVisible = false;
+        break;
+      }
+    }
+    visible[i] = sphereVisible;
+    visibleCount += sphereVisible;
+  }
+  return visibleCount;
+}
+} // namespace seagull
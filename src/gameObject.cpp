@@ -1,90 +1,118 @@
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <gameObject_internal.h>
-#include <matrixHelper.h>
+#include <stdexcept>
+#include <string>
+#include <vertexIndexer.h>
 
 namespace seagull {
-void buildBuffers(const Mesh &mesh, const Texture &texture, unsigned vertexVbo,
-                  unsigned textureVbo, unsigned indexVbo) {
+// Copy every level's indices into one array, in the type they are uploaded as.
+template <typename Index>
+static std::vector<Index> concatenateIndices(const PreparedGeometry &prepared,
+                                             size_t indexCount) {
+  std::vector<Index> indices;
+  indices.reserve(indexCount);
+  indices.insert(indices.end(), prepared.mesh.getIndices().begin(),
+                 prepared.mesh.getIndices().end());
+  for (const SimplifiedIndices &lod : prepared.lods) {
+    indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+  }
+  return indices;
+}
+
+// Interleave the positions with the texture coordinates, which is how the
+// arena stores vertices.
+static std::vector<float> interleaveVertices(const IndexedMesh &mesh) {
+  const std::vector<float> &positions = mesh.getPositions();
+  const std::vector<float> &textureCoordinates = mesh.getTextureCoordinates();
   std::vector<float> vertices;
-  std::vector<float> textureCoordinates;
-  std::vector<unsigned> indices;
-  // To save on space, we don't store duplicate vertices. That is why we have
-  // this index vbo: to specify the indices of each vertex.
-  assert(mesh.size() == texture.size());
-  for (size_t i = 0; i < mesh.size(); i++) {
-    const Triangle3d &meshTriangle = mesh[i];
-    const Triangle2d &textureTriangle = texture[i];
-    // Unfortunately, there is no way to iterate through the points of a
-    // triangle. We'll just create an array and iterate through that.
-    const Point3d meshPoints[3] = {meshTriangle.a, meshTriangle.b,
-                                   meshTriangle.c};
-    const Point2d texturePoints[3] = {textureTriangle.a, textureTriangle.b,
-                                      textureTriangle.c};
-    for (size_t pointIndex = 0; pointIndex < 3; pointIndex++) {
-      const Point3d &meshPoint = meshPoints[pointIndex];
-      const Point2d &texturePoint = texturePoints[pointIndex];
-      // If there is already an identical vertex/texture coordinate combination,
-      // we can just use that index. Otherwise, we'll add a new vertex/texture
-      // coordinate combination.
-      bool found = false;
-      for (size_t j = 0; j < vertices.size() / 3; j++) {
-        if (vertices[j * 3] == meshPoint.x &&
-            vertices[j * 3 + 1] == meshPoint.y &&
-            vertices[j * 3 + 2] == meshPoint.z &&
-            textureCoordinates[j * 2] == texturePoint.x &&
-            textureCoordinates[j * 2 + 1] == texturePoint.y) {
-          indices.push_back(j);
-          found = true;
-          break;
-        }
-      }
-      if (!found) {
-        indices.push_back(vertices.size() / 3 /* floats per vertex */);
-        vertices.push_back(meshPoint.x);
-        vertices.push_back(meshPoint.y);
-        vertices.push_back(meshPoint.z);
-        textureCoordinates.push_back(texturePoint.x);
-        textureCoordinates.push_back(texturePoint.y);
-      }
-    }
+  vertices.reserve(mesh.getVertexCount() * GeometryArena::FLOATS_PER_VERTEX);
+  for (size_t i = 0; i < mesh.getVertexCount(); i++) {
+    vertices.insert(vertices.end(), &positions[i * 3], &positions[i * 3 + 3]);
+    vertices.insert(vertices.end(), &textureCoordinates[i * 2],
+                    &textureCoordinates[i * 2 + 2]);
+  }
+  return vertices;
+}
+
+// Allocate room for the geometry in the arena and upload it there. Returns
+// the type of the indices.
+static GLenum uploadGeometry(const PreparedGeometry &prepared,
+                             GeometryArena &arena,
+                             GeometryArena::Allocation &allocation) {
+  const IndexedMesh &mesh = prepared.mesh;
+  const std::vector<uint32_t> &indices = mesh.getIndices();
+  std::vector<float> vertices = interleaveVertices(mesh);
+  size_t vertexBytes = vertices.size() * sizeof(float);
+  // The levels of detail go straight after the full mesh's indices.
+  size_t indexCount = indices.size();
+  for (const SimplifiedIndices &lod : prepared.lods) {
+    indexCount += lod.indices.size();
+  }
+  // Most meshes have few enough vertices for 16-bit indices, which halves
+  // the size of their indices (and the bandwidth used to read them).
+  if (mesh.getVertexCount() <= (size_t)UINT16_MAX + 1) {
+    std::vector<uint16_t> shortIndices =
+        concatenateIndices<uint16_t>(prepared, indexCount);
+    size_t indexBytes = indexCount * sizeof(uint16_t);
+    allocation = arena.allocate(mesh.getVertexCount(), indexBytes);
+    arena.write(allocation, vertices.data(), vertexBytes, shortIndices.data(),
+                indexBytes);
+    return GL_UNSIGNED_SHORT;
   }
-  // Now that we have the vertices, texture coordinates, and indices, we can
-  // build the buffers. This is the easy bit.
-  glBindBuffer(GL_ARRAY_BUFFER, vertexVbo);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
-               vertices.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, textureVbo);
-  glBufferData(GL_ARRAY_BUFFER, textureCoordinates.size() * sizeof(float),
-               textureCoordinates.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexVbo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned),
-               indices.data(), GL_STATIC_DRAW);
-}
-
-GameObject::GameObject(TexturedMesh mesh) {
-  state = std::make_unique<GameObjectState>();
-  state->geometry = std::make_unique<GameObjectGeometry>(
-      std::move(mesh.mesh), std::move(mesh.texture));
-  auto &geometry = *state->geometry;
-  unsigned &vao = geometry.vao;
-  unsigned &vertexVbo = geometry.vertexVbo;
-  unsigned &indexVbo = geometry.indexVbo;
-  unsigned &textureVbo = geometry.textureVbo;
-  glGenVertexArrays(1, &vao);
-  glGenBuffers(1, &vertexVbo);
-  glGenBuffers(1, &indexVbo);
-  glGenBuffers(1, &textureVbo);
-  glBindVertexArray(vao);
-  buildBuffers(geometry.mesh, geometry.texture, vertexVbo, textureVbo,
-               indexVbo);
-  glBindBuffer(GL_ARRAY_BUFFER, vertexVbo);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glEnableVertexAttribArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, textureVbo);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glEnableVertexAttribArray(1);
-  glBindVertexArray(0);
-  // We also have to build the texture.
+  size_t indexBytes = indexCount * sizeof(uint32_t);
+  allocation = arena.allocate(mesh.getVertexCount(), indexBytes);
+  if (prepared.lods.empty()) {
+    arena.write(allocation, vertices.data(), vertexBytes, indices.data(),
+                indexBytes);
+  } else {
+    std::vector<uint32_t> allIndices =
+        concatenateIndices<uint32_t>(prepared, indexCount);
+    arena.write(allocation, vertices.data(), vertexBytes, allIndices.data(),
+                indexBytes);
+  }
+  return GL_UNSIGNED_INT;
+}
+
+static GLenum getPixelType(const Image &image) {
+  // The image is already laid out the way OpenGL expects, so we just have to
+  // tell it which type each channel is.
+  return image.format == PixelFormat::RGBA8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+}
+
+// Upload every mip level of a block-compressed image to the bound texture. The
+// blocks are already in the GPU's own format, so this is a straight copy (and
+// is a quarter to an eighth of the size of the pixels), which is why it isn't
+// streamed over several frames.
+static void uploadCompressedImage(const Image &image) {
+  GLenum internalFormat = image.format == PixelFormat::BC1
+                              ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+                              : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  size_t blockSize = Image::getBytesPerBlock(image.format);
+  const unsigned char *level = image.data.data();
+  for (unsigned i = 0; i < image.mipLevelCount; i++) {
+    size_t width = getMipLevelSize(image.width, i);
+    size_t height = getMipLevelSize(image.height, i);
+    size_t size = (width + 3) / 4 * ((height + 3) / 4) * blockSize;
+    glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, width, height, 0,
+                           size, level);
+    level += size;
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  image.mipLevelCount - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// Create a texture with room for the image, but none of its pixels yet
+// (unless it is block-compressed, in which case it is uploaded straight away).
+static std::shared_ptr<GpuTexture>
+createGpuTexture(std::shared_ptr<const Image> imagePointer, bool transparent) {
+  auto gpuTexture = std::make_shared<GpuTexture>();
   // It's interesting to note that, although OpenGL usually has a texture
   // coordinate origin of the bottom-left, what it really means is that textures
   // are usually layed out this way in memory. In other words, OpenGL simply
@@ -96,131 +124,485 @@ GameObject::GameObject(TexturedMesh mesh) {
   // image".
   // Ref:
   // https://registry.khronos.org/OpenGL-Refpages/gl4/html/glTexImage2D.xhtml
-  unsigned &textureId = geometry.textureId;
-  glGenTextures(1, &textureId);
-  glBindTexture(GL_TEXTURE_2D, textureId);
-  const Image &image = geometry.texture.getImage();
-  // This code will not work if the color struct has padding. This is because it
-  // uploads the floats to the GPU as an array of floats, which means our color
-  // struct must also be an array of floats (or equivalent to one).
-  static_assert(sizeof(Color) == 4 * sizeof(float),
-                "Color struct must be 4 packed floats");
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA,
-               GL_FLOAT, image.pixels.data());
-  glGenerateMipmap(GL_TEXTURE_2D);
+  glGenTextures(1, &gpuTexture->id);
+  glBindTexture(GL_TEXTURE_2D, gpuTexture->id);
+  gpuTexture->transparent = transparent;
+  gpuTexture->image = imagePointer;
+  if (imagePointer->isCompressed()) {
+    if (GLEW_EXT_texture_compression_s3tc) {
+      uploadCompressedImage(*imagePointer);
+      return gpuTexture;
+    }
+    // Almost every desktop driver can sample these directly, but if this one
+    // can't, fall back to decoding it.
+    imagePointer = std::make_shared<const Image>(
+        decompressImage(*imagePointer));
+  }
+  const Image &image = *imagePointer;
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0,
+               GL_RGBA, getPixelType(image), nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  gpuTexture->streamingImage = std::move(imagePointer);
+  return gpuTexture;
+}
+
+// Whether a cached texture was made from this image, rather than from one
+// which used to live at the same address.
+static bool isTextureOf(const GpuTexture &gpuTexture,
+                        const std::shared_ptr<const Image> &image) {
+  return !gpuTexture.image.owner_before(image) &&
+         !image.owner_before(gpuTexture.image);
+}
+
+size_t streamGpuTexture(GpuTexture &gpuTexture, size_t byteBudget,
+                        unsigned pixelBuffer) {
+  if (gpuTexture.isResident()) {
+    return 0;
+  }
+  const Image &image = *gpuTexture.streamingImage;
+  size_t rowBytes = image.width * image.getBytesPerPixel();
+  size_t remainingRows = image.height - gpuTexture.streamedRows;
+  // Always make some progress, even if a single row is over the budget.
+  size_t rows = std::clamp<size_t>(rowBytes ? byteBudget / rowBytes : 0, 1,
+                                   remainingRows);
+  size_t bytes = rows * rowBytes;
+  const unsigned char *source =
+      image.data.data() + gpuTexture.streamedRows * rowBytes;
+  glBindTexture(GL_TEXTURE_2D, gpuTexture.id);
+  if (pixelBuffer && bytes > 0) {
+    // Copying into a pixel buffer is all we do on this thread. The driver
+    // transfers the pixels into the texture whenever it gets round to it,
+    // rather than making us wait.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void *mapping =
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    std::memcpy(mapping, source, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    source = nullptr; // Now an offset into the pixel buffer
+  }
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, gpuTexture.streamedRows, image.width,
+                  rows, GL_RGBA, getPixelType(image), source);
+  if (pixelBuffer) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  gpuTexture.streamedRows += rows;
+  if (gpuTexture.streamedRows == image.height) {
+    glGenerateMipmap(GL_TEXTURE_2D);
+    gpuTexture.streamingImage.reset();
+  }
+  return bytes;
+}
+
+static constexpr size_t MIN_GPU_TEXTURES_PRUNE_SIZE = 64;
+
+// Forget the textures which have been destroyed, so that gpuTextures doesn't
+// grow for as long as the game runs. Only sweeping once it has doubled in size
+// since the last time keeps this cheap, however many textures come and go.
+// This must be done before looking anything up, since it may erase the entry.
+static void pruneGpuTextures(GameContext &gameContext) {
+  auto &textures = gameContext.gpuTextures;
+  if (textures.size() < gameContext.gpuTexturesPruneSize) {
+    return;
+  }
+  std::erase_if(textures,
+                [](const auto &entry) { return entry.second.expired(); });
+  gameContext.gpuTexturesPruneSize =
+      std::max<size_t>(MIN_GPU_TEXTURES_PRUNE_SIZE, textures.size() * 2);
+}
+
+std::shared_ptr<GpuTexture>
+startStreamingGpuTexture(GameContext &gameContext,
+                         const std::shared_ptr<const Image> &imagePointer,
+                         bool transparent) {
+  pruneGpuTextures(gameContext);
+  auto &cachedTexture = gameContext.gpuTextures[imagePointer.get()];
+  auto existingTexture = cachedTexture.lock();
+  if (existingTexture && isTextureOf(*existingTexture, imagePointer)) {
+    return existingTexture;
+  }
+  auto gpuTexture = createGpuTexture(imagePointer, transparent);
+  cachedTexture = gpuTexture;
+  return gpuTexture;
+}
+
+std::shared_ptr<GpuTexture>
+getGpuTexture(GameContext &gameContext,
+              const std::shared_ptr<const Image> &imagePointer) {
+  pruneGpuTextures(gameContext);
+  auto &cachedTexture = gameContext.gpuTextures[imagePointer.get()];
+  auto gpuTexture = cachedTexture.lock();
+  if (!gpuTexture || !isTextureOf(*gpuTexture, imagePointer)) {
+    gpuTexture =
+        createGpuTexture(imagePointer, imagePointer->hasTransparency());
+    cachedTexture = gpuTexture;
+  }
+  // This might be a texture which is still being streamed in, in which case we
+  // finish it off now.
+  streamGpuTexture(*gpuTexture, SIZE_MAX, 0);
+  return gpuTexture;
+}
+
+GpuTexture::~GpuTexture() { glDeleteTextures(1, &id); }
+
+static uint16_t allocateGeometryId() {
+  static uint16_t nextGeometryId = 0;
+  return nextGeometryId++;
+}
+
+PreparedGeometry prepareGeometry(TexturedMesh mesh,
+                                 const GeometryOptions &options,
+                                 JobSystem *jobs) {
+  // To save on space, we don't store duplicate vertices. That is why we have
+  // an index vbo: to specify the indices of each vertex.
+  IndexedVertices vertices = indexVertices(mesh.mesh, mesh.texture, jobs);
+  IndexedMesh indexedMesh(mesh.texture.getSharedImage(),
+                          std::move(vertices.vertices),
+                          std::move(vertices.textureCoordinates),
+                          std::move(vertices.indices));
+  return prepareGeometry(std::move(indexedMesh), options);
+}
+
+// Reorder a set of triangles for the vertex cache (and then for overdraw).
+static void optimizeIndices(std::vector<uint32_t> &indices,
+                            const IndexedMesh &mesh,
+                            const GeometryOptions &options) {
+  std::vector<size_t> clusterStarts;
+  optimizeVertexCache(indices, mesh.getVertexCount(), &clusterStarts);
+  if (options.optimizeOverdraw) {
+    optimizeOverdraw(indices, mesh.getPositions(), clusterStarts);
+  }
+}
+
+PreparedGeometry prepareGeometry(IndexedMesh mesh,
+                                 const GeometryOptions &options) {
+  size_t vertexCount = mesh.getVertexCount();
+  if (mesh.getPositions().size() % 3 != 0) {
+    throw std::invalid_argument("Every position must have 3 coordinates");
+  }
+  if (mesh.getIndices().size() % 3 != 0) {
+    throw std::invalid_argument("Every triangle must have 3 indices");
+  }
+  if (mesh.getTextureCoordinates().size() != vertexCount * 2) {
+    throw std::invalid_argument(
+        "Every vertex must have a position and a texture coordinate");
+  }
+  for (uint32_t index : mesh.getIndices()) {
+    if (index >= vertexCount) {
+      throw std::invalid_argument("Index " + std::to_string(index) +
+                                  " is past the last vertex");
+    }
+  }
+  Bounds bounds = Bounds::fromMesh(mesh);
+  std::vector<SimplifiedIndices> lods;
+  if (options.generateLods) {
+    lods = buildLodChain(mesh);
+  }
+
+  VertexCacheStats stats{1, mesh.getTriangleCount()};
+  std::vector<uint32_t> indices = mesh.getIndices();
+  stats.missesBefore = countVertexCacheMisses(indices, vertexCount);
+  optimizeIndices(indices, mesh, options);
+  stats.missesAfter = countVertexCacheMisses(indices, vertexCount);
+  mesh.setIndices(std::move(indices));
+  for (SimplifiedIndices &lod : lods) {
+    optimizeIndices(lod.indices, mesh, options);
+  }
+  // Built after reordering, so that its triangles are the uploaded ones.
+  std::shared_ptr<const MeshBvh> bvh;
+  if (options.buildRaycastBvh) {
+    bvh = std::make_shared<const MeshBvh>(mesh.getPositions().data(), 3,
+                                          mesh.getIndices().data(),
+                                          mesh.getIndices().size());
+  }
+  return {std::move(mesh), bounds, std::move(lods), stats, std::move(bvh)};
+}
+
+std::shared_ptr<GameObjectGeometry>
+createGeometry(GeometryArena &arena, PreparedGeometry prepared,
+               std::shared_ptr<GpuTexture> gpuTexture, bool retainMesh) {
+  auto geometryPointer = std::make_shared<GameObjectGeometry>();
+  auto &geometry = *geometryPointer;
+  geometry.id = allocateGeometryId();
+  geometry.bounds = prepared.bounds;
+  geometry.bvh = std::move(prepared.bvh);
+  geometry.indexType = uploadGeometry(prepared, arena, geometry.allocation);
+  geometry.arena = &arena;
+  geometry.indexCount = prepared.mesh.getIndices().size();
+  geometry.lods.push_back({0, geometry.indexCount, 0});
+  for (const SimplifiedIndices &lod : prepared.lods) {
+    const GameObjectGeometry::LodLevel &previous = geometry.lods.back();
+    geometry.lods.push_back({previous.firstIndex + previous.indexCount,
+                             lod.indices.size(), lod.error});
+  }
+  geometry.gpuTexture = std::move(gpuTexture);
+  geometry.transparent = geometry.gpuTexture->transparent;
+  // Otherwise the vertices (and the image, unless something else holds on to
+  // it) are freed as soon as we return.
+  if (retainMesh) {
+    geometry.mesh = std::move(prepared.mesh);
+  }
+  return geometryPointer;
+}
+
+std::shared_ptr<GpuTexture> getPackedGpuTexture(GameContext &gameContext,
+                                                const AssetPack &pack,
+                                                const PackedTexture &texture) {
+  pruneGpuTextures(gameContext);
+  auto &cachedTexture = gameContext.gpuTextures[&texture];
+  if (auto existingTexture = cachedTexture.lock()) {
+    return existingTexture;
+  }
+  auto gpuTexture = std::make_shared<GpuTexture>();
+  glGenTextures(1, &gpuTexture->id);
+  glBindTexture(GL_TEXTURE_2D, gpuTexture->id);
+  // The mip levels were made by the packer, so there is nothing to generate.
+  const unsigned char *level = pack.at(texture.dataOffset);
+  for (unsigned i = 0; i < texture.mipLevelCount; i++) {
+    size_t width = getMipLevelSize(texture.width, i);
+    size_t height = getMipLevelSize(texture.height, i);
+    glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, level);
+    level += width * height * 4;
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  texture.mipLevelCount - 1);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                   GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  gpuTexture->transparent = texture.transparent;
+  cachedTexture = gpuTexture;
+  return gpuTexture;
+}
+
+std::shared_ptr<GameObjectGeometry>
+createPackedGeometry(GeometryArena &arena, const AssetPack &pack,
+                     const PackedMesh &mesh,
+                     std::shared_ptr<GpuTexture> gpuTexture,
+                     bool buildRaycastBvh) {
+  static_assert(ASSET_PACK_FLOATS_PER_VERTEX ==
+                    GeometryArena::FLOATS_PER_VERTEX,
+                "Packed vertices must be laid out as the arena stores them");
+  auto geometryPointer = std::make_shared<GameObjectGeometry>();
+  auto &geometry = *geometryPointer;
+  geometry.id = allocateGeometryId();
+  geometry.bounds.min = Eigen::Vector3f(mesh.boundsMin);
+  geometry.bounds.max = Eigen::Vector3f(mesh.boundsMax);
+  geometry.bounds.sphereCenter = Eigen::Vector3f(mesh.sphereCenter);
+  geometry.bounds.sphereRadius = mesh.sphereRadius;
+  // Straight from the mapping: the driver's copy is the only one we make.
+  size_t indexBytes = mesh.indexCount * sizeof(uint32_t);
+  geometry.allocation = arena.allocate(mesh.vertexCount, indexBytes);
+  geometry.arena = &arena;
+  arena.write(geometry.allocation, pack.at(mesh.vertexOffset),
+              mesh.vertexCount * GeometryArena::VERTEX_SIZE,
+              pack.at(mesh.indexOffset), indexBytes);
+  geometry.indexCount = mesh.indexCount;
+  geometry.lods.push_back({0, geometry.indexCount, 0});
+  if (buildRaycastBvh) {
+    geometry.bvh = std::make_shared<const MeshBvh>(
+        (const float *)pack.at(mesh.vertexOffset),
+        ASSET_PACK_FLOATS_PER_VERTEX,
+        (const uint32_t *)pack.at(mesh.indexOffset), mesh.indexCount);
+  }
+  geometry.gpuTexture = std::move(gpuTexture);
+  geometry.transparent = geometry.gpuTexture->transparent;
+  return geometryPointer;
 }
 
-GameObject::GameObject(GameObjectState state)
-    : state(std::make_unique<GameObjectState>(std::move(state))) {}
+std::shared_ptr<GameObjectGeometry>
+getPackedGeometry(GameContext &gameContext, const AssetPack &pack,
+                  const PackedMesh &mesh) {
+  bool buildRaycastBvh = gameContext.geometryOptions.buildRaycastBvh;
+  auto &cachedGeometry = gameContext.packedGeometries[&mesh];
+  // Geometry without a BVH can't be hit by rays, so it's no good once they
+  // have been turned on.
+  if (auto existingGeometry = cachedGeometry.lock();
+      existingGeometry && (existingGeometry->bvh || !buildRaycastBvh)) {
+    return existingGeometry;
+  }
+  auto geometry = createPackedGeometry(
+      gameContext.geometryArena, pack, mesh,
+      getPackedGpuTexture(gameContext, pack,
+                          pack.getTexture(mesh.textureIndex)),
+      buildRaycastBvh);
+  cachedGeometry = geometry;
+  return geometry;
+}
+
+GameObject addGameObject(GameContext &gameContext,
+                         std::shared_ptr<GameObjectGeometry> geometry,
+                         bool addToScene) {
+  GameObjectState state;
+  state.geometry = std::move(geometry);
+  state.transforms = &gameContext.transforms;
+  state.transformSlot = gameContext.transforms.allocate();
+  auto &objects =
+      addToScene ? gameContext.gameObjects : gameContext.templateGameObjects;
+  gameContext.sceneChanges++;
+  if (gameContext.simulation.isRunning()) {
+    gameContext.newTransformSlots.push_back(state.transformSlot);
+  }
+  return GameObject(objects, objects.insert(std::move(state)));
+}
+
+IndexedMesh readBackGeometry(const GameObjectGeometry &geometry) {
+  if (geometry.mesh) {
+    return *geometry.mesh;
+  }
+  const GeometryArena &arena = *geometry.arena;
+  size_t vertexCount = arena.getVertexCount(geometry.allocation);
+  std::vector<float> interleaved(vertexCount *
+                                 GeometryArena::FLOATS_PER_VERTEX);
+  arena.readVertices(geometry.allocation, interleaved.data(),
+                     interleaved.size() * sizeof(float));
+  std::vector<float> positions, textureCoordinates;
+  positions.reserve(vertexCount * 3);
+  textureCoordinates.reserve(vertexCount * 2);
+  for (size_t i = 0; i < vertexCount; i++) {
+    const float *vertex = &interleaved[i * GeometryArena::FLOATS_PER_VERTEX];
+    positions.insert(positions.end(), vertex, vertex + 3);
+    textureCoordinates.insert(textureCoordinates.end(), vertex + 3,
+                              vertex + 5);
+  }
+  // Just the full mesh, not its levels of detail.
+  std::vector<uint32_t> indices;
+  if (geometry.indexType == GL_UNSIGNED_SHORT) {
+    std::vector<uint16_t> shortIndices(geometry.indexCount);
+    arena.readIndices(geometry.allocation, shortIndices.data(),
+                      shortIndices.size() * sizeof(uint16_t));
+    indices.assign(shortIndices.begin(), shortIndices.end());
+  } else {
+    indices.resize(geometry.indexCount);
+    arena.readIndices(geometry.allocation, indices.data(),
+                      indices.size() * sizeof(uint32_t));
+  }
+
+  glBindTexture(GL_TEXTURE_2D, geometry.gpuTexture->id);
+  GLint width = 0, height = 0;
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  // Every row of RGBA8 pixels is a multiple of 4 bytes long, so the default
+  // pack alignment is fine.
+  std::vector<unsigned char> pixels((size_t)width * height * 4);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+  return IndexedMesh(
+      std::make_shared<const Image>(width, height, std::move(pixels)),
+      std::move(positions), std::move(textureCoordinates), std::move(indices));
+}
 
 GameObjectGeometry::~GameObjectGeometry() {
-  glDeleteVertexArrays(1, &vao);
-  glDeleteBuffers(1, &vertexVbo);
-  glDeleteBuffers(1, &indexVbo);
-  glDeleteBuffers(1, &textureVbo);
-  glDeleteTextures(1, &textureId);
-}
-
-GameObject::~GameObject() = default;
-
-// All of the following recalculateXMatrices functions follow the same
-// structure:
-// 1. Calculate the new matrix for the particular transform.
-// 2. If the cached matrix for the other two transforms is null, we multiply its
-// components and cache it in the state.
-// 3. Multiply the new matrix for the transform we are calculating with the
-// cached matrix for the other two transforms.
-// 4. Invalidate the caches for the two cached matrices which depend on the
-// transform we are calculating.
-// According to my maths, the scale matrix is commutative (as it is a multiple
-// of the identity matrix). The translate matrix must be multiplied as the
-// leftmost matrix. The rotation matrix must be multiplied as the rightmost
-// matrix.
-
-void recalculateTranslationMatrices(GameObjectState &state) {
-  state.translationMatrix = getTranslateMatrix(state.translation);
-  if (!state.rotateScaleMatrix) {
-    state.rotateScaleMatrix = state.rotationMatrix * state.scaleMatrix;
-  }
-  state.totalTransformationMatrix =
-      state.translationMatrix * *state.rotateScaleMatrix;
-  state.translateRotateMatrix.reset();
-  state.translateScaleMatrix.reset();
-}
-
-void recalculateRotationMatrices(GameObjectState &state) {
-  state.rotationMatrix = getRotateMatrix(state.rotation);
-  if (!state.translateScaleMatrix) {
-    state.translateScaleMatrix = state.translationMatrix * state.scaleMatrix;
-  }
-  state.totalTransformationMatrix =
-      *state.translateScaleMatrix * state.rotationMatrix;
-  state.translateRotateMatrix.reset();
-  state.rotateScaleMatrix.reset();
-}
-
-void recalculateScaleMatrices(GameObjectState &state) {
-  state.scaleMatrix = getScaleMatrix(state.scale);
-  if (!state.translateRotateMatrix) {
-    state.translateRotateMatrix =
-        state.translationMatrix * state.rotationMatrix;
-  }
-  state.totalTransformationMatrix =
-      *state.translateRotateMatrix * state.scaleMatrix;
-  state.rotateScaleMatrix.reset();
-  state.translateScaleMatrix.reset();
+  if (arena) {
+    arena->free(allocation);
+  }
+}
+
+bool GameObject::isValid() const {
+  return objects && objects->contains(handle);
 }
 
+GameObjectState &GameObject::getState() const {
+  GameObjectState *state = objects ? objects->get(handle) : nullptr;
+  if (!state) {
+    throw std::logic_error("The game object doesn't exist");
+  }
+  return *state;
+}
+
+// The setters only record the new value and mark the transform as dirty. The
+// world matrices of everything which changed are worked out together just
+// before the next frame is drawn (see TransformStore::update).
+
 void GameObject::setTranslateX(float value) {
-  auto &translation = state->translation;
-  translation.x() = value;
-  recalculateTranslationMatrices(*state);
+  GameObjectState &state = getState();
+  state.transforms->translateX[state.transformSlot] = value;
+  state.transforms->markDirty(state.transformSlot);
 }
 void GameObject::setTranslateY(float value) {
-  auto &translation = state->translation;
-  translation.y() = value;
-  recalculateTranslationMatrices(*state);
+  GameObjectState &state = getState();
+  state.transforms->translateY[state.transformSlot] = value;
+  state.transforms->markDirty(state.transformSlot);
 }
 void GameObject::setTranslateZ(float value) {
-  auto &translation = state->translation;
-  translation.z() = value;
-  recalculateTranslationMatrices(*state);
+  GameObjectState &state = getState();
+  state.transforms->translateZ[state.transformSlot] = value;
+  state.transforms->markDirty(state.transformSlot);
 }
 
 void GameObject::setRotateX(float radians) {
-  auto &rotation = state->rotation;
-  rotation.x() = radians;
-  recalculateRotationMatrices(*state);
+  GameObjectState &state = getState();
+  state.transforms->rotateX[state.transformSlot] = radians;
+  state.transforms->markDirty(state.transformSlot);
 }
 void GameObject::setRotateY(float radians) {
-  auto &rotation = state->rotation;
-  rotation.y() = radians;
-  recalculateRotationMatrices(*state);
+  GameObjectState &state = getState();
+  state.transforms->rotateY[state.transformSlot] = radians;
+  state.transforms->markDirty(state.transformSlot);
 }
 void GameObject::setRotateZ(float radians) {
-  auto &rotation = state->rotation;
-  rotation.z() = radians;
-  recalculateRotationMatrices(*state);
+  GameObjectState &state = getState();
+  state.transforms->rotateZ[state.transformSlot] = radians;
+  state.transforms->markDirty(state.transformSlot);
 }
 
 void GameObject::setScale(float value) {
-  state->scale = value;
-  recalculateScaleMatrices(*state);
+  GameObjectState &state = getState();
+  state.transforms->scale[state.transformSlot] = value;
+  state.transforms->markDirty(state.transformSlot);
+}
+
+void GameObject::setTransform(Point3d translation, Point3d rotation,
+                              float scale) {
+  GameObjectState &state = getState();
+  TransformStore &transforms = *state.transforms;
+  uint32_t slot = state.transformSlot;
+  transforms.translateX[slot] = translation.x;
+  transforms.translateY[slot] = translation.y;
+  transforms.translateZ[slot] = translation.z;
+  transforms.rotateX[slot] = rotation.x;
+  transforms.rotateY[slot] = rotation.y;
+  transforms.rotateZ[slot] = rotation.z;
+  transforms.scale[slot] = scale;
+  transforms.markDirty(slot);
 }
 
 // These are less complex.
-float GameObject::getTranslateX() const { return state->translation.x(); }
-float GameObject::getTranslateY() const { return state->translation.y(); }
-float GameObject::getTranslateZ() const { return state->translation.z(); }
+float GameObject::getTranslateX() const {
+  const GameObjectState &state = getState();
+  return state.transforms->translateX[state.transformSlot];
+}
+float GameObject::getTranslateY() const {
+  const GameObjectState &state = getState();
+  return state.transforms->translateY[state.transformSlot];
+}
+float GameObject::getTranslateZ() const {
+  const GameObjectState &state = getState();
+  return state.transforms->translateZ[state.transformSlot];
+}
 
-float GameObject::getRotateX() const { return state->rotation.x(); }
-float GameObject::getRotateY() const { return state->rotation.y(); }
-float GameObject::getRotateZ() const { return state->rotation.z(); }
+float GameObject::getRotateX() const {
+  const GameObjectState &state = getState();
+  return state.transforms->rotateX[state.transformSlot];
+}
+float GameObject::getRotateY() const {
+  const GameObjectState &state = getState();
+  return state.transforms->rotateY[state.transformSlot];
+}
+float GameObject::getRotateZ() const {
+  const GameObjectState &state = getState();
+  return state.transforms->rotateZ[state.transformSlot];
+}
 
-float GameObject::getScale() const { return state->scale; }
+float GameObject::getScale() const {
+  const GameObjectState &state = getState();
+  return state.transforms->scale[state.transformSlot];
+}
 } // namespace seagull
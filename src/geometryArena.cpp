@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cassert>
+#include <geometryArena.h>
+#include <iterator>
+#include <renderer.h>
+
+namespace seagull {
+// Room for a few thousand small meshes before the buffers have to grow.
+static constexpr size_t MINIMUM_VERTEX_CAPACITY = 65536;
+static constexpr size_t MINIMUM_INDEX_WORDS = 262144;
+// Compacting copies the whole buffer, which isn't worth it for a few holes.
+static constexpr size_t MINIMUM_COMPACTION_BYTES = 1 << 20;
+
+static_assert(sizeof(DrawCommand) == 5 * sizeof(uint32_t),
+              "Draw commands must be tightly packed");
+
+std::optional<size_t> RangeAllocator::allocate(size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range) {
+    auto [offset, rangeSize] = *range;
+    if (rangeSize < size) {
+      continue;
+    }
+    freeRanges.erase(range);
+    if (rangeSize > size) {
+      freeRanges.emplace(offset + size, rangeSize - size);
+    }
+    used += size;
+    return offset;
+  }
+  return std::nullopt;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  used -= size;
+  auto next = freeRanges.lower_bound(offset);
+  if (next != freeRanges.end() && next->first == offset + size) {
+    size += next->second;
+    next = freeRanges.erase(next);
+  }
+  if (next != freeRanges.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      previous->second += size;
+      return;
+    }
+  }
+  freeRanges.emplace_hint(next, offset, size);
+}
+
+void RangeAllocator::reset(size_t newCapacity, size_t usedSize) {
+  freeRanges.clear();
+  capacity = newCapacity;
+  used = usedSize;
+  if (used < capacity) {
+    freeRanges.emplace(used, capacity - used);
+  }
+}
+
+size_t RangeAllocator::getFragmentedSpace() const {
+  size_t free = capacity - used;
+  if (!freeRanges.empty()) {
+    const auto &[offset, size] = *freeRanges.rbegin();
+    if (offset + size == capacity) {
+      free -= size;
+    }
+  }
+  return free;
+}
+
+ArenaBuffer::~ArenaBuffer() {
+  if (buffer) {
+    glDeleteBuffers(1, &buffer);
+  }
+}
+
+void ArenaBuffer::reallocate(size_t newCapacity) {
+  unsigned newBuffer;
+  glGenBuffers(1, &newBuffer);
+  // The copy targets don't disturb the VAO's element array binding.
+  glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * unitSize, nullptr,
+               GL_STATIC_DRAW);
+  // In order of offset, so geometry which was created together stays
+  // together.
+  std::vector<Id> liveIds;
+  for (Id id = 0; id < allocations.size(); id++) {
+    if (allocations[id].live && allocations[id].size) {
+      liveIds.push_back(id);
+    }
+  }
+  std::sort(liveIds.begin(), liveIds.end(), [&](Id a, Id b) {
+    return allocations[a].offset < allocations[b].offset;
+  });
+  size_t next = 0;
+  if (buffer) {
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    for (Id id : liveIds) {
+      Allocation &allocation = allocations[id];
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                          allocation.offset * unitSize, next * unitSize,
+                          allocation.size * unitSize);
+      allocation.offset = next;
+      next += allocation.size;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    // The driver keeps it around until the copies are done.
+    glDeleteBuffers(1, &buffer);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  buffer = newBuffer;
+  allocator.reset(newCapacity, next);
+  generation++;
+}
+
+ArenaBuffer::Id ArenaBuffer::allocate(size_t size) {
+  std::optional<size_t> offset = allocator.allocate(size);
+  if (!offset) {
+    size_t capacity =
+        std::max(minimumCapacity, allocator.getCapacity() * 2);
+    while (capacity < allocator.getUsed() + size) {
+      capacity *= 2;
+    }
+    // Everything is moved to the start, so the free space is all in one
+    // range at the end.
+    reallocate(capacity);
+    offset = allocator.allocate(size);
+    assert(offset);
+  }
+  Allocation allocation{*offset, size, true};
+  if (!freeIds.empty()) {
+    Id id = freeIds.back();
+    freeIds.pop_back();
+    allocations[id] = allocation;
+    return id;
+  }
+  allocations.push_back(allocation);
+  return allocations.size() - 1;
+}
+
+void ArenaBuffer::free(Id id) {
+  Allocation &allocation = allocations[id];
+  assert(allocation.live);
+  allocator.free(allocation.offset, allocation.size);
+  allocation.live = false;
+  freeIds.push_back(id);
+}
+
+void ArenaBuffer::write(Id id, const void *data, size_t bytes) {
+  const Allocation &allocation = allocations[id];
+  assert(bytes <= allocation.size * unitSize);
+  if (bytes == 0) {
+    return;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset * unitSize, bytes,
+                  data);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void ArenaBuffer::read(Id id, void *data, size_t bytes) const {
+  const Allocation &allocation = allocations[id];
+  assert(bytes <= allocation.size * unitSize);
+  if (bytes == 0) {
+    return;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+  glGetBufferSubData(GL_COPY_READ_BUFFER, allocation.offset * unitSize, bytes,
+                     data);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+bool ArenaBuffer::compact() {
+  size_t fragmented = allocator.getFragmentedSpace();
+  if (fragmented * unitSize < MINIMUM_COMPACTION_BYTES ||
+      fragmented < allocator.getCapacity() / 4) {
+    return false;
+  }
+  // This shrinks the buffer too, leaving some room to grow into.
+  size_t used = allocator.getUsed();
+  reallocate(std::max(minimumCapacity,
+                      std::min(allocator.getCapacity(), used + used / 2)));
+  return true;
+}
+
+GeometryArena::GeometryArena()
+    : vertices(VERTEX_SIZE, MINIMUM_VERTEX_CAPACITY),
+      indices(sizeof(uint32_t), MINIMUM_INDEX_WORDS) {}
+
+GeometryArena::~GeometryArena() {
+  if (vao) {
+    glDeleteVertexArrays(1, &vao);
+  }
+}
+
+GeometryArena::Allocation GeometryArena::allocate(size_t vertexCount,
+                                                  size_t indexBytes) {
+  size_t indexWords = (indexBytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  return {vertices.allocate(vertexCount), indices.allocate(indexWords)};
+}
+
+void GeometryArena::free(const Allocation &allocation) {
+  vertices.free(allocation.vertices);
+  indices.free(allocation.indices);
+}
+
+void GeometryArena::write(const Allocation &allocation,
+                          const void *vertexData, size_t vertexBytes,
+                          const void *indexData, size_t indexBytes) {
+  vertices.write(allocation.vertices, vertexData, vertexBytes);
+  indices.write(allocation.indices, indexData, indexBytes);
+}
+
+void GeometryArena::readVertices(const Allocation &allocation, void *data,
+                                 size_t bytes) const {
+  vertices.read(allocation.vertices, data, bytes);
+}
+
+void GeometryArena::readIndices(const Allocation &allocation, void *data,
+                                size_t bytes) const {
+  indices.read(allocation.indices, data, bytes);
+}
+
+size_t GeometryArena::getFirstIndex(const Allocation &allocation,
+                                    GLenum indexType) const {
+  size_t indexSize =
+      indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+  return indices.getOffset(allocation.indices) * sizeof(uint32_t) / indexSize;
+}
+
+void GeometryArena::bind() {
+  if (!vao) {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    enableInstanceAttributes();
+  } else {
+    glBindVertexArray(vao);
+  }
+  if (vertexGeneration != vertices.getGeneration()) {
+    glBindBuffer(GL_ARRAY_BUFFER, vertices.getBuffer());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_SIZE, nullptr);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_SIZE,
+                          (void *)(3 * sizeof(float)));
+    vertexGeneration = vertices.getGeneration();
+  }
+  if (indexGeneration != indices.getGeneration()) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.getBuffer());
+    indexGeneration = indices.getGeneration();
+  }
+}
+
+void GeometryArena::defragment() {
+  compactions += vertices.compact();
+  compactions += indices.compact();
+}
+
+GeometryBufferStats GeometryArena::getStats() const {
+  GeometryBufferStats stats{};
+  stats.bufferBytes = vertices.getCapacityBytes() + indices.getCapacityBytes();
+  stats.usedBytes = vertices.getUsedBytes() + indices.getUsedBytes();
+  stats.compactions = compactions;
+  return stats;
+}
+
+DrawCommandBuffer::~DrawCommandBuffer() {
+  if (buffer) {
+    glDeleteBuffers(1, &buffer);
+  }
+}
+
+void DrawCommandBuffer::clear() {
+  commands.clear();
+  groups.clear();
+}
+
+void DrawCommandBuffer::add(const DrawState &state,
+                            const DrawCommand &command) {
+  if (groups.empty() || !(groups.back().state == state)) {
+    groups.push_back({state, commands.size(), 0});
+  }
+  groups.back().commandCount++;
+  commands.push_back(command);
+}
+
+void DrawCommandBuffer::upload() {
+  if (!buffer) {
+    glGenBuffers(1, &buffer);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+  size_t bytes = commands.size() * sizeof(DrawCommand);
+  if (bytes > capacity) {
+    capacity = std::max(bytes, capacity * 2);
+  }
+  // Orphaning the old storage means we don't wait for the GPU to finish
+  // reading the last frame's commands.
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, commands.data());
+}
+} // namespace seagull
@@ -0,0 +1,90 @@
+#ifndef SEAGULL_ASSET_LOADER_H
+#define SEAGULL_ASSET_LOADER_H
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <jobSystem.h>
+#include <memory>
+#include <optional>
+#include <seagull/gameObject.h>
+#include <seagull/loading.h>
+#include <vector>
+
+namespace seagull {
+struct GameContext;
+struct GpuTexture;
+struct PreparedGeometry;
+
+struct PendingLoad {
+  enum class Stage {
+    PREPARING, // The mesh is being loaded and indexed on a worker
+    PREPARED,  // Waiting for the main thread to start uploading the texture
+    UPLOADING, // Waiting for the texture to finish streaming in
+    READY,
+    FAILED,
+  };
+  // Written by the worker when it finishes, so that the main thread can tell
+  // without waiting.
+  std::atomic<Stage> stage = Stage::PREPARING;
+
+  // Loads and indexes the mesh (on a worker).
+  std::function<PreparedGeometry()> prepare;
+  bool addToScene;
+  std::function<void(GameObject &)> onLoaded;
+
+  // Filled in by the worker.
+  std::unique_ptr<PreparedGeometry> prepared;
+  bool transparent = false;
+  std::exception_ptr error;
+
+  JobHandle job;
+  std::shared_ptr<GpuTexture> gpuTexture;
+  GameObject gameObject; // Once it is ready
+
+  ~PendingLoad();
+};
+
+/**
+ * @brief loads game objects in the background
+ *
+ * @note loading happens in three steps. First a worker loads the mesh (which
+ * usually means decoding images), indexes it and works out its bounds. Then
+ * the main thread streams the texture to the GPU through a pixel buffer, a
+ * few megabytes per frame so that the frame rate doesn't suffer. Finally the
+ * vertex buffers are created and the game object is added.
+ */
+class AssetLoader {
+private:
+  JobSystem &jobs;
+  std::vector<std::shared_ptr<PendingLoad>> loads;
+  // Textures which are being streamed in, oldest first.
+  std::vector<std::shared_ptr<GpuTexture>> streamingTextures;
+  unsigned pixelBuffer = 0;
+
+public:
+  // How many bytes of texture data to upload each frame.
+  static constexpr size_t UPLOAD_BUDGET = 4 << 20;
+
+  AssetLoader(JobSystem &jobs) : jobs(jobs) {}
+  ~AssetLoader(); // Waits for the workers to finish with every load
+
+  AssetLoader(const AssetLoader &) = delete;
+  AssetLoader &operator=(const AssetLoader &) = delete;
+
+  PendingGameObject load(std::function<PreparedGeometry()> prepare,
+                         bool addToScene,
+                         std::function<void(GameObject &)> onLoaded);
+
+  /**
+   * @brief move every load along as far as it can go this frame
+   *
+   * @note this must be called on the main thread, between frames.
+   */
+  void update(GameContext &gameContext);
+
+  size_t getPendingCount() const { return loads.size(); }
+};
+} // namespace seagull
+
+#endif
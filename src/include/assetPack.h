@@ -0,0 +1,50 @@
+#ifndef SEAGULL_ASSET_PACK_H
+#define SEAGULL_ASSET_PACK_H
+
+#include <mappedFile.h>
+#include <seagull/assetPackFormat.h>
+#include <string>
+#include <string_view>
+
+namespace seagull {
+/**
+ * @brief an asset pack which has been mapped into memory
+ *
+ * @note the whole pack is checked when it is opened, so the pointers handed
+ * out by this class are always within the file.
+ */
+class AssetPack {
+private:
+  MappedFile file;
+  const AssetPackHeader *header;
+  const PackedTexture *textures;
+  const PackedMesh *meshes;
+
+public:
+  /**
+   * @throws std::runtime_error if the file can't be mapped or isn't a valid
+   * asset pack
+   */
+  AssetPack(const std::string &fileName);
+
+  size_t getTextureCount() const { return header->textureCount; }
+  size_t getMeshCount() const { return header->meshCount; }
+  const PackedTexture &getTexture(size_t index) const {
+    return textures[index];
+  }
+  const PackedMesh &getMesh(size_t index) const { return meshes[index]; }
+
+  // These return null if there is no entry with the name.
+  const PackedTexture *findTexture(std::string_view name) const;
+  const PackedMesh *findMesh(std::string_view name) const;
+
+  /**
+   * @brief get a pointer into the file
+   */
+  const unsigned char *at(uint64_t offset) const {
+    return file.getData() + offset;
+  }
+};
+} // namespace seagull
+
+#endif
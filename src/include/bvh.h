@@ -0,0 +1,152 @@
+#ifndef SEAGULL_BVH_H
+#define SEAGULL_BVH_H
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief a bounding volume hierarchy over a set of boxes, for casting rays
+ * against whatever is in them
+ *
+ * @note it is built top down, splitting each node's items in half at the
+ * median of their centres along the longest axis. The nodes are stored depth
+ * first, so a node's left child is always straight after it.
+ */
+class Bvh {
+public:
+  static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+  struct Node {
+    Eigen::Vector3f min;
+    uint32_t offset; // The first item of a leaf, or the right child
+    Eigen::Vector3f max;
+    uint32_t count; // The number of items in a leaf, or 0
+  };
+
+private:
+  std::vector<Node> nodes;
+  std::vector<uint32_t> items; // Each leaf's items are together
+
+  void buildNode(const std::vector<Eigen::AlignedBox3f> &boxes,
+                 std::vector<Eigen::Vector3f> &centres, uint32_t begin,
+                 uint32_t end);
+
+  // The distance along the ray at which it enters the node's box, or a
+  // negative number if it misses (or enters past maxDistance).
+  static float enterNode(const Node &node, const Eigen::Vector3f &origin,
+                         const Eigen::Vector3f &inverseDirection,
+                         float maxDistance) {
+    Eigen::Vector3f t0 = (node.min - origin).cwiseProduct(inverseDirection);
+    Eigen::Vector3f t1 = (node.max - origin).cwiseProduct(inverseDirection);
+    float enter = std::max(t0.cwiseMin(t1).maxCoeff(), 0.0f);
+    float exit = std::min(t0.cwiseMax(t1).minCoeff(), maxDistance);
+    return enter <= exit ? enter : -1;
+  }
+
+public:
+  /**
+   * @brief build the hierarchy over some boxes
+   *
+   * @note the items are the indices of the boxes.
+   */
+  void build(const std::vector<Eigen::AlignedBox3f> &boxes);
+
+  bool empty() const { return nodes.empty(); }
+
+  /**
+   * @brief call testItem(item, maxDistance) for every item whose box the ray
+   * passes through before maxDistance, nearest boxes first
+   *
+   * @note testItem should shrink maxDistance whenever it hits something, so
+   * that boxes which are further away are skipped.
+   */
+  template <typename TestItem>
+  void raycast(const Eigen::Vector3f &origin,
+               const Eigen::Vector3f &direction, float &maxDistance,
+               TestItem &&testItem) const {
+    if (nodes.empty()) {
+      return;
+    }
+    // Division by zero gives infinity, which is what the slab test wants.
+    Eigen::Vector3f inverseDirection = direction.cwiseInverse();
+    if (enterNode(nodes[0], origin, inverseDirection, maxDistance) < 0) {
+      return;
+    }
+    // Each entry is a node and the distance at which the ray enters it. The
+    // tree is balanced, so this is far deeper than it will ever get.
+    std::pair<uint32_t, float> stack[64];
+    size_t stackSize = 0;
+    stack[stackSize++] = {0, 0.0f};
+    while (stackSize > 0) {
+      auto [index, enter] = stack[--stackSize];
+      if (enter > maxDistance) {
+        continue; // Something nearer was hit since this was pushed.
+      }
+      const Node &node = nodes[index];
+      if (node.count > 0) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+          testItem(items[i], maxDistance);
+        }
+        continue;
+      }
+      uint32_t left = index + 1, right = node.offset;
+      float enterLeft =
+          enterNode(nodes[left], origin, inverseDirection, maxDistance);
+      float enterRight =
+          enterNode(nodes[right], origin, inverseDirection, maxDistance);
+      // The nearer child goes on top, so it is visited first.
+      if (enterLeft >= 0 && enterRight >= 0 && enterLeft < enterRight) {
+        stack[stackSize++] = {right, enterRight};
+        stack[stackSize++] = {left, enterLeft};
+      } else {
+        if (enterLeft >= 0) {
+          stack[stackSize++] = {left, enterLeft};
+        }
+        if (enterRight >= 0) {
+          stack[stackSize++] = {right, enterRight};
+        }
+      }
+    }
+  }
+};
+
+/**
+ * @brief the triangles of a mesh, ready to have rays cast against them
+ *
+ * @note this keeps its own copy of the corners, so it works even when the mesh
+ * itself is only on the GPU.
+ */
+class MeshBvh {
+private:
+  Bvh bvh;
+  std::vector<Eigen::Vector3f> corners; // 3 per triangle
+
+public:
+  MeshBvh() = default;
+  /**
+   * @param positions the x, y and z of each vertex
+   * @param positionStride the number of floats from one vertex's position to
+   * the next
+   * @param indices 3 per triangle
+   */
+  MeshBvh(const float *positions, size_t positionStride,
+          const uint32_t *indices, size_t indexCount);
+
+  bool empty() const { return bvh.empty(); }
+
+  /**
+   * @brief find the nearest triangle (from either side) along a ray
+   *
+   * @return whether anything was hit before maxDistance, in which case
+   * maxDistance is moved in to the hit and triangle is set to its index
+   */
+  bool raycast(const Eigen::Vector3f &origin,
+               const Eigen::Vector3f &direction, float &maxDistance,
+               uint32_t &triangle) const;
+};
+} // namespace seagull
+
+#endif
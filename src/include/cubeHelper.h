@@ -0,0 +1,33 @@
+#ifndef SEAGULL_CUBE_HELPER_H
+#define SEAGULL_CUBE_HELPER_H
+
+#include <seagull/cube.h>
+#include <seagull/indexedMesh.h>
+
+namespace seagull {
+/**
+ * @brief add one face of a box of blocks to a mesh
+ *
+ * @note the box starts at block coordinate `base` and covers uExtent blocks
+ * along the face's u axis and vExtent blocks along its v axis. The texture
+ * region is repeated once per block, which is only correct along axes that the
+ * region spans completely (the texture wraps around there).
+ *
+ * @param origin the position of block coordinate (0, 0, 0)
+ * @param blockSize the width of a block
+ */
+void addCubeFaceQuad(Mesh &mesh, Texture &texture, CubeFace face,
+                     const unsigned base[3], unsigned uExtent, unsigned vExtent,
+                     const TextureRegion &region, Point3d origin,
+                     float blockSize);
+/**
+ * @brief add one face of a box of blocks to an indexed mesh (as four vertices
+ * and two triangles)
+ */
+void addCubeFaceQuad(IndexedMesh &mesh, CubeFace face, const unsigned base[3],
+                     unsigned uExtent, unsigned vExtent,
+                     const TextureRegion &region, Point3d origin,
+                     float blockSize);
+} // namespace seagull
+
+#endif
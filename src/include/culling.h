@@ -0,0 +1,74 @@
+#ifndef SEAGULL_CULLING_H
+#define SEAGULL_CULLING_H
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <jobSystem.h>
+#include <seagull/indexedMesh.h>
+#include <seagull/mesh.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief the bounding volumes of a mesh, in the mesh's own coordinates
+ */
+struct Bounds {
+  Eigen::Vector3f min = Eigen::Vector3f::Zero();
+  Eigen::Vector3f max = Eigen::Vector3f::Zero();
+  // The sphere is centred on the middle of the box, and encloses every vertex.
+  Eigen::Vector3f sphereCenter = Eigen::Vector3f::Zero();
+  float sphereRadius = 0;
+
+  static Bounds fromMesh(const Mesh &mesh);
+  static Bounds fromMesh(const IndexedMesh &mesh);
+};
+
+/**
+ * @brief the six planes of a view frustum
+ *
+ * @note each plane is stored as (a, b, c, d), where a point p is on the inside
+ * of the plane if a*p.x + b*p.y + c*p.z + d >= 0. The normals are normalised,
+ * so that is also the distance from the plane.
+ */
+struct Frustum {
+  Eigen::Vector4f planes[6];
+
+  /**
+   * @brief extract the planes from a (projection * view) matrix
+   */
+  static Frustum fromMatrix(const Eigen::Matrix4f &viewProjection);
+};
+
+/**
+ * @brief tests a batch of bounding spheres against a frustum
+ *
+ * @note the spheres are kept in packed arrays (one per component) so that four
+ * of them can be tested against each plane at once.
+ */
+class FrustumCuller {
+private:
+  std::vector<float> centerX, centerY, centerZ, radius;
+  std::vector<uint8_t> visible;
+
+  size_t cullRange(const Frustum &frustum, size_t begin, size_t end);
+
+public:
+  void clear();
+  /**
+   * @brief add a sphere which has already been transformed into world space
+   */
+  void add(const Eigen::Vector3f &center, float sphereRadius);
+  /**
+   * @brief test every sphere which has been added against the frustum
+   *
+   * @param jobs if given, large batches are split across its workers
+   * @return the number of visible spheres
+   */
+  size_t cull(const Frustum &frustum, JobSystem *jobs = nullptr);
+
+  bool isVisible(size_t index) const { return visible[index]; }
+  size_t size() const { return radius.size(); }
+};
+} // namespace seagull
+
+#endif
@@ -2,56 +2,230 @@
 #define SEAGULL_GAME_OBJECT_INTERNAL_H
 
 #include <Eigen/Dense>
+#include <assetPack.h>
+#include <bvh.h>
+#include <cstdint>
+#include <culling.h>
+#include <meshSimplifier.h>
 #include <optional>
 #include <seagull/gameObject.h>
 #include <seagull_internal.h>
+#include <transformStore.h>
+#include <vertexCache.h>
+#include <vertexIndexer.h>
 
 namespace seagull {
+// A texture on the GPU. Every object whose texture uses the same image shares
+// one of these, so they can be drawn without rebinding the texture.
+struct GpuTexture {
+  unsigned id;
+  bool transparent; // Whether any of the image is see-through
+  // What the texture was made from. The cache is keyed by the image's address,
+  // and the image may have been freed (see GameContext::retainMeshData) and
+  // another one allocated in its place, so this is checked too. This is empty
+  // for textures from asset packs.
+  std::weak_ptr<const Image> image;
+
+  // While the image is being uploaded (possibly over several frames), this
+  // holds it and the number of rows which have been uploaded so far.
+  std::shared_ptr<const Image> streamingImage;
+  size_t streamedRows = 0;
+
+  bool isResident() const { return !streamingImage; }
+
+  ~GpuTexture();
+};
+
+/**
+ * @brief get the GPU texture for an image, uploading the image if it isn't
+ * there already
+ *
+ * @note this always returns a resident texture, finishing off the upload if
+ * the image was being streamed in.
+ */
+std::shared_ptr<GpuTexture>
+getGpuTexture(GameContext &gameContext,
+              const std::shared_ptr<const Image> &image);
+
+/**
+ * @brief get the GPU texture for an image, without uploading any of it yet
+ *
+ * @note unless the image was already on the GPU, the texture isn't resident
+ * until streamGpuTexture has been called enough times.
+ *
+ * @param transparent whether the image has any transparency (which is worth
+ * working out on another thread)
+ */
+std::shared_ptr<GpuTexture>
+startStreamingGpuTexture(GameContext &gameContext,
+                         const std::shared_ptr<const Image> &image,
+                         bool transparent);
+
+/**
+ * @brief upload some more rows of a texture which is being streamed in
+ *
+ * @note the mipmaps are generated once the last row is uploaded.
+ *
+ * @param byteBudget roughly how many bytes to upload (at least one row is
+ * always uploaded)
+ * @param pixelBuffer a buffer to stage the pixels in, or 0 to upload straight
+ * from the image
+ * @return the number of bytes uploaded
+ */
+size_t streamGpuTexture(GpuTexture &gpuTexture, size_t byteBudget,
+                        unsigned pixelBuffer);
+
 // We put this in a separate struct so it can be shared by multiple instances of
 // a template game object.
 struct GameObjectGeometry { // Also includes textures, but I can't think of a
                             // better term.
-  // If you don't know what a VAO or VBO is, you should read up on them before
-  // reading the following code.
-  unsigned vao;
-  unsigned vertexVbo;
-  unsigned indexVbo;
-  unsigned textureVbo;
-  unsigned textureId;
+  // Where its vertices and indices are in the arena, which gets the space
+  // back when this is destroyed.
+  GeometryArena *arena = nullptr;
+  GeometryArena::Allocation allocation;
+  std::shared_ptr<GpuTexture> gpuTexture;
+  size_t indexCount = 0; // Of the full mesh
+  // GL_UNSIGNED_SHORT if every index fits in 16 bits, otherwise
+  // GL_UNSIGNED_INT.
+  GLenum indexType = GL_UNSIGNED_INT;
+
+  // The levels of detail, from the full mesh (level 0) down. They all use the
+  // same vertices, and their indices are one after the other in the
+  // allocation (firstIndex counts from its start).
+  struct LodLevel {
+    size_t firstIndex;
+    size_t indexCount;
+    // Roughly how far the level strays from the full mesh, in the mesh's own
+    // units.
+    float error;
+  };
+  std::vector<LodLevel> lods;
+
+  // A small number identifying this geometry, used in render queue sort keys.
+  // These wrap around eventually, which only costs us a bit of batching.
+  uint16_t id;
+  // Whether any of the texture is see-through (this is copied from the GPU
+  // texture). Transparent geometry has to be drawn after everything else, from
+  // back to front.
+  bool transparent;
 
-  Mesh mesh;
-  Texture texture;
+  // Used to skip drawing objects which are off screen.
+  Bounds bounds;
+  // The triangles of the full mesh, for raycasting (null if they weren't
+  // wanted: see GeometryOptions). Raycasts hold on to this while they use it.
+  std::shared_ptr<const MeshBvh> bvh;
+
+  // The vertices which were uploaded. This is empty if they weren't kept (see
+  // GameContext::retainMeshData), and for geometry from an asset pack, since
+  // that went straight to the GPU. readBackGeometry works either way.
+  std::optional<IndexedMesh> mesh;
 
   ~GameObjectGeometry();
+};
 
-  // We need this constructor because texture doesn't have a default one. This
-  // is a bit annoying.
-  GameObjectGeometry(Mesh mesh, Texture texture)
-      : mesh(std::move(mesh)), texture(std::move(texture)) {}
+// Everything about a piece of geometry which can be worked out without OpenGL,
+// and so on any thread.
+struct PreparedGeometry {
+  IndexedMesh mesh;
+  Bounds bounds;
+  // The simplified levels of detail after the full mesh (if any).
+  std::vector<SimplifiedIndices> lods;
+  // How well the full mesh uses the vertex cache, before and after its
+  // triangles were reordered.
+  VertexCacheStats vertexCacheStats{};
+  std::shared_ptr<const MeshBvh> bvh; // Of the reordered full mesh
 };
 
+/**
+ * @brief index a mesh (welding its repeated vertices together)
+ */
+PreparedGeometry prepareGeometry(TexturedMesh mesh,
+                                 const GeometryOptions &options,
+                                 JobSystem *jobs = nullptr);
+/**
+ * @brief check a mesh which is already indexed
+ *
+ * @note this throws std::invalid_argument if any of its indices are out of
+ * range. The triangles of the mesh (and of each level of detail) are
+ * reordered for the vertex cache, and optionally to reduce overdraw.
+ */
+PreparedGeometry prepareGeometry(IndexedMesh mesh,
+                                 const GeometryOptions &options);
+
+/**
+ * @brief upload prepared geometry into the arena
+ *
+ * @param retainMesh whether to keep the vertices (and the image) in memory
+ * after uploading them
+ */
+std::shared_ptr<GameObjectGeometry>
+createGeometry(GeometryArena &arena, PreparedGeometry prepared,
+               std::shared_ptr<GpuTexture> gpuTexture, bool retainMesh);
+
+/**
+ * @brief get the vertices which were uploaded for some geometry
+ *
+ * @note if they weren't kept, they are read back from the GPU, along with the
+ * texture's image (as RGBA8). That stalls until the GPU has caught up.
+ */
+IndexedMesh readBackGeometry(const GameObjectGeometry &geometry);
+
+/**
+ * @brief upload a mesh from an asset pack into the arena
+ *
+ * @note the vertices and indices are uploaded straight from the pack's
+ * mapping.
+ *
+ * @param buildRaycastBvh whether to build a BVH of the triangles (from the
+ * mapping too)
+ */
+std::shared_ptr<GameObjectGeometry>
+createPackedGeometry(GeometryArena &arena, const AssetPack &pack,
+                     const PackedMesh &mesh,
+                     std::shared_ptr<GpuTexture> gpuTexture,
+                     bool buildRaycastBvh);
+
+/**
+ * @brief get the GPU texture for a texture in an asset pack, uploading it
+ * (with its mip levels) if it isn't there already
+ */
+std::shared_ptr<GpuTexture> getPackedGpuTexture(GameContext &gameContext,
+                                                const AssetPack &pack,
+                                                const PackedTexture &texture);
+
+/**
+ * @brief get the geometry for a mesh in an asset pack, uploading it (and its
+ * texture) if it isn't there already
+ *
+ * @note every game object made from the same packed mesh shares the one piece
+ * of geometry, so they can be drawn together.
+ */
+std::shared_ptr<GameObjectGeometry>
+getPackedGeometry(GameContext &gameContext, const AssetPack &pack,
+                  const PackedMesh &mesh);
+
+/**
+ * @brief create a game object from geometry which is already on the GPU
+ *
+ * @param addToScene whether to add it to the scene (or to the templates)
+ */
+GameObject addGameObject(GameContext &gameContext,
+                         std::shared_ptr<GameObjectGeometry> geometry,
+                         bool addToScene);
+
 struct GameObjectState {
   std::shared_ptr<GameObjectGeometry> geometry;
-  // Caching these values has no downside, so we do that.
-  Eigen::Matrix4f totalTransformationMatrix = Eigen::Matrix4f::Identity();
-  Eigen::Matrix4f scaleMatrix = Eigen::Matrix4f::Identity();
-  Eigen::Matrix4f rotationMatrix = Eigen::Matrix4f::Identity();
-  Eigen::Matrix4f translationMatrix = Eigen::Matrix4f::Identity();
-
-  // The following are able to improve performance for continuous
-  // transformations (e.g. something moving forwards at some speed), however it
-  // would be counterproductive to recalculate them every time a transformation
-  // occurs (there would be more math involved in doing this than in just
-  // calculating the total transformation matrix every time). The solution is to
-  // use optional cached matrices and invalidate them when a transformation
-  // occurs.
-  std::optional<Eigen::Matrix4f> rotateScaleMatrix;
-  std::optional<Eigen::Matrix4f> translateRotateMatrix;
-  std::optional<Eigen::Matrix4f> translateScaleMatrix;
-
-  float scale = 1;
-  Eigen::Vector3f rotation = Eigen::Vector3f::Zero();
-  Eigen::Vector3f translation = Eigen::Vector3f::Zero();
+  // The transform itself lives in the game context's transform store, so that
+  // all of them can be updated in one go.
+  TransformStore *transforms;
+  uint32_t transformSlot;
+  // The level of detail it was last drawn at. This is kept so that the level
+  // only changes once the object is well past the point where it should.
+  uint8_t lodLevel = 0;
+
+  const Eigen::Matrix4f &getWorldMatrix() const {
+    return transforms->getWorldMatrix(transformSlot);
+  }
 };
 } // namespace seagull
 
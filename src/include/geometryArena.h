@@ -0,0 +1,251 @@
+#ifndef SEAGULL_GEOMETRY_ARENA_H
+#define SEAGULL_GEOMETRY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <gl/glew.h>
+#include <map>
+#include <optional>
+#include <seagull/stats.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief hands out ranges of a space of a fixed size
+ *
+ * @note the free ranges are kept in order, so a freed range merges with any
+ * free ones on either side of it. Ranges are handed out first fit, which keeps
+ * the used ones towards the start.
+ */
+class RangeAllocator {
+private:
+  std::map<size_t, size_t> freeRanges; // Sizes by offset
+  size_t capacity = 0;
+  size_t used = 0;
+
+public:
+  /**
+   * @return the offset of the range, or nothing if there isn't a free range
+   * big enough
+   */
+  std::optional<size_t> allocate(size_t size);
+  void free(size_t offset, size_t size);
+  /**
+   * @brief start again with a new capacity, with just the first usedSize
+   * taken (which is where compacting puts everything)
+   */
+  void reset(size_t newCapacity, size_t usedSize);
+
+  size_t getCapacity() const { return capacity; }
+  size_t getUsed() const { return used; }
+  /**
+   * @brief the free space in holes between used ranges (rather than at the
+   * end)
+   */
+  size_t getFragmentedSpace() const;
+};
+
+/**
+ * @brief a GPU buffer which many allocations share, measured in units of a
+ * fixed size
+ *
+ * @note allocations are referred to by id, since compacting the buffer moves
+ * them. The buffer grows (and is compacted as it is copied) when there isn't a
+ * big enough range left, so allocating never fails.
+ */
+class ArenaBuffer {
+public:
+  using Id = uint32_t;
+
+private:
+  struct Allocation {
+    size_t offset;
+    size_t size;
+    bool live;
+  };
+
+  size_t unitSize;
+  size_t minimumCapacity; // In units
+  unsigned buffer = 0;
+  RangeAllocator allocator;
+  std::vector<Allocation> allocations; // By id
+  std::vector<Id> freeIds;
+  // Changes whenever the buffer is replaced.
+  uint64_t generation = 0;
+
+  // Move every allocation into a new buffer, one after the other.
+  void reallocate(size_t newCapacity);
+
+public:
+  ArenaBuffer(size_t unitSize, size_t minimumCapacity)
+      : unitSize(unitSize), minimumCapacity(minimumCapacity) {}
+  ~ArenaBuffer();
+
+  ArenaBuffer(const ArenaBuffer &) = delete;
+  ArenaBuffer &operator=(const ArenaBuffer &) = delete;
+
+  Id allocate(size_t size);
+  void free(Id id);
+  // Both of these start from the beginning of the allocation.
+  void write(Id id, const void *data, size_t bytes);
+  void read(Id id, void *data, size_t bytes) const;
+  /**
+   * @brief compact the buffer if enough of it is lost in holes
+   *
+   * @return whether it was compacted (which replaces the buffer)
+   */
+  bool compact();
+
+  size_t getOffset(Id id) const { return allocations[id].offset; }
+  size_t getSize(Id id) const { return allocations[id].size; }
+  unsigned getBuffer() const { return buffer; }
+  uint64_t getGeneration() const { return generation; }
+  size_t getCapacityBytes() const {
+    return allocator.getCapacity() * unitSize;
+  }
+  size_t getUsedBytes() const { return allocator.getUsed() * unitSize; }
+};
+
+/**
+ * @brief the vertices and indices of every piece of geometry, sub-allocated
+ * from two big buffers behind one VAO
+ *
+ * @note drawing a different piece of geometry then only changes the offsets
+ * in the draw call rather than the VAO, so a whole run of them can be drawn
+ * with one multi-draw call. Vertices are positions interleaved with texture
+ * coordinates (the same layout as in asset packs). Indices are relative to
+ * their geometry's first vertex, which the draw call's base vertex adds on, so
+ * 16-bit ones are still enough for most meshes. Both sizes share the index
+ * buffer, which is allocated in 4-byte words to keep either kind aligned.
+ */
+class GeometryArena {
+public:
+  static constexpr size_t FLOATS_PER_VERTEX = 5;
+  static constexpr size_t VERTEX_SIZE = FLOATS_PER_VERTEX * sizeof(float);
+
+  struct Allocation {
+    ArenaBuffer::Id vertices;
+    ArenaBuffer::Id indices;
+  };
+
+private:
+  ArenaBuffer vertices;
+  ArenaBuffer indices;
+  unsigned vao = 0;
+  // The generations of the buffers which the VAO points at.
+  uint64_t vertexGeneration = 0, indexGeneration = 0;
+  uint64_t compactions = 0;
+
+public:
+  GeometryArena();
+  ~GeometryArena();
+
+  GeometryArena(const GeometryArena &) = delete;
+  GeometryArena &operator=(const GeometryArena &) = delete;
+
+  /**
+   * @note the space isn't cleared: fill it in with write.
+   */
+  Allocation allocate(size_t vertexCount, size_t indexBytes);
+  void free(const Allocation &allocation);
+  void write(const Allocation &allocation, const void *vertexData,
+             size_t vertexBytes, const void *indexData, size_t indexBytes);
+  void readVertices(const Allocation &allocation, void *data,
+                    size_t bytes) const;
+  void readIndices(const Allocation &allocation, void *data,
+                   size_t bytes) const;
+
+  size_t getVertexCount(const Allocation &allocation) const {
+    return vertices.getSize(allocation.vertices);
+  }
+  GLint getBaseVertex(const Allocation &allocation) const {
+    return vertices.getOffset(allocation.vertices);
+  }
+  /**
+   * @brief where the allocation's indices start in the index buffer, counted
+   * in indices of the given type
+   */
+  size_t getFirstIndex(const Allocation &allocation, GLenum indexType) const;
+
+  /**
+   * @brief bind the VAO, pointing it at the buffers if they have been
+   * replaced since it was last bound
+   *
+   * @note its instance attributes are enabled, but it's up to the renderer to
+   * point them at the instance ring.
+   */
+  void bind();
+  /**
+   * @brief compact the buffers if too much of them is lost in holes left by
+   * freed geometry
+   *
+   * @note this copies everything on the GPU, so it's only worth doing once
+   * the holes add up to a good fraction of the buffers.
+   */
+  void defragment();
+
+  GeometryBufferStats getStats() const;
+};
+
+// The layout glMultiDrawElementsIndirect reads its commands in.
+struct DrawCommand {
+  uint32_t indexCount;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t baseVertex;
+  uint32_t baseInstance;
+};
+
+// The state which has to be set before drawing a group of commands.
+struct DrawState {
+  unsigned texture;
+  GLenum indexType;
+  bool transparent;
+
+  bool operator==(const DrawState &) const = default;
+};
+
+struct DrawGroup {
+  DrawState state;
+  size_t firstCommand;
+  size_t commandCount;
+};
+
+/**
+ * @brief the draw commands for a frame, filled in on the CPU and uploaded in
+ * one go
+ *
+ * @note consecutive commands with the same state are gathered into groups,
+ * each of which can be drawn with one multi-draw call. The buffer is orphaned
+ * each frame, so writing it never waits for the GPU to finish reading the
+ * last frame's commands.
+ */
+class DrawCommandBuffer {
+private:
+  std::vector<DrawCommand> commands;
+  std::vector<DrawGroup> groups;
+  unsigned buffer = 0;
+  size_t capacity = 0; // In bytes
+
+public:
+  DrawCommandBuffer() = default;
+  ~DrawCommandBuffer();
+
+  DrawCommandBuffer(const DrawCommandBuffer &) = delete;
+  DrawCommandBuffer &operator=(const DrawCommandBuffer &) = delete;
+
+  void clear();
+  void add(const DrawState &state, const DrawCommand &command);
+  /**
+   * @brief copy the commands to the GPU
+   *
+   * @note this leaves the buffer bound to GL_DRAW_INDIRECT_BUFFER.
+   */
+  void upload();
+
+  const std::vector<DrawCommand> &getCommands() const { return commands; }
+  const std::vector<DrawGroup> &getGroups() const { return groups; }
+};
+} // namespace seagull
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SEAGULL_INSTANCE_RING_H
+#define SEAGULL_INSTANCE_RING_H
+
+#include <Eigen/Dense>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <gl/glew.h>
+
+namespace seagull {
+// Everything the vertex shader needs to know about one object. The model
+// matrix itself isn't sent, since nothing on the GPU uses it yet. Something
+// which works in world space (such as lighting) would add it here, along with
+// an attribute after the model-view-projection matrix's.
+struct InstanceData {
+  // Worked out once per object here rather than once per vertex on the GPU.
+  Eigen::Matrix4f modelViewProjection;
+};
+
+/**
+ * @brief a buffer the per-object data for each frame is written into
+ *
+ * @note the buffer is split into one region per frame in flight, and each
+ * frame writes into the next region round. A fence is placed after each
+ * frame's draws, and a region is only written to again once its fence has
+ * signalled, so we never overwrite data the GPU is still reading (and never
+ * have to wait for it in the usual case).
+ *
+ * @note where ARB_buffer_storage is available, the buffer is mapped once,
+ * persistently. Otherwise each frame's region is mapped unsynchronized, which
+ * the fences make safe.
+ */
+class InstanceRing {
+public:
+  static constexpr size_t FRAMES_IN_FLIGHT = 3;
+  static constexpr size_t STRIDE = sizeof(InstanceData);
+
+private:
+  unsigned buffer = 0;
+  bool persistent = false;
+  unsigned char *persistentMapping = nullptr;
+  size_t capacity = 0; // Instances per region
+  std::array<GLsync, FRAMES_IN_FLIGHT> fences{};
+  size_t region = 0;
+  InstanceData *frameMapping = nullptr; // Only set between begin and finish
+  // Changes whenever the buffer is replaced, which means every VAO has to point
+  // its instance attributes at the new one.
+  uint64_t generation = 0;
+
+  void waitForFence(size_t regionIndex);
+  void allocate(size_t instanceCapacity);
+
+public:
+  InstanceRing() = default;
+  ~InstanceRing();
+
+  InstanceRing(const InstanceRing &) = delete;
+  InstanceRing &operator=(const InstanceRing &) = delete;
+
+  /**
+   * @brief start writing a frame's instances
+   *
+   * @note the buffer grows if it has to, which waits for the GPU to finish
+   * with it first.
+   *
+   * @return where to write the instances
+   */
+  InstanceData *beginFrame(size_t instanceCount);
+  /**
+   * @brief finish writing the frame's instances (before drawing any of them)
+   */
+  void finishWriting();
+  /**
+   * @brief fence off the frame's region (after drawing everything in it)
+   */
+  void endFrame();
+
+  unsigned getBuffer() const { return buffer; }
+  uint64_t getGeneration() const { return generation; }
+  /**
+   * @brief the index of the current frame's first instance in the buffer
+   */
+  size_t getBaseInstance() const { return region * capacity; }
+};
+} // namespace seagull
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SEAGULL_JOB_SYSTEM_H
+#define SEAGULL_JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace seagull {
+struct Job;
+using JobHandle = std::shared_ptr<Job>;
+
+/**
+ * @brief a pool of worker threads which run jobs
+ *
+ * @note every worker has its own queue. Workers take the most recent job from
+ * their own queue (which is likely to still be in the cache) and, when they
+ * run out, steal the oldest job from somebody else's. Jobs submitted from
+ * outside of the pool go into a separate queue which everyone steals from.
+ *
+ * @note threads waiting for a job help out by running other jobs in the
+ * meantime, so it is fine to wait from inside a job, and everything still works
+ * (on the calling thread) if there are no workers at all.
+ */
+class JobSystem {
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<JobHandle> jobs;
+  };
+
+  std::vector<std::thread> workers;
+  // One per worker, plus one at the end for jobs from other threads.
+  std::vector<std::unique_ptr<Queue>> queues;
+
+  std::mutex sleepMutex;
+  std::condition_variable wakeCondition;
+  std::atomic<size_t> queuedJobCount = 0;
+  bool stopping = false;
+
+  void enqueue(JobHandle job);
+  JobHandle takeJob();
+  void runJob(const JobHandle &job);
+  void workerLoop(size_t workerIndex);
+
+public:
+  /**
+   * @param workerCount the number of threads to start. By default this leaves
+   * one core for the thread which owns the pool.
+   */
+  JobSystem(size_t workerCount = getDefaultWorkerCount());
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  /**
+   * @brief queue a job, which runs once all of its dependencies have finished
+   */
+  JobHandle submit(std::function<void()> work,
+                   const std::vector<JobHandle> &dependencies = {});
+
+  /**
+   * @brief wait for a job to finish (running other jobs in the meantime)
+   *
+   * @note if the job threw an exception, it is rethrown here.
+   */
+  void wait(const JobHandle &job);
+
+  /**
+   * @brief split [0, count) into batches and process them in parallel
+   *
+   * @note this returns once every batch is done. Unlike wait, the calling
+   * thread only helps with this loop's own batches in the meantime, so it is
+   * never held up by an unrelated job. If a batch throws, the batches which
+   * haven't started yet are skipped and the exception is rethrown here.
+   *
+   * @param minimumBatchSize the smallest number of items worth handing to
+   * another thread
+   */
+  void parallelFor(size_t count, size_t minimumBatchSize,
+                   const std::function<void(size_t begin, size_t end)> &body);
+
+  size_t getWorkerCount() const { return workers.size(); }
+
+  static size_t getDefaultWorkerCount() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+  }
+};
+} // namespace seagull
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef SEAGULL_MAPPED_FILE_H
+#define SEAGULL_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace seagull {
+/**
+ * @brief a read-only memory mapping of a whole file
+ *
+ * @note the operating system pages the file in as it is read, so nothing is
+ * copied until something actually looks at the data.
+ */
+class MappedFile {
+private:
+  const unsigned char *data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  void *fileHandle = nullptr;
+  void *mappingHandle = nullptr;
+#endif
+
+public:
+  /**
+   * @throws std::runtime_error if the file can't be opened or mapped
+   */
+  MappedFile(const std::string &fileName);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const unsigned char *getData() const { return data; }
+  size_t getSize() const { return size; }
+};
+} // namespace seagull
+
+#endif
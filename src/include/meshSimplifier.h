@@ -0,0 +1,55 @@
+#ifndef SEAGULL_MESH_SIMPLIFIER_H
+#define SEAGULL_MESH_SIMPLIFIER_H
+
+#include <cstdint>
+#include <seagull/indexedMesh.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief a simpler set of triangles over the same vertices as a mesh
+ */
+struct SimplifiedIndices {
+  std::vector<uint32_t> indices; // 3 indices per triangle
+  // Roughly how far the simplified surface strays from the one it was made
+  // from, in the mesh's own units.
+  float error = 0;
+};
+
+/**
+ * @brief simplify some of a mesh's triangles by collapsing edges, using
+ * quadric error metrics (Garland and Heckbert)
+ *
+ * @note every collapse moves one vertex onto a neighbouring one (a half-edge
+ * collapse), so the result only uses vertices which are already in the mesh,
+ * and can share its vertex buffer. The cheapest collapse is always done first.
+ *
+ * @note vertices on a UV seam (where vertices with different texture
+ * coordinates share a position) never move, so the texture doesn't tear along
+ * the seam. Edges on the boundary of the mesh are weighted heavily so that the
+ * outline is kept, and collapses which would flip a triangle over (or pinch
+ * the surface) are skipped.
+ *
+ * @param indices the triangles to simplify (which may have been simplified
+ * already)
+ * @param targetTriangleCount stop once there are this many triangles left
+ */
+SimplifiedIndices simplifyMesh(const IndexedMesh &mesh,
+                               const std::vector<uint32_t> &indices,
+                               size_t targetTriangleCount);
+
+/**
+ * @brief build a chain of ever simpler levels of detail for a mesh
+ *
+ * @note each level has about half the triangles of the one before. The chain
+ * stops early when a mesh is too small to be worth simplifying, or when it
+ * can't be simplified much further (which is often straight away, for example
+ * for meshes which are all seams).
+ *
+ * @return the levels after the full mesh, each with its error measured from
+ * the full mesh
+ */
+std::vector<SimplifiedIndices> buildLodChain(const IndexedMesh &mesh);
+} // namespace seagull
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef SEAGULL_OFFSCREEN_H
+#define SEAGULL_OFFSCREEN_H
+
+namespace seagull {
+/**
+ * @brief a framebuffer with colour and depth attachments to render into
+ * instead of the window
+ *
+ * @note this is what makes headless rendering possible: the window is never
+ * shown, and everything is drawn into this instead. The framebuffer is bound
+ * for as long as this exists.
+ */
+class OffscreenTarget {
+private:
+  unsigned framebuffer;
+  unsigned colorRenderbuffer;
+  unsigned depthRenderbuffer;
+
+public:
+  OffscreenTarget(int width, int height);
+  ~OffscreenTarget();
+
+  OffscreenTarget(const OffscreenTarget &) = delete;
+  OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+};
+} // namespace seagull
+
+#endif
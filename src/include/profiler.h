@@ -0,0 +1,120 @@
+#ifndef SEAGULL_PROFILER_H
+#define SEAGULL_PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <seagull/stats.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief records how long each phase of each frame takes, on the CPU and the
+ * GPU
+ *
+ * @note CPU time is recorded with scopes, which may be nested. GPU time is
+ * recorded for the whole frame with GL_TIME_ELAPSED queries. These are never
+ * waited for: each frame we only pick up the results which are already
+ * available. The last MAX_RECORDED_FRAMES frames are kept so that they can be
+ * written out as a trace.
+ *
+ * @note this must only be used from the thread which owns the GL context.
+ */
+class Profiler {
+public:
+  static constexpr size_t MAX_RECORDED_FRAMES = 600;
+
+  /**
+   * @brief times its own lifetime
+   *
+   * @note the name must outlive the profiler (a string literal is ideal).
+   */
+  class Scope {
+  private:
+    Profiler &profiler;
+    size_t eventIndex;
+
+  public:
+    Scope(Profiler &profiler, const char *name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct ScopeEvent {
+    const char *name;
+    unsigned depth;
+    int64_t startMicroseconds; // Since the profiler was created
+    int64_t durationMicroseconds;
+  };
+
+  struct RecordedFrame {
+    uint64_t number;
+    int64_t startMicroseconds;
+    int64_t durationMicroseconds = 0;
+    std::vector<ScopeEvent> scopes;
+    double gpuMilliseconds = -1; // Negative until the query result arrives
+  };
+
+  // Enough that the GPU is never still working on the oldest one by the time
+  // we want to reuse it (unless it is several frames behind, in which case we
+  // just skip timing a frame).
+  static constexpr size_t GPU_QUERY_COUNT = 4;
+  struct GpuQuery {
+    unsigned id = 0;
+    bool pending = false;
+    uint64_t frame = 0;
+  };
+
+  Clock::time_point epoch = Clock::now();
+  std::deque<RecordedFrame> frames;
+  unsigned currentDepth = 0;
+  bool inFrame = false;
+  uint64_t nextFrameNumber = 0;
+
+  std::array<GpuQuery, GPU_QUERY_COUNT> gpuQueries;
+  GpuQuery *activeGpuQuery = nullptr;
+  uint64_t latestGpuFrame = 0;
+  double latestGpuMilliseconds = -1;
+
+  int64_t now() const;
+  void collectGpuResults();
+
+public:
+  Profiler() = default;
+  ~Profiler();
+
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  void beginFrame();
+  void endFrame();
+
+  // These bracket the GL commands of the current frame. Timer queries can't
+  // be nested, so there is only one per frame.
+  void beginGpuTimer();
+  void endGpuTimer();
+
+  /**
+   * @brief get the profile of the most recent complete frame
+   */
+  FrameProfile getLatestFrame() const;
+
+  /**
+   * @brief write the recorded frames in Chrome's trace event format
+   *
+   * @note the result can be loaded into chrome://tracing or Perfetto. GPU
+   * frames are shown on their own track, starting when the CPU started the
+   * frame (timer queries only measure durations).
+   */
+  void writeChromeTrace(std::ostream &stream) const;
+};
+} // namespace seagull
+
+#endif
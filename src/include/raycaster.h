@@ -0,0 +1,69 @@
+#ifndef SEAGULL_RAYCASTER_H
+#define SEAGULL_RAYCASTER_H
+
+#include <Eigen/Dense>
+#include <bvh.h>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <seagull/slotHandle.h>
+#include <vector>
+
+namespace seagull {
+struct GameObjectState;
+template <typename T> class SlotMap;
+
+/**
+ * @brief casts rays against every game object in the scene
+ *
+ * @note there are two levels of BVH: one over the world space boxes of the
+ * game objects (rebuilt whenever anything is created, destroyed or moved),
+ * and one over the triangles of each piece of geometry, which never changes.
+ * Rays are moved into each object's own space to test its triangles, so
+ * moving an object doesn't touch its triangles at all.
+ */
+class SceneRaycaster {
+public:
+  struct Hit {
+    SlotHandle handle; // In the scene's game objects
+    uint32_t triangle;
+    float distance;
+  };
+
+private:
+  struct Entry {
+    SlotHandle handle;
+    // Shared with the geometry, so it outlives the object if it has to.
+    std::shared_ptr<const MeshBvh> bvh;
+    Eigen::Matrix4f inverseWorldMatrix;
+  };
+
+  Bvh bvh;
+  std::vector<Entry> entries; // Indexed by the items of the BVH
+  bool built = false;
+  uint64_t sceneChanges = 0, transformChanges = 0;
+
+public:
+  /**
+   * @brief rebuild the BVH over the game objects if any of them have changed
+   * since it was last built
+   *
+   * @note this has to run on the main thread, since it may compose world
+   * matrices. Game objects whose geometry has no BVH are left out.
+   */
+  void update(SlotMap<GameObjectState> &gameObjects, uint64_t sceneChanges,
+              uint64_t transformChanges);
+
+  /**
+   * @brief find the nearest triangle along a ray
+   *
+   * @note direction must be normalised. This only reads, so many rays can be
+   * cast at once (after update).
+   */
+  std::optional<Hit> raycast(const Eigen::Vector3f &origin,
+                             const Eigen::Vector3f &direction,
+                             float maxDistance) const;
+};
+} // namespace seagull
+
+#endif
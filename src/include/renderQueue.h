@@ -0,0 +1,63 @@
+#ifndef SEAGULL_RENDER_QUEUE_H
+#define SEAGULL_RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace seagull {
+struct GameObjectState;
+
+struct RenderItem {
+  uint64_t key;
+  const GameObjectState *object;
+};
+
+/**
+ * @brief the list of things to draw this frame, in the order they should be
+ * drawn
+ *
+ * @note the sort keys are laid out so that sorting them puts all of the opaque
+ * objects first, grouped by texture, then geometry and then level of detail
+ * (to minimise state changes) and drawn front to back within each group (to
+ * reduce overdraw), followed by all of the transparent objects drawn back to
+ * front (so that they blend correctly).
+ */
+class RenderQueue {
+private:
+  std::vector<RenderItem> items;
+  std::vector<RenderItem> scratch; // Used while sorting
+
+public:
+  // The depth is quantized to this many bits.
+  static constexpr unsigned DEPTH_BITS = 24;
+
+  /**
+   * @brief build the sort key for an object
+   *
+   * @param depth the view-space depth of the object, normalised to [0, 1]
+   * (values outside the range are clamped)
+   */
+  static uint64_t makeKey(bool transparent, uint16_t textureId,
+                          uint16_t geometryId, uint8_t lodLevel, float depth);
+
+  void clear() { items.clear(); }
+  void push(uint64_t key, const GameObjectState *object) {
+    items.push_back({key, object});
+  }
+
+  /**
+   * @brief sort the items by key
+   *
+   * @note this is an LSD radix sort, so it is linear in the number of items.
+   * Passes over bytes which are the same for every key are skipped entirely.
+   */
+  void sort();
+
+  auto begin() const { return items.begin(); }
+  auto end() const { return items.end(); }
+  size_t size() const { return items.size(); }
+};
+} // namespace seagull
+
+#endif
@@ -1,12 +1,41 @@
 #ifndef SEAGULL_RENDERER_H
 #define SEAGULL_RENDERER_H
 
+#include <Eigen/Dense>
+#include <instanceRing.h>
 #include <seagull/gameObject.h>
 #include <seagull_internal.h>
 
 namespace seagull {
-void render(const GameObjectState &gameObject, const GameContext &gameContext,
-            bool bindTextures);
-}
+// The per-instance matrix occupies this location and the three after it (see
+// the instanced vertex shader).
+static constexpr unsigned INSTANCE_MVP_ATTRIBUTE = 2;
 
-#endif
\ No newline at end of file
+/**
+ * @brief enable the per-instance attributes of the bound VAO
+ *
+ * @note they are pointed at the instance ring when the scene is drawn.
+ */
+void enableInstanceAttributes();
+
+/**
+ * @brief fill the render queue with the objects in the scene and sort it
+ *
+ * @note the objects are placed with gameContext.renderMatrices.
+ */
+void buildRenderQueue(GameContext &gameContext);
+
+/**
+ * @brief sort the objects in the scene and draw them
+ *
+ * @note objects with the same geometry (and level of detail) which end up next
+ * to each other in the render queue become one instanced draw command. Every
+ * piece of geometry is in the arena, so the commands only differ in their
+ * offsets: where multi-draw-indirect is supported, each run of them with the
+ * same texture is drawn with one call. Otherwise they are drawn one by one,
+ * still without switching VAOs.
+ */
+void renderScene(GameContext &gameContext);
+} // namespace seagull
+
+#endif
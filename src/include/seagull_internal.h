@@ -4,22 +4,138 @@
 #include <gl/glew.h> // Must be included before gl.h (which is included by glfw3.h)
 
 #include <GLFW/glfw3.h>
-#include <list>
+#include <assetLoader.h>
+#include <assetPack.h>
+#include <culling.h>
+#include <geometryArena.h>
+#include <instanceRing.h>
+#include <jobSystem.h>
+#include <mutex>
+#include <profiler.h>
+#include <raycaster.h>
+#include <renderQueue.h>
 #include <seagull/gameObject.h>
 #include <seagull/seagull.h>
+#include <seagull/stats.h>
 #include <shaders.h>
+#include <simulation.h>
+#include <slotMap.h>
+#include <thread>
+#include <transformStore.h>
+#include <unordered_map>
 #include <vector>
 
 namespace seagull {
+struct GpuTexture;
+struct GameObjectGeometry;
+
+// How meshes are processed before they are uploaded. A copy is taken when a
+// load starts, so changing these doesn't affect loads which are in progress.
+struct GeometryOptions {
+  bool generateLods = true; // Simplified levels of detail
+  // Whether to draw the triangles facing outwards first (see
+  // optimizeOverdraw). They are always reordered for the vertex cache.
+  bool optimizeOverdraw = true;
+  // Whether to keep a BVH of the triangles, so that rays can hit them.
+  bool buildRaycastBvh = true;
+};
+
 struct GameContext {
   GLFWwindow *window = nullptr;
-  std::unique_ptr<Shaders>
-      shaders; // We don't want it to be initialized immediately.
+  // The thread which owns the window's OpenGL context (the one which created
+  // the game, and so this).
+  std::thread::id renderThread = std::this_thread::get_id();
+  ShaderManager shaders;
+  // Where every piece of geometry's vertices and indices live. This comes
+  // before anything which holds geometry, since geometry gives its space back
+  // when it is destroyed.
+  GeometryArena geometryArena;
 
-  std::list<GameObject> gameObjects; // Must be std::list to avoid invalidating
-  std::list<GameObject> templateGameObjects;
-  // references all the time
+  // The render and transform passes walk straight through these. GameObject
+  // handles refer into them. (GameObjectState is defined in
+  // gameObject_internal.h, which has to be included wherever these are used.)
+  SlotMap<GameObjectState> gameObjects;
+  SlotMap<GameObjectState> templateGameObjects;
   std::vector<std::function<void()>> updateFunctions;
+  std::vector<UpdateOptions> updateOptions; // Parallel to updateFunctions
+  // Rebuilt every frame, kept to avoid reallocating.
+  std::vector<JobHandle> updateJobs;
+  // Queued by runOnRenderThread (possibly from several threads at once).
+  std::mutex renderThreadFunctionsMutex;
+  std::vector<std::function<void()>> renderThreadFunctions;
+
+  // Shared by the engine and parallel update functions.
+  JobSystem jobs;
+  // This must come after the job system, since it waits for its own jobs when
+  // it is destroyed.
+  AssetLoader assetLoader{jobs};
+
+  // The textures which have been uploaded, by image (or by PackedTexture for
+  // asset packs). This lets objects with the same image (such as parts of an
+  // atlas) share a texture.
+  std::unordered_map<const void *, std::weak_ptr<GpuTexture>> gpuTextures;
+  // The textures nobody uses any more are cleared out of gpuTextures once it
+  // reaches this size (see pruneGpuTextures).
+  size_t gpuTexturesPruneSize = 0;
+  // The same for meshes from asset packs, by PackedMesh. Packs stay open for
+  // as long as the game, so the keys can't be reused.
+  std::unordered_map<const void *, std::weak_ptr<GameObjectGeometry>>
+      packedGeometries;
+
+  // Whether geometry keeps its mesh (and the image of its texture) in memory
+  // after uploading it.
+  bool retainMeshData = true;
+  GeometryOptions geometryOptions;
+  // For every mesh created so far (other than from asset packs).
+  VertexCacheStats vertexCacheStats{};
+
+  // Searched in the order they were opened.
+  std::vector<std::unique_ptr<AssetPack>> assetPacks;
+
+  // The transforms of every game object (including templates).
+  TransformStore transforms;
+
+  // Bumped whenever a game object is created or destroyed, so that the
+  // raycaster knows to rebuild.
+  uint64_t sceneChanges = 0;
+  SceneRaycaster raycaster;
+
+  // The world matrices to draw with this frame, by transform slot: either the
+  // transform store's own, or interpolatedMatrices.
+  const std::vector<Eigen::Matrix4f> *renderMatrices = nullptr;
+
+  Eigen::Matrix4f viewMatrix = Eigen::Matrix4f::Identity();
+  Eigen::Matrix4f projectionMatrix = Eigen::Matrix4f::Identity();
+  float zNear = 0, zFar = 1;
+  float viewportHeight = 1; // In pixels
+
+  // These are rebuilt every frame, but we keep them around to avoid
+  // reallocating.
+  FrustumCuller culler;
+  RenderQueue renderQueue;
+
+  InstanceRing instanceRing;
+  // The generation of the instance ring which the arena's instance attributes
+  // point at (0 if they don't point at the start of any).
+  uint64_t instanceRingGeneration = 0;
+  DrawCommandBuffer drawCommands;
+  size_t drawCalls = 0; // In the most recent frame
+
+  CullingStats cullingStats{}; // For the most recent frame
+
+  Profiler profiler;
+
+  // Zero unless the update functions run at a fixed rate (see setTickRate).
+  SimulationClock::duration tickInterval{};
+  TransformSnapshots transformSnapshots;
+  // Filled in from the snapshots each frame while the simulation runs.
+  std::vector<Eigen::Matrix4f> interpolatedMatrices;
+  // The transform slots of game objects created while the simulation runs,
+  // which have to be patched into the snapshots.
+  std::vector<uint32_t> newTransformSlots;
+  // This is last so that it is destroyed first: its ticks use everything
+  // else.
+  SimulationThread simulation;
 };
 } // namespace seagull
 
@@ -2,47 +2,119 @@
 #define SEAGULL_SHADERS_H
 
 #include <Eigen/Dense>
+#include <array>
 #include <gl/glew.h>
+#include <memory>
 #include <string>
 
 namespace seagull {
+enum class ShaderVariant {
+  DEFAULT,   // The model matrix is a uniform
+  INSTANCED, // The matrices are per-instance vertex attributes
+  COUNT,
+};
+
+// Every uniform which any of the programs uses. Each program looks up all of
+// their locations once, when it is linked, so setting one is just an array
+// lookup. Uniforms which a program doesn't have are at location -1, which
+// OpenGL ignores.
+enum class Uniform {
+  MODEL,
+  VIEW,
+  PROJECTION,
+  TEXTURE_UNIT,
+  COUNT,
+};
+
 class Shaders {
 private:
-  unsigned int vertexShader;
-  unsigned int fragmentShader;
   unsigned int shaderProgram;
+  std::array<int, (size_t)Uniform::COUNT> uniformLocations;
+  bool fromCache = false;
+
+  void link(const std::string &vertexShaderSource,
+            const std::string &fragmentShaderSource, bool retrievable);
+  bool loadBinary(const std::string &fileName);
+  void saveBinary(const std::string &fileName) const;
 
 public:
+  /**
+   * @param cacheDirectory where to keep the linked program, so that later
+   * runs can skip compiling it (or empty not to). The cache is keyed by the
+   * sources and the driver, and anything wrong with it just means compiling
+   * from source again.
+   */
   Shaders(const std::string &vertexShaderSource,
-          const std::string &fragmentShaderSource);
-  Shaders();
+          const std::string &fragmentShaderSource,
+          const std::string &cacheDirectory = "");
+  Shaders(ShaderVariant variant = ShaderVariant::DEFAULT,
+          const std::string &cacheDirectory = "");
   ~Shaders();
 
+  Shaders(const Shaders &) = delete;
+  Shaders &operator=(const Shaders &) = delete;
+
   void use() { glUseProgram(shaderProgram); }
 
-  unsigned getUniformLocation(const std::string &name) {
-    return glGetUniformLocation(shaderProgram, name.c_str());
+  // Whether the program was loaded from the cache rather than compiled.
+  bool isFromCache() const { return fromCache; }
+
+  int getUniformLocation(Uniform uniform) const {
+    return uniformLocations[(size_t)uniform];
   }
 
-  void setUniformFloat(unsigned uniform, float value) {
-    glUniform1f(uniform, value);
+  void setUniformFloat(Uniform uniform, float value) {
+    glUniform1f(getUniformLocation(uniform), value);
+  }
+  void setUniformInt(Uniform uniform, int value) {
+    glUniform1i(getUniformLocation(uniform), value);
   }
-  void setUniformInt(unsigned uniform, int value) {
-    glUniform1i(uniform, value);
+  void setUniformVector3(Uniform uniform, const Eigen::Vector3f &value) {
+    glUniform3f(getUniformLocation(uniform), value.x(), value.y(), value.z());
   }
-  void setUniformVector3(unsigned uniform, const Eigen::Vector3f &value) {
-    glUniform3f(uniform, value.x(), value.y(), value.z());
+  void setUniformVector4(Uniform uniform, const Eigen::Vector4f &value) {
+    glUniform4f(getUniformLocation(uniform), value.x(), value.y(), value.z(),
+                value.w());
   }
-  void setUniformVector4(unsigned uniform, const Eigen::Vector4f &value) {
-    glUniform4f(uniform, value.x(), value.y(), value.z(), value.w());
+  void setUniformMatrix3(Uniform uniform, const Eigen::Matrix3f &value) {
+    glUniformMatrix3fv(getUniformLocation(uniform), 1, GL_FALSE, value.data());
   }
-  void setUniformMatrix3(const unsigned uniform, const Eigen::Matrix3f &value) {
-    glUniformMatrix3fv(uniform, 1, GL_FALSE, value.data());
+  void setUniformMatrix4(Uniform uniform, const Eigen::Matrix4f &value) {
+    glUniformMatrix4fv(getUniformLocation(uniform), 1, GL_FALSE, value.data());
   }
-  void setUniformMatrix4(const unsigned uniform, const Eigen::Matrix4f &value) {
-    glUniformMatrix4fv(uniform, 1, GL_FALSE, value.data());
+};
+
+/**
+ * @brief builds each shader program the first time it is needed, and keeps
+ * it for the rest of the game
+ *
+ * @note this doesn't touch OpenGL until a program is asked for.
+ */
+class ShaderManager {
+private:
+  std::array<std::unique_ptr<Shaders>, (size_t)ShaderVariant::COUNT> programs;
+  std::string cacheDirectory;
+
+public:
+  // The cache starts off in the user's own cache directory.
+  ShaderManager();
+
+  /**
+   * @brief set where linked programs are cached (or empty not to cache them)
+   *
+   * @note this only affects programs which haven't been built yet.
+   */
+  void setCacheDirectory(std::string directory) {
+    cacheDirectory = std::move(directory);
+  }
+
+  Shaders &get(ShaderVariant variant);
+  Shaders &use(ShaderVariant variant) {
+    Shaders &shaders = get(variant);
+    shaders.use();
+    return shaders;
   }
 };
 } // namespace seagull
 
-#endif
\ No newline at end of file
+#endif
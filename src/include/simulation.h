@@ -0,0 +1,151 @@
+#ifndef SEAGULL_SIMULATION_H
+#define SEAGULL_SIMULATION_H
+
+#include <Eigen/Dense>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <jobSystem.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace seagull {
+struct GameObjectState;
+template <typename T> class SlotMap;
+
+using SimulationClock = std::chrono::steady_clock;
+
+/**
+ * @brief the world matrices at the end of the latest two ticks, passed from
+ * the simulation thread to the render thread
+ *
+ * @note there are three buffers: the render thread interpolates between two of
+ * them while the simulation thread fills in the third. The lock is only held
+ * to swap the third one in, and to pick the two to interpolate between, not
+ * while interpolating. The simulation thread only waits if a frame is still
+ * interpolating from a snapshot it is about to overwrite, which means the
+ * frame has taken longer than a whole tick.
+ */
+class TransformSnapshots {
+private:
+  struct Snapshot {
+    std::vector<Eigen::Matrix4f> matrices; // Indexed by transform slot
+    SimulationClock::time_point time;      // When its tick was due
+  };
+
+  std::array<Snapshot, 3> snapshots;
+  size_t previous = 0, current = 1, spare = 2;
+  // Which snapshots the render thread is interpolating from.
+  std::array<bool, 3> reading{};
+  std::mutex mutex;
+  std::condition_variable readingFinished;
+
+public:
+  /**
+   * @brief make the matrices both of the latest snapshots, so that there is
+   * nothing to interpolate
+   *
+   * @note the simulation thread must not be running.
+   */
+  void reset(const std::vector<Eigen::Matrix4f> &matrices,
+             SimulationClock::time_point time);
+
+  /**
+   * @brief add the matrices at the end of a tick (simulation thread)
+   */
+  void publish(const std::vector<Eigen::Matrix4f> &matrices,
+               SimulationClock::time_point time);
+
+  /**
+   * @brief set the matrix of a slot in both of the latest snapshots
+   *
+   * @note this is for game objects created between ticks, which would
+   * otherwise have nothing to draw with until the next one. The simulation
+   * thread must be between ticks, and this must be called from the render
+   * thread (so never during interpolate).
+   */
+  void patch(uint32_t slot, const Eigen::Matrix4f &matrix);
+
+  /**
+   * @brief work out where every game object should be drawn at a time
+   *
+   * @note the objects are drawn one tick behind: when a snapshot has just
+   * arrived, they are drawn as they were in the one before, and they reach it
+   * just as the next one is due. Translations are interpolated linearly and
+   * rotations spherically.
+   *
+   * @param matrices filled in for each game object's transform slot
+   */
+  void interpolate(SimulationClock::time_point time,
+                   const SlotMap<GameObjectState> &gameObjects,
+                   std::vector<Eigen::Matrix4f> &matrices, JobSystem &jobs);
+};
+
+/**
+ * @brief runs ticks at a fixed rate on a thread of its own
+ *
+ * @note each tick is run while holding the scene lock, so the render thread
+ * can change the scene in between ticks by taking it. If the ticks fall too
+ * far behind, the missed ones are skipped rather than run back to back
+ * forever.
+ */
+class SimulationThread {
+public:
+  // The tick function is given the time at which the tick was due.
+  using Tick = std::function<void(SimulationClock::time_point)>;
+
+private:
+  static constexpr unsigned MAX_TICKS_BEHIND = 5;
+
+  std::mutex sceneMutex;
+  std::mutex stopMutex;
+  std::condition_variable stopCondition;
+  bool stopping = false;
+  std::atomic<bool> failed = false;
+  std::exception_ptr error;
+  std::thread thread;
+  std::atomic<uint64_t> tickCount = 0, skippedTickCount = 0;
+
+  void loop(SimulationClock::duration interval,
+            SimulationClock::time_point firstTick, const Tick &tick);
+
+public:
+  SimulationThread() = default;
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  void start(SimulationClock::duration interval,
+             SimulationClock::time_point firstTick, Tick tick);
+  /**
+   * @brief wait for the current tick to finish, and stop
+   *
+   * @note if a tick threw an exception, it is rethrown here (once).
+   */
+  void stop();
+
+  bool isRunning() const { return thread.joinable(); }
+  // Whether a tick has thrown an exception (which stops the thread).
+  bool hasFailed() const { return failed; }
+
+  /**
+   * @brief take the scene lock if no tick is running
+   *
+   * @note the lock doesn't own the mutex if a tick is running.
+   */
+  std::unique_lock<std::mutex> tryLockScene() {
+    return std::unique_lock<std::mutex>(sceneMutex, std::try_to_lock);
+  }
+
+  uint64_t getTickCount() const { return tickCount; }
+  uint64_t getSkippedTickCount() const { return skippedTickCount; }
+};
+} // namespace seagull
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef SEAGULL_SLOT_MAP_H
+#define SEAGULL_SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <seagull/slotHandle.h>
+#include <utility>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief stores values densely, and hands out handles which stay valid until
+ * the value is removed
+ *
+ * @note the values are kept packed together in one array (in no particular
+ * order), so iterating over them walks through memory in order. Each handle
+ * indexes a slot, which records where its value currently is. Removing a value
+ * moves the last value into its place, so it takes constant time, and the
+ * slot goes onto a free list to be reused.
+ *
+ * @note inserting or removing moves values around, so pointers and references
+ * to values (and iterators) are only good until the next insertion or removal.
+ * Keep handles instead.
+ */
+template <typename T> class SlotMap {
+private:
+  static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+  struct Slot {
+    // Where the value is in values, or the next free slot if this one is
+    // free.
+    uint32_t index;
+    // Odd while the slot is in use, so that a default handle (generation 0)
+    // never matches.
+    uint32_t generation;
+  };
+
+  std::vector<T> values;
+  std::vector<uint32_t> valueSlots; // The slot of each value
+  std::vector<Slot> slots;
+  uint32_t firstFreeSlot = NO_SLOT;
+
+  const Slot *findSlot(SlotHandle handle) const {
+    if (handle.index >= slots.size()) {
+      return nullptr;
+    }
+    const Slot &slot = slots[handle.index];
+    return slot.generation == handle.generation && (slot.generation & 1)
+               ? &slot
+               : nullptr;
+  }
+
+public:
+  SlotHandle insert(T value) {
+    uint32_t slotIndex;
+    if (firstFreeSlot != NO_SLOT) {
+      slotIndex = firstFreeSlot;
+      firstFreeSlot = slots[slotIndex].index;
+    } else {
+      slotIndex = slots.size();
+      slots.push_back({0, 0});
+    }
+    Slot &slot = slots[slotIndex];
+    slot.index = values.size();
+    slot.generation++; // Now odd
+    values.push_back(std::move(value));
+    valueSlots.push_back(slotIndex);
+    return {slotIndex, slot.generation};
+  }
+
+  /**
+   * @brief remove a value
+   *
+   * @return false if the handle didn't refer to anything
+   */
+  bool erase(SlotHandle handle) {
+    if (!findSlot(handle)) {
+      return false;
+    }
+    Slot &slot = slots[handle.index];
+    uint32_t index = slot.index;
+    if (index != values.size() - 1) {
+      values[index] = std::move(values.back());
+      valueSlots[index] = valueSlots.back();
+      slots[valueSlots[index]].index = index;
+    }
+    values.pop_back();
+    valueSlots.pop_back();
+    slot.generation++; // Now even (wrapping around to 0 is fine)
+    slot.index = firstFreeSlot;
+    firstFreeSlot = handle.index;
+    return true;
+  }
+
+  bool contains(SlotHandle handle) const { return findSlot(handle); }
+
+  /**
+   * @return the value, or nullptr if the handle doesn't refer to anything
+   */
+  T *get(SlotHandle handle) {
+    const Slot *slot = findSlot(handle);
+    return slot ? &values[slot->index] : nullptr;
+  }
+  const T *get(SlotHandle handle) const {
+    const Slot *slot = findSlot(handle);
+    return slot ? &values[slot->index] : nullptr;
+  }
+
+  void reserve(size_t capacity) {
+    values.reserve(capacity);
+    valueSlots.reserve(capacity);
+  }
+
+  /**
+   * @brief get the handle of the value at a position in the iteration order
+   */
+  SlotHandle getHandle(size_t valueIndex) const {
+    uint32_t slotIndex = valueSlots[valueIndex];
+    return {slotIndex, slots[slotIndex].generation};
+  }
+
+  auto begin() { return values.begin(); }
+  auto end() { return values.end(); }
+  auto begin() const { return values.begin(); }
+  auto end() const { return values.end(); }
+  size_t size() const { return values.size(); }
+  bool empty() const { return values.empty(); }
+};
+} // namespace seagull
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SEAGULL_TRANSFORM_STORE_H
+#define SEAGULL_TRANSFORM_STORE_H
+
+#include <Eigen/Dense>
+#include <atomic>
+#include <cstdint>
+#include <jobSystem.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief the transforms of every game object, stored as a structure of arrays
+ *
+ * @note each game object owns a slot, which indexes into every one of the
+ * arrays. Keeping each component packed together (rather than keeping a few
+ * matrices in every game object) means that updating the world matrices walks
+ * through memory in order, and lets us compose several of them at once with
+ * SIMD instructions.
+ *
+ * @note setting a transform only marks the slot as dirty. The world matrices
+ * of every dirty slot are composed in one go by update(), which runs once per
+ * frame just before rendering. If something needs a world matrix before then,
+ * getWorldMatrix() composes just that one.
+ *
+ * @note different slots can be changed from different threads at the same
+ * time (there is one dirty flag per slot, and the counters are atomic), but
+ * slots can only be allocated (or released) from one thread at a time.
+ */
+class TransformStore {
+public:
+  std::vector<float> translateX, translateY, translateZ;
+  std::vector<float> rotateX, rotateY, rotateZ;
+  std::vector<float> scale;
+  // These are always affine (the bottom row is 0 0 0 1).
+  std::vector<Eigen::Matrix4f> worldMatrices;
+
+private:
+  std::vector<uint8_t> dirty;
+  std::vector<uint32_t> dirtySlots; // Gathered from the flags by update()
+  std::vector<uint32_t> freeSlots;  // Released, and waiting to be reused
+
+  // Every change would have cost a recomputation if we didn't defer them, so
+  // the difference between these is the number of recomputations saved.
+  std::atomic<uint64_t> changeCount = 0;
+  std::atomic<uint64_t> recomputationCount = 0;
+
+  void composeSlot(uint32_t slot);
+  void composeSlots(const uint32_t *slots, size_t count);
+
+public:
+  /**
+   * @brief create a new slot with the identity transform
+   */
+  uint32_t allocate();
+  /**
+   * @brief create a new slot with the same transform as an existing one
+   */
+  uint32_t duplicate(uint32_t slot);
+  /**
+   * @brief give a slot back, so that a later allocation can reuse it
+   */
+  void release(uint32_t slot);
+
+  void markDirty(uint32_t slot) {
+    changeCount.fetch_add(1, std::memory_order_relaxed);
+    dirty[slot] = true;
+  }
+
+  /**
+   * @brief get the world matrix of a slot, composing it first if it is dirty
+   */
+  const Eigen::Matrix4f &getWorldMatrix(uint32_t slot) {
+    if (dirty[slot]) {
+      composeSlot(slot);
+      dirty[slot] = false;
+    }
+    return worldMatrices[slot];
+  }
+
+  /**
+   * @brief recompose the world matrix of every dirty slot
+   *
+   * @param jobs if given, large batches are split across its workers
+   */
+  void update(JobSystem *jobs = nullptr);
+
+  size_t size() const { return scale.size(); }
+
+  uint64_t getChangeCount() const { return changeCount; }
+  uint64_t getRecomputationCount() const { return recomputationCount; }
+};
+} // namespace seagull
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SEAGULL_VERTEX_CACHE_H
+#define SEAGULL_VERTEX_CACHE_H
+
+#include <cstdint>
+#include <seagull/stats.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief reorder triangles so that the GPU's post-transform vertex cache gets
+ * as many hits as possible
+ *
+ * @note this is Tom Forsyth's linear-speed vertex cache optimisation: it
+ * greedily emits the triangle whose vertices score highest, where vertices
+ * score highly for being recently used (so they are likely to still be in the
+ * cache) and for having few triangles left (so they can be finished off and
+ * forgotten). Only the order of the triangles changes, and each keeps its
+ * winding. It throws std::invalid_argument if the indices aren't whole
+ * triangles.
+ *
+ * @param clusterStarts if given, this is filled with the first triangle of
+ * each run which started with a cold cache (a good place to cut the triangles
+ * into clusters, since reordering the runs barely affects the cache)
+ */
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount,
+                         std::vector<size_t> *clusterStarts = nullptr);
+
+/**
+ * @brief reorder clusters of triangles so that the ones facing outwards are
+ * drawn first
+ *
+ * @note those are the triangles most likely to be in front, so fewer of the
+ * ones drawn after them pass the depth test, and fewer pixels are shaded more
+ * than once (Sander, Nehab and Barczak's "Tipsify"). Each cluster stays in one
+ * piece, so this keeps most of the cache hits of the order it is given. Like
+ * optimizeVertexCache, it throws std::invalid_argument if the indices aren't
+ * whole triangles.
+ *
+ * @param positions 3 floats per vertex
+ * @param clusterStarts the first triangle of each cluster, in order (see
+ * optimizeVertexCache)
+ */
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+                      const std::vector<float> &positions,
+                      const std::vector<size_t> &clusterStarts);
+
+/**
+ * @brief count the vertices which would miss a simulated post-transform cache
+ *
+ * @note this simulates a small first-in first-out cache, like the ones in most
+ * GPUs. Dividing by the number of triangles gives the average cache miss ratio
+ * (ACMR), which is between 0.5 (for an ideal order on a large, regular mesh)
+ * and 3 (for no reuse at all).
+ */
+uint64_t countVertexCacheMisses(const std::vector<uint32_t> &indices,
+                                size_t vertexCount);
+
+inline void addVertexCacheStats(VertexCacheStats &total,
+                                const VertexCacheStats &mesh) {
+  total.meshes += mesh.meshes;
+  total.triangles += mesh.triangles;
+  total.missesBefore += mesh.missesBefore;
+  total.missesAfter += mesh.missesAfter;
+}
+} // namespace seagull
+
+#endif
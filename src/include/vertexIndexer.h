@@ -0,0 +1,37 @@
+#ifndef SEAGULL_VERTEX_INDEXER_H
+#define SEAGULL_VERTEX_INDEXER_H
+
+#include <cstdint>
+#include <jobSystem.h>
+#include <seagull/mesh.h>
+#include <vector>
+
+namespace seagull {
+/**
+ * @brief the de-duplicated vertex data for a mesh, ready to be uploaded to the
+ * GPU
+ *
+ * @note vertices are in the order in which they first appear in the mesh, so
+ * the output is the same no matter how the work is split up.
+ */
+struct IndexedVertices {
+  std::vector<float> vertices;           // 3 floats per vertex
+  std::vector<float> textureCoordinates; // 2 floats per vertex
+  std::vector<uint32_t> indices;         // 3 indices per triangle
+
+  size_t vertexCount() const { return vertices.size() / 3; }
+};
+
+/**
+ * @brief weld identical vertex/texture coordinate combinations together
+ *
+ * @note this uses a hash map keyed on the bit patterns of the position and
+ * texture coordinate, so it runs in linear time. If a job system is given,
+ * large meshes are split across its workers and the partial results are merged
+ * afterwards.
+ */
+IndexedVertices indexVertices(const Mesh &mesh, const Texture &texture,
+                              JobSystem *jobs = nullptr);
+} // namespace seagull
+
+#endif
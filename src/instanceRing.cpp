@@ -0,0 +1,110 @@
+#include <instanceRing.h>
+
+namespace seagull {
+static constexpr size_t INITIAL_CAPACITY = 4096;
+
+InstanceRing::~InstanceRing() {
+  for (GLsync &fence : fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  if (buffer) {
+    if (persistentMapping) {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glDeleteBuffers(1, &buffer);
+  }
+}
+
+void InstanceRing::waitForFence(size_t regionIndex) {
+  GLsync &fence = fences[regionIndex];
+  if (!fence) {
+    return;
+  }
+  // The first wait flushes, in case the fence hasn't even been sent yet.
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  static constexpr GLuint64 ONE_SECOND = 1000000000;
+  while (true) {
+    GLenum result = glClientWaitSync(fence, flags, ONE_SECOND);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED ||
+        result == GL_WAIT_FAILED) {
+      break;
+    }
+    flags = 0;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+void InstanceRing::allocate(size_t instanceCapacity) {
+  // Nothing may still be reading from the old buffer.
+  for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+    waitForFence(i);
+  }
+  if (buffer) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (persistentMapping) {
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      persistentMapping = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+  }
+  capacity = instanceCapacity;
+  size_t size = capacity * STRIDE * FRAMES_IN_FLIGHT;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  persistent = GLEW_ARB_buffer_storage;
+  if (persistent) {
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+    persistentMapping =
+        (unsigned char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    // If that failed we can still map each frame's region (the storage
+    // allows writes).
+    persistent = persistentMapping != nullptr;
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  }
+  generation++;
+}
+
+InstanceData *InstanceRing::beginFrame(size_t instanceCount) {
+  if (!buffer || instanceCount > capacity) {
+    size_t newCapacity = capacity ? capacity : INITIAL_CAPACITY;
+    while (newCapacity < instanceCount) {
+      newCapacity *= 2;
+    }
+    allocate(newCapacity);
+  }
+  region = (region + 1) % FRAMES_IN_FLIGHT;
+  waitForFence(region);
+  size_t offset = region * capacity * STRIDE;
+  if (persistent) {
+    frameMapping = (InstanceData *)(persistentMapping + offset);
+  } else if (instanceCount > 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    frameMapping = (InstanceData *)glMapBufferRange(
+        GL_ARRAY_BUFFER, offset, instanceCount * STRIDE,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT);
+  } else {
+    frameMapping = nullptr;
+  }
+  return frameMapping;
+}
+
+void InstanceRing::finishWriting() {
+  if (!persistent && frameMapping) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  frameMapping = nullptr;
+}
+
+void InstanceRing::endFrame() {
+  fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+} // namespace seagull
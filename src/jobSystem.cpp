@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <jobSystem.h>
+
+namespace seagull {
+struct Job {
+  std::function<void()> work;
+  // Counts the unfinished dependencies, plus one while the job is still being
+  // submitted (so that it can't start before then).
+  std::atomic<size_t> blockers = 1;
+
+  std::mutex mutex; // Protects the next two.
+  bool finished = false;
+  std::vector<JobHandle> dependents;
+
+  std::atomic<bool> done = false;
+  std::exception_ptr exception;
+};
+
+// The index of the current thread's queue, if it is one of our workers.
+static thread_local JobSystem *currentJobSystem = nullptr;
+static thread_local size_t currentWorkerIndex = 0;
+
+JobSystem::JobSystem(size_t workerCount) {
+  for (size_t i = 0; i < workerCount + 1; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < workerCount; i++) {
+    workers.emplace_back([this, i]() { workerLoop(i); });
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard lock(sleepMutex);
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void JobSystem::enqueue(JobHandle job) {
+  size_t queueIndex = currentJobSystem == this ? currentWorkerIndex
+                                               : queues.size() - 1;
+  {
+    Queue &queue = *queues[queueIndex];
+    std::lock_guard lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+  }
+  {
+    // Taking the lock here makes sure a worker which is just about to go to
+    // sleep sees the new job.
+    std::lock_guard lock(sleepMutex);
+    queuedJobCount++;
+  }
+  wakeCondition.notify_one();
+}
+
+JobHandle JobSystem::takeJob() {
+  size_t queueCount = queues.size();
+  size_t ownIndex =
+      currentJobSystem == this ? currentWorkerIndex : queueCount - 1;
+  // Newest first from our own queue...
+  {
+    Queue &queue = *queues[ownIndex];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      JobHandle job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+      queuedJobCount--;
+      return job;
+    }
+  }
+  // ...and oldest first from everyone else's.
+  for (size_t offset = 1; offset < queueCount; offset++) {
+    Queue &queue = *queues[(ownIndex + offset) % queueCount];
+    std::lock_guard lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      JobHandle job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+      queuedJobCount--;
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+void JobSystem::runJob(const JobHandle &job) {
+  try {
+    job->work();
+  } catch (...) {
+    job->exception = std::current_exception();
+  }
+  std::vector<JobHandle> dependents;
+  {
+    std::lock_guard lock(job->mutex);
+    job->finished = true;
+    dependents.swap(job->dependents);
+  }
+  for (JobHandle &dependent : dependents) {
+    if (--dependent->blockers == 0) {
+      enqueue(std::move(dependent));
+    }
+  }
+  job->done = true;
+}
+
+void JobSystem::workerLoop(size_t workerIndex) {
+  currentJobSystem = this;
+  currentWorkerIndex = workerIndex;
+  while (true) {
+    if (JobHandle job = takeJob()) {
+      runJob(job);
+      continue;
+    }
+    std::unique_lock lock(sleepMutex);
+    wakeCondition.wait(lock,
+                       [this]() { return stopping || queuedJobCount > 0; });
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+JobHandle JobSystem::submit(std::function<void()> work,
+                            const std::vector<JobHandle> &dependencies) {
+  auto job = std::make_shared<Job>();
+  job->work = std::move(work);
+  for (const JobHandle &dependency : dependencies) {
+    std::lock_guard lock(dependency->mutex);
+    if (!dependency->finished) {
+      job->blockers++;
+      dependency->dependents.push_back(job);
+    }
+  }
+  if (--job->blockers == 0) {
+    enqueue(job);
+  }
+  return job;
+}
+
+void JobSystem::wait(const JobHandle &job) {
+  while (!job->done) {
+    if (JobHandle otherJob = takeJob()) {
+      runJob(otherJob);
+    } else {
+      // Whatever we're waiting for is running on another thread.
+      std::this_thread::yield();
+    }
+  }
+  if (job->exception) {
+    std::rethrow_exception(job->exception);
+  }
+}
+
+// What a parallelFor's batches share. Helper jobs can start after the
+// parallelFor has returned (when the other threads have already taken every
+// batch), so this lives as long as they do, and the body is only touched by
+// whoever takes a batch.
+struct ParallelForState {
+  const std::function<void(size_t begin, size_t end)> *body;
+  size_t count;
+  size_t batchSize;
+  size_t batchCount;
+  std::atomic<size_t> nextBatch = 0;
+  std::atomic<size_t> finishedBatches = 0;
+  std::atomic<bool> failed = false;
+  std::exception_ptr exception; // The first one thrown
+
+  // Run batches until there are none left to take.
+  void runBatches() {
+    for (size_t batch = nextBatch++; batch < batchCount; batch = nextBatch++) {
+      // Once a batch has thrown, the rest are skipped.
+      if (!failed) {
+        size_t begin = batch * batchSize;
+        try {
+          (*body)(begin, std::min(count, begin + batchSize));
+        } catch (...) {
+          if (!failed.exchange(true)) {
+            exception = std::current_exception();
+          }
+        }
+      }
+      finishedBatches++;
+    }
+  }
+};
+
+void JobSystem::parallelFor(
+    size_t count, size_t minimumBatchSize,
+    const std::function<void(size_t begin, size_t end)> &body) {
+  // A few batches per thread evens things out if some batches are slower.
+  size_t maximumBatches = (getWorkerCount() + 1) * 4;
+  size_t batchCount = std::clamp<size_t>(
+      count / std::max<size_t>(minimumBatchSize, 1), 1, maximumBatches);
+  if (batchCount == 1 || getWorkerCount() == 0) {
+    body(0, count);
+    return;
+  }
+  auto state = std::make_shared<ParallelForState>();
+  state->body = &body;
+  state->count = count;
+  state->batchSize = (count + batchCount - 1) / batchCount;
+  state->batchCount = (count + state->batchSize - 1) / state->batchSize;
+  // Idle workers pick up the helpers, while this thread works through the
+  // batches itself. Unlike wait, it never runs anybody else's jobs, so a
+  // parallelFor on the render thread can't get stuck behind a slow update
+  // function it happened to pick up.
+  size_t helperCount = std::min(getWorkerCount(), state->batchCount - 1);
+  for (size_t i = 0; i < helperCount; i++) {
+    submit([state]() { state->runBatches(); });
+  }
+  state->runBatches();
+  while (state->finishedBatches < state->batchCount) {
+    // The last few batches are running on other threads.
+    std::this_thread::yield();
+  }
+  if (state->failed) {
+    std::rethrow_exception(state->exception);
+  }
+}
+} // namespace seagull
@@ -0,0 +1,86 @@
+#include <mappedFile.h>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace seagull {
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &fileName) {
+  fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                           nullptr);
+  if (fileHandle == INVALID_HANDLE_VALUE) {
+    fileHandle = nullptr;
+    throw std::runtime_error("Failed to open " + fileName);
+  }
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(fileHandle, &fileSize);
+  size = (size_t)fileSize.QuadPart;
+  if (size == 0) {
+    return; // Windows won't map an empty file
+  }
+  mappingHandle =
+      CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mappingHandle) {
+    data = (const unsigned char *)MapViewOfFile(mappingHandle, FILE_MAP_READ,
+                                                0, 0, 0);
+  }
+  if (!data) {
+    if (mappingHandle) {
+      CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+    throw std::runtime_error("Failed to map " + fileName);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    UnmapViewOfFile(data);
+  }
+  if (mappingHandle) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle) {
+    CloseHandle(fileHandle);
+  }
+}
+#else
+MappedFile::MappedFile(const std::string &fileName) {
+  int file = open(fileName.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("Failed to open " + fileName);
+  }
+  struct stat fileStatus;
+  if (fstat(file, &fileStatus) != 0) {
+    close(file);
+    throw std::runtime_error("Failed to read the size of " + fileName);
+  }
+  size = fileStatus.st_size;
+  if (size > 0) {
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapping == MAP_FAILED) {
+      close(file);
+      throw std::runtime_error("Failed to map " + fileName);
+    }
+    data = (const unsigned char *)mapping;
+  }
+  // The mapping keeps the file alive by itself.
+  close(file);
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    munmap((void *)data, size);
+  }
+}
+#endif
+} // namespace seagull
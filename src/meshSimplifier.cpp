@@ -0,0 +1,361 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <meshSimplifier.h>
+#include <queue>
+#include <unordered_map>
+
+namespace seagull {
+// Meshes with fewer triangles than this aren't worth simplifying.
+static constexpr size_t MIN_LOD_TRIANGLES = 64;
+static constexpr size_t MAX_LOD_LEVELS = 4;
+// A level has to lose at least this fraction of the previous level's triangles
+// to be worth keeping.
+static constexpr float MIN_LOD_REDUCTION = 0.25f;
+// How much more a boundary edge's constraint counts than an ordinary plane.
+static constexpr double BOUNDARY_WEIGHT = 10;
+
+namespace {
+// The sum of the squared distances from a set of planes, as a symmetric 4x4
+// matrix (only the upper triangle is stored).
+struct Quadric {
+  std::array<double, 10> q{};
+
+  void addPlane(const Eigen::Vector3d &normal, double d, double weight = 1) {
+    double a = normal.x(), b = normal.y(), c = normal.z();
+    std::array<double, 10> plane = {a * a, a * b, a * c, a * d, b * b,
+                                    b * c, b * d, c * c, c * d, d * d};
+    for (size_t i = 0; i < q.size(); i++) {
+      q[i] += plane[i] * weight;
+    }
+  }
+
+  Quadric &operator+=(const Quadric &other) {
+    for (size_t i = 0; i < q.size(); i++) {
+      q[i] += other.q[i];
+    }
+    return *this;
+  }
+
+  double evaluate(const Eigen::Vector3d &p) const {
+    double x = p.x(), y = p.y(), z = p.z();
+    double error = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z +
+                   2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z +
+                   2 * q[6] * y + q[7] * z * z + 2 * q[8] * z + q[9];
+    return std::max(error, 0.0); // Rounding can take it slightly negative.
+  }
+};
+
+struct Collapse {
+  double cost;
+  uint32_t from, to;
+  // The versions of the two vertices when this was worked out. If either has
+  // changed since, so has the cost, and there will be a newer entry.
+  uint32_t fromVersion, toVersion;
+
+  bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+class Simplifier {
+private:
+  std::vector<Eigen::Vector3d> positions;
+  std::vector<std::array<uint32_t, 3>> triangles;
+  std::vector<uint8_t> triangleRemoved;
+  // The triangles around each vertex. Removed triangles are cleared out
+  // lazily.
+  std::vector<std::vector<uint32_t>> vertexTriangles;
+  std::vector<Quadric> quadrics;
+  std::vector<uint8_t> locked, removed;
+  // Whether any vertex can be collapsed at all. Meshes which are all seams,
+  // such as voxel chunks, can't be simplified, so they skip all of the work.
+  bool anyUnlocked = false;
+  std::vector<uint32_t> versions;
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> queue;
+  size_t triangleCount;
+
+  Eigen::Vector3d getNormal(const std::array<uint32_t, 3> &triangle) const {
+    return (positions[triangle[1]] - positions[triangle[0]])
+        .cross(positions[triangle[2]] - positions[triangle[0]]);
+  }
+
+  void lockSeams(const IndexedMesh &mesh);
+  void addQuadrics();
+  void pushCollapses(uint32_t vertex);
+  bool canCollapse(uint32_t from, uint32_t to);
+  void collapse(uint32_t from, uint32_t to);
+
+  const std::vector<uint32_t> &getTriangles(uint32_t vertex) {
+    std::vector<uint32_t> &list = vertexTriangles[vertex];
+    std::erase_if(list, [&](uint32_t t) { return triangleRemoved[t]; });
+    return list;
+  }
+
+public:
+  Simplifier(const IndexedMesh &mesh, const std::vector<uint32_t> &indices);
+  SimplifiedIndices run(size_t targetTriangleCount);
+};
+} // namespace
+
+Simplifier::Simplifier(const IndexedMesh &mesh,
+                       const std::vector<uint32_t> &indices) {
+  size_t vertexCount = mesh.getVertexCount();
+  positions.resize(vertexCount);
+  for (size_t i = 0; i < vertexCount; i++) {
+    Point3d position = mesh.getPosition(i);
+    positions[i] = {position.x, position.y, position.z};
+  }
+  vertexTriangles.resize(vertexCount);
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    std::array<uint32_t, 3> triangle = {indices[i], indices[i + 1],
+                                        indices[i + 2]};
+    // Triangles which are already degenerate would only get in the way.
+    if (triangle[0] == triangle[1] || triangle[1] == triangle[2] ||
+        triangle[0] == triangle[2]) {
+      continue;
+    }
+    for (uint32_t vertex : triangle) {
+      vertexTriangles[vertex].push_back(triangles.size());
+    }
+    triangles.push_back(triangle);
+  }
+  triangleRemoved.assign(triangles.size(), false);
+  triangleCount = triangles.size();
+  quadrics.resize(vertexCount);
+  locked.assign(vertexCount, false);
+  removed.assign(vertexCount, false);
+  versions.assign(vertexCount, 0);
+  lockSeams(mesh);
+  for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+    if (!locked[vertex] && !vertexTriangles[vertex].empty()) {
+      anyUnlocked = true;
+      break;
+    }
+  }
+  if (anyUnlocked) {
+    addQuadrics();
+  }
+}
+
+void Simplifier::lockSeams(const IndexedMesh &mesh) {
+  // Vertices are only separate when something about them differs, so two
+  // vertices in the same place must have different texture coordinates.
+  std::unordered_map<uint64_t, uint32_t> firstAtPosition;
+  for (uint32_t vertex = 0; vertex < positions.size(); vertex++) {
+    if (vertexTriangles[vertex].empty()) {
+      continue;
+    }
+    Point3d position = mesh.getPosition(vertex);
+    uint64_t hash = 0xcbf29ce484222325;
+    for (float component : {position.x, position.y, position.z}) {
+      hash ^= std::bit_cast<uint32_t>(component + 0.0f);
+      hash *= 0x100000001b3;
+    }
+    auto [existing, inserted] = firstAtPosition.try_emplace(hash, vertex);
+    // Two different positions with the same hash just get locked for nothing,
+    // which is harmless.
+    if (!inserted) {
+      locked[vertex] = true;
+      locked[existing->second] = true;
+    }
+  }
+}
+
+void Simplifier::addQuadrics() {
+  // Every edge which only one triangle uses is on the boundary.
+  std::unordered_map<uint64_t, uint32_t> edgeUses;
+  auto edgeKey = [](uint32_t a, uint32_t b) {
+    return ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+  };
+  for (const auto &triangle : triangles) {
+    for (unsigned i = 0; i < 3; i++) {
+      edgeUses[edgeKey(triangle[i], triangle[(i + 1) % 3])]++;
+    }
+  }
+  for (const auto &triangle : triangles) {
+    Eigen::Vector3d normal = getNormal(triangle);
+    if (normal.squaredNorm() == 0) {
+      continue;
+    }
+    normal.normalize();
+    double d = -normal.dot(positions[triangle[0]]);
+    for (uint32_t vertex : triangle) {
+      quadrics[vertex].addPlane(normal, d);
+    }
+    // A plane through the boundary edge, at right angles to the triangle,
+    // keeps the boundary's vertices on it.
+    for (unsigned i = 0; i < 3; i++) {
+      uint32_t a = triangle[i], b = triangle[(i + 1) % 3];
+      if (edgeUses[edgeKey(a, b)] != 1) {
+        continue;
+      }
+      Eigen::Vector3d edge = positions[b] - positions[a];
+      Eigen::Vector3d constraintNormal = edge.cross(normal);
+      if (constraintNormal.squaredNorm() == 0) {
+        continue;
+      }
+      constraintNormal.normalize();
+      double constraintD = -constraintNormal.dot(positions[a]);
+      quadrics[a].addPlane(constraintNormal, constraintD, BOUNDARY_WEIGHT);
+      quadrics[b].addPlane(constraintNormal, constraintD, BOUNDARY_WEIGHT);
+    }
+  }
+}
+
+void Simplifier::pushCollapses(uint32_t vertex) {
+  for (uint32_t t : getTriangles(vertex)) {
+    for (uint32_t other : triangles[t]) {
+      if (other == vertex) {
+        continue;
+      }
+      Quadric combined = quadrics[vertex];
+      combined += quadrics[other];
+      if (!locked[other]) {
+        queue.push({combined.evaluate(positions[vertex]), other, vertex,
+                    versions[other], versions[vertex]});
+      }
+      if (!locked[vertex]) {
+        queue.push({combined.evaluate(positions[other]), vertex, other,
+                    versions[vertex], versions[other]});
+      }
+    }
+  }
+}
+
+bool Simplifier::canCollapse(uint32_t from, uint32_t to) {
+  // The vertices next to both ends of the edge must be exactly the ones
+  // opposite the edge, otherwise collapsing it pinches the surface.
+  std::vector<uint32_t> fromNeighbours, toNeighbours;
+  size_t sharedTriangles = 0;
+  for (uint32_t t : getTriangles(from)) {
+    const auto &triangle = triangles[t];
+    bool shared = std::find(triangle.begin(), triangle.end(), to) !=
+                  triangle.end();
+    sharedTriangles += shared;
+    for (uint32_t vertex : triangle) {
+      if (vertex != from && vertex != to) {
+        fromNeighbours.push_back(vertex);
+      }
+    }
+    if (shared) {
+      continue;
+    }
+    // Moving the vertex mustn't flip the triangle over.
+    Eigen::Vector3d before = getNormal(triangle);
+    std::array<uint32_t, 3> after = triangle;
+    std::replace(after.begin(), after.end(), from, to);
+    Eigen::Vector3d afterNormal = getNormal(after);
+    if (afterNormal.dot(before) <= 0 ||
+        afterNormal.squaredNorm() < before.squaredNorm() * 1e-6) {
+      return false;
+    }
+  }
+  for (uint32_t t : getTriangles(to)) {
+    for (uint32_t vertex : triangles[t]) {
+      if (vertex != from && vertex != to) {
+        toNeighbours.push_back(vertex);
+      }
+    }
+  }
+  std::sort(fromNeighbours.begin(), fromNeighbours.end());
+  fromNeighbours.erase(
+      std::unique(fromNeighbours.begin(), fromNeighbours.end()),
+      fromNeighbours.end());
+  std::sort(toNeighbours.begin(), toNeighbours.end());
+  toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()),
+                     toNeighbours.end());
+  std::vector<uint32_t> common;
+  std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(),
+                        toNeighbours.begin(), toNeighbours.end(),
+                        std::back_inserter(common));
+  return sharedTriangles > 0 && common.size() == sharedTriangles;
+}
+
+void Simplifier::collapse(uint32_t from, uint32_t to) {
+  for (uint32_t t : getTriangles(from)) {
+    auto &triangle = triangles[t];
+    if (std::find(triangle.begin(), triangle.end(), to) != triangle.end()) {
+      triangleRemoved[t] = true;
+      triangleCount--;
+    } else {
+      std::replace(triangle.begin(), triangle.end(), from, to);
+      vertexTriangles[to].push_back(t);
+    }
+  }
+  vertexTriangles[from].clear();
+  quadrics[to] += quadrics[from];
+  removed[from] = true;
+  // Every collapse involving the surviving vertex now costs something
+  // different. (The others only depend on their own ends' quadrics.)
+  versions[to]++;
+  pushCollapses(to);
+}
+
+SimplifiedIndices Simplifier::run(size_t targetTriangleCount) {
+  for (uint32_t vertex = 0; anyUnlocked && vertex < positions.size();
+       vertex++) {
+    if (!vertexTriangles[vertex].empty()) {
+      pushCollapses(vertex);
+    }
+  }
+  double maxCost = 0;
+  while (triangleCount > targetTriangleCount && !queue.empty()) {
+    Collapse next = queue.top();
+    queue.pop();
+    if (removed[next.from] || removed[next.to] ||
+        versions[next.from] != next.fromVersion ||
+        versions[next.to] != next.toVersion ||
+        !canCollapse(next.from, next.to)) {
+      continue;
+    }
+    collapse(next.from, next.to);
+    maxCost = std::max(maxCost, next.cost);
+  }
+
+  SimplifiedIndices result;
+  result.indices.reserve(triangleCount * 3);
+  for (size_t t = 0; t < triangles.size(); t++) {
+    if (!triangleRemoved[t]) {
+      result.indices.insert(result.indices.end(), triangles[t].begin(),
+                            triangles[t].end());
+    }
+  }
+  // The cost is a sum of squared distances from planes, so its square root is
+  // roughly a distance.
+  result.error = (float)std::sqrt(maxCost);
+  return result;
+}
+
+SimplifiedIndices simplifyMesh(const IndexedMesh &mesh,
+                               const std::vector<uint32_t> &indices,
+                               size_t targetTriangleCount) {
+  return Simplifier(mesh, indices).run(targetTriangleCount);
+}
+
+std::vector<SimplifiedIndices> buildLodChain(const IndexedMesh &mesh) {
+  std::vector<SimplifiedIndices> levels;
+  const std::vector<uint32_t> *previous = &mesh.getIndices();
+  float previousError = 0;
+  while (levels.size() < MAX_LOD_LEVELS) {
+    size_t previousTriangles = previous->size() / 3;
+    if (previousTriangles < MIN_LOD_TRIANGLES) {
+      break;
+    }
+    SimplifiedIndices level =
+        simplifyMesh(mesh, *previous, previousTriangles / 2);
+    size_t triangles = level.indices.size() / 3;
+    if (triangles > previousTriangles * (1 - MIN_LOD_REDUCTION)) {
+      break;
+    }
+    // Each level starts again from the one before, so the errors add up.
+    level.error += previousError;
+    previousError = level.error;
+    levels.push_back(std::move(level));
+    previous = &levels.back().indices;
+  }
+  return levels;
+}
+} // namespace seagull
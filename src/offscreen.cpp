@@ -0,0 +1,37 @@
+#include <gl/glew.h>
+#include <offscreen.h>
+#include <stdexcept>
+
+namespace seagull {
+OffscreenTarget::OffscreenTarget(int width, int height) {
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+  glGenRenderbuffers(1, &colorRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, colorRenderbuffer);
+
+  glGenRenderbuffers(1, &depthRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depthRenderbuffer);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    glDeleteRenderbuffers(1, &colorRenderbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    throw std::runtime_error("Failed to create the offscreen framebuffer");
+  }
+}
+
+OffscreenTarget::~OffscreenTarget() {
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteRenderbuffers(1, &depthRenderbuffer);
+  glDeleteRenderbuffers(1, &colorRenderbuffer);
+  glDeleteFramebuffers(1, &framebuffer);
+}
+} // namespace seagull
@@ -0,0 +1,164 @@
+#include <gl/glew.h>
+#include <profiler.h>
+
+namespace seagull {
+static constexpr size_t NO_EVENT = (size_t)-1;
+
+Profiler::Scope::Scope(Profiler &profiler, const char *name)
+    : profiler(profiler), eventIndex(NO_EVENT) {
+  if (!profiler.inFrame) {
+    return;
+  }
+  std::vector<ScopeEvent> &scopes = profiler.frames.back().scopes;
+  eventIndex = scopes.size();
+  scopes.push_back({name, profiler.currentDepth++, profiler.now(), 0});
+}
+
+Profiler::Scope::~Scope() {
+  if (eventIndex == NO_EVENT) {
+    return;
+  }
+  ScopeEvent &event = profiler.frames.back().scopes[eventIndex];
+  event.durationMicroseconds = profiler.now() - event.startMicroseconds;
+  profiler.currentDepth--;
+}
+
+Profiler::~Profiler() {
+  for (GpuQuery &query : gpuQueries) {
+    if (query.id) {
+      glDeleteQueries(1, &query.id);
+    }
+  }
+}
+
+int64_t Profiler::now() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               epoch)
+      .count();
+}
+
+void Profiler::beginFrame() {
+  collectGpuResults();
+  if (frames.size() == MAX_RECORDED_FRAMES) {
+    frames.pop_front();
+  }
+  frames.push_back({nextFrameNumber++, now()});
+  currentDepth = 0;
+  inFrame = true;
+}
+
+void Profiler::endFrame() {
+  RecordedFrame &frame = frames.back();
+  frame.durationMicroseconds = now() - frame.startMicroseconds;
+  inFrame = false;
+}
+
+void Profiler::beginGpuTimer() {
+  GpuQuery &query = gpuQueries[frames.back().number % GPU_QUERY_COUNT];
+  if (query.pending) {
+    // The GPU is so far behind that this query still hasn't finished. We
+    // mustn't wait for it, so this frame just goes untimed.
+    return;
+  }
+  if (!query.id) {
+    glGenQueries(1, &query.id);
+  }
+  glBeginQuery(GL_TIME_ELAPSED, query.id);
+  query.frame = frames.back().number;
+  activeGpuQuery = &query;
+}
+
+void Profiler::endGpuTimer() {
+  if (!activeGpuQuery) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  activeGpuQuery->pending = true;
+  activeGpuQuery = nullptr;
+}
+
+void Profiler::collectGpuResults() {
+  for (GpuQuery &query : gpuQueries) {
+    if (!query.pending) {
+      continue;
+    }
+    int available = GL_FALSE;
+    glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      continue;
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+    query.pending = false;
+    double milliseconds = nanoseconds / 1e6;
+    if (query.frame >= latestGpuFrame || latestGpuMilliseconds < 0) {
+      latestGpuFrame = query.frame;
+      latestGpuMilliseconds = milliseconds;
+    }
+    // The frame might already have been dropped from the recording.
+    if (!frames.empty() && query.frame >= frames.front().number) {
+      frames[query.frame - frames.front().number].gpuMilliseconds =
+          milliseconds;
+    }
+  }
+}
+
+FrameProfile Profiler::getLatestFrame() const {
+  FrameProfile profile{};
+  // The last frame is still being recorded if we are in the middle of one.
+  size_t completeFrames = frames.size() - (inFrame ? 1 : 0);
+  if (completeFrames > 0) {
+    const RecordedFrame &frame = frames[completeFrames - 1];
+    profile.frame = frame.number;
+    profile.cpuMilliseconds = frame.durationMicroseconds / 1e3;
+    for (const ScopeEvent &event : frame.scopes) {
+      profile.scopes.push_back(
+          {event.name, event.depth, event.durationMicroseconds / 1e3});
+    }
+  }
+  profile.gpuTimeAvailable = latestGpuMilliseconds >= 0;
+  profile.gpuFrame = latestGpuFrame;
+  profile.gpuMilliseconds =
+      profile.gpuTimeAvailable ? latestGpuMilliseconds : 0;
+  return profile;
+}
+
+// The names are our own string literals, so they never need escaping.
+static void writeTraceEvent(std::ostream &stream, const char *name,
+                            unsigned threadId, int64_t startMicroseconds,
+                            int64_t durationMicroseconds) {
+  stream << ",\n{\"name\":\"" << name
+         << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId
+         << ",\"ts\":" << startMicroseconds
+         << ",\"dur\":" << durationMicroseconds << "}";
+}
+
+void Profiler::writeChromeTrace(std::ostream &stream) const {
+  static constexpr unsigned CPU_THREAD_ID = 1;
+  static constexpr unsigned GPU_THREAD_ID = 2;
+  // The thread names come first, so every event after them needs a comma.
+  stream << "{\"traceEvents\":["
+         << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+         << CPU_THREAD_ID << ",\"args\":{\"name\":\"CPU\"}},"
+         << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+         << GPU_THREAD_ID << ",\"args\":{\"name\":\"GPU\"}}";
+  for (size_t i = 0; i < frames.size(); i++) {
+    const RecordedFrame &frame = frames[i];
+    if (inFrame && i + 1 == frames.size()) {
+      break; // Incomplete
+    }
+    writeTraceEvent(stream, "frame", CPU_THREAD_ID, frame.startMicroseconds,
+                    frame.durationMicroseconds);
+    for (const ScopeEvent &event : frame.scopes) {
+      writeTraceEvent(stream, event.name, CPU_THREAD_ID,
+                      event.startMicroseconds, event.durationMicroseconds);
+    }
+    if (frame.gpuMilliseconds >= 0) {
+      writeTraceEvent(stream, "gpu frame", GPU_THREAD_ID,
+                      frame.startMicroseconds,
+                      (int64_t)(frame.gpuMilliseconds * 1e3));
+    }
+  }
+  stream << "\n]}\n";
+}
+} // namespace seagull
@@ -0,0 +1,71 @@
+#include <gameObject_internal.h>
+#include <raycaster.h>
+#include <slotMap.h>
+
+namespace seagull {
+// Transform a box by an affine matrix, giving a box around the result.
+static Eigen::AlignedBox3f transformBox(const Eigen::Matrix4f &matrix,
+                                        const Eigen::Vector3f &min,
+                                        const Eigen::Vector3f &max) {
+  Eigen::Vector3f centre = (min + max) / 2;
+  Eigen::Vector3f extent = (max - min) / 2;
+  Eigen::Vector3f worldCentre =
+      matrix.topLeftCorner<3, 3>() * centre + matrix.topRightCorner<3, 1>();
+  Eigen::Vector3f worldExtent =
+      matrix.topLeftCorner<3, 3>().cwiseAbs() * extent;
+  return {worldCentre - worldExtent, worldCentre + worldExtent};
+}
+
+void SceneRaycaster::update(SlotMap<GameObjectState> &gameObjects,
+                            uint64_t newSceneChanges,
+                            uint64_t newTransformChanges) {
+  if (built && sceneChanges == newSceneChanges &&
+      transformChanges == newTransformChanges) {
+    return;
+  }
+  entries.clear();
+  std::vector<Eigen::AlignedBox3f> boxes;
+  size_t index = 0;
+  for (GameObjectState &state : gameObjects) {
+    SlotHandle handle = gameObjects.getHandle(index++);
+    const GameObjectGeometry &geometry = *state.geometry;
+    if (!geometry.bvh || geometry.bvh->empty()) {
+      continue;
+    }
+    const Eigen::Matrix4f &worldMatrix = state.getWorldMatrix();
+    boxes.push_back(transformBox(worldMatrix, geometry.bounds.min,
+                                 geometry.bounds.max));
+    entries.push_back({handle, geometry.bvh, worldMatrix.inverse()});
+  }
+  bvh.build(boxes);
+  built = true;
+  sceneChanges = newSceneChanges;
+  transformChanges = newTransformChanges;
+}
+
+std::optional<SceneRaycaster::Hit>
+SceneRaycaster::raycast(const Eigen::Vector3f &origin,
+                        const Eigen::Vector3f &direction,
+                        float maxDistance) const {
+  std::optional<Hit> hit;
+  bvh.raycast(origin, direction, maxDistance,
+              [&](uint32_t item, float &distance) {
+                const Entry &entry = entries[item];
+                // An affine transform keeps distances along the ray in
+                // proportion, so measuring them in lengths of the transformed
+                // direction keeps them in world units.
+                const Eigen::Matrix4f &inverse = entry.inverseWorldMatrix;
+                Eigen::Vector3f localOrigin =
+                    inverse.topLeftCorner<3, 3>() * origin +
+                    inverse.topRightCorner<3, 1>();
+                Eigen::Vector3f localDirection =
+                    inverse.topLeftCorner<3, 3>() * direction;
+                uint32_t triangle;
+                if (entry.bvh->raycast(localOrigin, localDirection, distance,
+                                       triangle)) {
+                  hit = Hit{entry.handle, triangle, distance};
+                }
+              });
+  return hit;
+}
+} // namespace seagull
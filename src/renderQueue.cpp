@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <array>
+#include <renderQueue.h>
+
+namespace seagull {
+// Key layout (most significant bit first):
+// Opaque:      0 | texture (15) | geometry (16) | LOD level (8) | depth (24)
+// Transparent: 1 | inverted depth (24) | texture (15) | geometry (16) | LOD
+// level (8)
+uint64_t RenderQueue::makeKey(bool transparent, uint16_t textureId,
+                              uint16_t geometryId, uint8_t lodLevel,
+                              float depth) {
+  static constexpr uint64_t MAX_DEPTH = (1ull << DEPTH_BITS) - 1;
+  uint64_t quantizedDepth =
+      (uint64_t)(std::clamp(depth, 0.0f, 1.0f) * (float)MAX_DEPTH);
+  uint64_t texture = textureId & 0x7fff;
+  uint64_t geometry = geometryId;
+  uint64_t lod = lodLevel;
+  if (!transparent) {
+    return (texture << 48) | (geometry << 32) | (lod << 24) | quantizedDepth;
+  } else {
+    return (1ull << 63) | ((MAX_DEPTH - quantizedDepth) << 39) |
+           (texture << 24) | (geometry << 8) | lod;
+  }
+}
+
+void RenderQueue::sort() {
+  static constexpr size_t PASSES = sizeof(uint64_t);
+  // Building every histogram up front means we only need one extra pass over
+  // the data, and we can tell which passes are pointless.
+  std::array<std::array<size_t, 256>, PASSES> histograms{};
+  for (const RenderItem &item : items) {
+    for (size_t pass = 0; pass < PASSES; pass++) {
+      histograms[pass][(item.key >> (pass * 8)) & 0xff]++;
+    }
+  }
+  scratch.resize(items.size());
+  for (size_t pass = 0; pass < PASSES; pass++) {
+    auto &histogram = histograms[pass];
+    if (std::find(histogram.begin(), histogram.end(), items.size()) !=
+        histogram.end()) {
+      continue; // Every key has the same value for this byte.
+    }
+    size_t offset = 0;
+    for (size_t &count : histogram) {
+      size_t bucketSize = count;
+      count = offset;
+      offset += bucketSize;
+    }
+    for (const RenderItem &item : items) {
+      scratch[histogram[(item.key >> (pass * 8)) & 0xff]++] = item;
+    }
+    items.swap(scratch);
+  }
+}
+} // namespace seagull
@@ -2,16 +2,248 @@
 #include <renderer.h>
 
 namespace seagull {
-void render(const GameObjectState &gameObject, const GameContext &gameContext,
-            bool bindTexture) {
-  auto &geometry = *gameObject.geometry;
-  if (bindTexture) {
-    glBindTexture(GL_TEXTURE_2D, geometry.textureId);
-  }
-  glBindVertexArray(geometry.vao);
-  glDrawElements(GL_TRIANGLES,
-                 geometry.mesh.size() * 3 /* points per triangle */,
-                 GL_UNSIGNED_INT, nullptr);
+void enableInstanceAttributes() {
+  // A mat4 attribute takes up four consecutive locations (one per column).
+  for (unsigned column = 0; column < 4; column++) {
+    glVertexAttribDivisor(INSTANCE_MVP_ATTRIBUTE + column, 1);
+    glEnableVertexAttribArray(INSTANCE_MVP_ATTRIBUTE + column);
+  }
+}
+
+// Point the bound VAO's instance attributes at the ring, starting from the
+// given instance.
+static void pointInstanceAttributes(const InstanceRing &ring,
+                                    size_t firstInstance) {
+  glBindBuffer(GL_ARRAY_BUFFER, ring.getBuffer());
+  size_t base = firstInstance * InstanceRing::STRIDE;
+  static constexpr size_t COLUMN_SIZE = 4 * sizeof(float);
+  for (unsigned column = 0; column < 4; column++) {
+    glVertexAttribPointer(INSTANCE_MVP_ATTRIBUTE + column, 4, GL_FLOAT,
+                          GL_FALSE, InstanceRing::STRIDE,
+                          (void *)(base + column * COLUMN_SIZE));
+  }
+}
+
+// Draw one command at a time, for when multi-draw-indirect isn't supported.
+static void drawCommand(GameContext &gameContext, GLenum indexType,
+                        const DrawCommand &command) {
+  size_t indexSize =
+      indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+  const void *indexOffset = (const void *)(command.firstIndex * indexSize);
+  if (GLEW_ARB_base_instance) {
+    // The attributes already point at the start of the ring (see
+    // renderScene).
+    glDrawElementsInstancedBaseVertexBaseInstance(
+        GL_TRIANGLES, command.indexCount, indexType, indexOffset,
+        command.instanceCount, command.baseVertex, command.baseInstance);
+  } else {
+    // Without base instances (macOS only has OpenGL 4.1), the attributes have
+    // to point at the first instance instead.
+    pointInstanceAttributes(gameContext.instanceRing, command.baseInstance);
+    gameContext.instanceRingGeneration = 0;
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.indexCount,
+                                      indexType, indexOffset,
+                                      command.instanceCount,
+                                      command.baseVertex);
+  }
+}
+
+// More error than this (in pixels) starts to be noticeable.
+static constexpr float LOD_MAX_ERROR_PIXELS = 1;
+// An object only moves to a simpler level once that level's error is this far
+// under the limit, so that it doesn't flick back and forth near the boundary.
+static constexpr float LOD_HYSTERESIS = 0.75f;
+
+// Pick the simplest level of detail whose error is small enough on screen,
+// starting from the one the object was drawn at last time.
+static uint8_t selectLod(const GameObjectGeometry &geometry, uint8_t current,
+                         float pixelsPerUnit) {
+  const auto &lods = geometry.lods;
+  size_t level = std::min<size_t>(current, lods.size() - 1);
+  while (level > 0 &&
+         lods[level].error * pixelsPerUnit > LOD_MAX_ERROR_PIXELS) {
+    level--;
+  }
+  while (level + 1 < lods.size() &&
+         lods[level + 1].error * pixelsPerUnit <=
+             LOD_MAX_ERROR_PIXELS * LOD_HYSTERESIS) {
+    level++;
+  }
+  return level;
+}
+
+void buildRenderQueue(GameContext &gameContext) {
+  // Work out which objects are on screen first, so that we only sort the ones
+  // we actually have to draw.
+  FrustumCuller &culler = gameContext.culler;
+  const std::vector<Eigen::Matrix4f> &renderMatrices =
+      *gameContext.renderMatrices;
+  {
+    Profiler::Scope scope(gameContext.profiler, "cull");
+    culler.clear();
+    for (const GameObjectState &state : gameContext.gameObjects) {
+      const Bounds &bounds = state.geometry->bounds;
+      const Eigen::Matrix4f &worldMatrix = renderMatrices[state.transformSlot];
+      // The scale is uniform, so the length of any column of the rotate/scale
+      // part is the scale.
+      culler.add((worldMatrix * bounds.sphereCenter.homogeneous()).head<3>(),
+                 bounds.sphereRadius * worldMatrix.col(0).head<3>().norm());
+    }
+    size_t visibleCount = culler.cull(
+        Frustum::fromMatrix(gameContext.projectionMatrix *
+                            gameContext.viewMatrix),
+        &gameContext.jobs);
+    gameContext.cullingStats = {visibleCount, culler.size() - visibleCount};
+  }
+
+  RenderQueue &renderQueue = gameContext.renderQueue;
+  renderQueue.clear();
+  float depthRange = gameContext.zFar - gameContext.zNear;
+  // Only the third row of the view matrix affects the depth.
+  Eigen::RowVector4f viewDepthRow = gameContext.viewMatrix.row(2);
+  size_t index = 0;
+  // How many pixels one unit covers at a view depth of 1.
+  float pixelsPerUnitAtDepth1 =
+      gameContext.projectionMatrix(1, 1) * gameContext.viewportHeight / 2;
+  for (GameObjectState &state : gameContext.gameObjects) {
+    if (!culler.isVisible(index++)) {
+      continue;
+    }
+    const GameObjectGeometry &geometry = *state.geometry;
+    const Eigen::Matrix4f &worldMatrix = renderMatrices[state.transformSlot];
+    float viewDepth = viewDepthRow * worldMatrix.col(3);
+    if (geometry.lods.size() > 1) {
+      float scale = worldMatrix.col(0).head<3>().norm();
+      state.lodLevel = selectLod(
+          geometry, state.lodLevel,
+          pixelsPerUnitAtDepth1 * scale /
+              std::max(viewDepth, gameContext.zNear));
+    }
+    float normalizedDepth = (viewDepth - gameContext.zNear) / depthRange;
+    renderQueue.push(RenderQueue::makeKey(geometry.transparent,
+                                          geometry.gpuTexture->id, geometry.id,
+                                          state.lodLevel, normalizedDepth),
+                     &state);
+  }
+  Profiler::Scope scope(gameContext.profiler, "sort");
+  renderQueue.sort();
+}
+
+void renderScene(GameContext &gameContext) {
+  {
+    Profiler::Scope scope(gameContext.profiler, "build render queue");
+    buildRenderQueue(gameContext);
+  }
+  const RenderQueue &renderQueue = gameContext.renderQueue;
+  InstanceRing &ring = gameContext.instanceRing;
+  {
+    // Every visible object's matrices go into the ring in render queue order,
+    // so each batch below is a contiguous run of instances.
+    Profiler::Scope scope(gameContext.profiler, "write instances");
+    InstanceData *instances = ring.beginFrame(renderQueue.size());
+    Eigen::Matrix4f viewProjection =
+        gameContext.projectionMatrix * gameContext.viewMatrix;
+    // The matrices are all worked out before rendering, so reading them from
+    // several threads is fine.
+    const std::vector<Eigen::Matrix4f> &renderMatrices =
+        *gameContext.renderMatrices;
+    static constexpr size_t MINIMUM_BATCH_SIZE = 4096;
+    gameContext.jobs.parallelFor(
+        renderQueue.size(), MINIMUM_BATCH_SIZE, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            instances[i].modelViewProjection =
+                viewProjection *
+                renderMatrices[renderQueue.begin()[i].object->transformSlot];
+          }
+        });
+    ring.finishWriting();
+  }
+
+  Profiler::Scope scope(gameContext.profiler, "submit");
+  GeometryArena &arena = gameContext.geometryArena;
+  arena.defragment();
+  // One command per run of objects with the same geometry (at the same level
+  // of detail). Runs which can be drawn with the same state are gathered into
+  // groups.
+  DrawCommandBuffer &commands = gameContext.drawCommands;
+  commands.clear();
+  auto iterator = renderQueue.begin();
+  auto end = renderQueue.end();
+  while (iterator != end) {
+    const GameObjectGeometry &geometry = *iterator->object->geometry;
+    uint8_t lodLevel = iterator->object->lodLevel;
+    size_t firstInstance =
+        ring.getBaseInstance() + (iterator - renderQueue.begin());
+    size_t instanceCount = 0;
+    while (iterator != end && iterator->object->geometry.get() == &geometry &&
+           iterator->object->lodLevel == lodLevel) {
+      instanceCount++;
+      ++iterator;
+    }
+    const GameObjectGeometry::LodLevel &lod = geometry.lods[lodLevel];
+    DrawCommand command;
+    command.indexCount = lod.indexCount;
+    command.instanceCount = instanceCount;
+    command.firstIndex =
+        arena.getFirstIndex(geometry.allocation, geometry.indexType) +
+        lod.firstIndex;
+    command.baseVertex = arena.getBaseVertex(geometry.allocation);
+    command.baseInstance = firstInstance;
+    commands.add({geometry.gpuTexture->id, geometry.indexType,
+                  geometry.transparent},
+                 command);
+  }
+
+  arena.bind();
+  if (GLEW_ARB_base_instance &&
+      gameContext.instanceRingGeneration != ring.getGeneration()) {
+    // The attributes always point at the start of the ring, and the base
+    // instance says where to start reading. They only have to be set again
+    // when the ring is replaced.
+    pointInstanceAttributes(ring, 0);
+    gameContext.instanceRingGeneration = ring.getGeneration();
+  }
+  // Multi-draw-indirect needs OpenGL 4.3, and base instances to find each
+  // command's instances.
+  bool multiDraw = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+  if (multiDraw) {
+    commands.upload();
+  }
+  unsigned boundTexture = 0;
+  bool depthWritesEnabled = true;
+  size_t drawCalls = 0;
+  for (const DrawGroup &group : commands.getGroups()) {
+    const DrawState &state = group.state;
+    if (state.transparent == depthWritesEnabled) {
+      // Transparent objects shouldn't hide the ones behind them, since they
+      // are drawn from back to front anyway.
+      depthWritesEnabled = !state.transparent;
+      glDepthMask(depthWritesEnabled ? GL_TRUE : GL_FALSE);
+    }
+    if (state.texture != boundTexture) {
+      glBindTexture(GL_TEXTURE_2D, state.texture);
+      boundTexture = state.texture;
+    }
+    if (multiDraw) {
+      glMultiDrawElementsIndirect(
+          GL_TRIANGLES, state.indexType,
+          (const void *)(group.firstCommand * sizeof(DrawCommand)),
+          group.commandCount, 0);
+      drawCalls++;
+      continue;
+    }
+    for (size_t i = 0; i < group.commandCount; i++) {
+      drawCommand(gameContext, state.indexType,
+                  commands.getCommands()[group.firstCommand + i]);
+    }
+    drawCalls += group.commandCount;
+  }
+  gameContext.drawCalls = drawCalls;
+  if (multiDraw) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  }
   glBindVertexArray(0);
+  glDepthMask(GL_TRUE);
+  ring.endFrame();
 }
 } // namespace seagull
@@ -1,9 +1,16 @@
 #include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <fstream>
 #include <gameObject_internal.h>
 #include <iostream>
 #include <mathHelper.h>
 #include <matrixHelper.h>
+#include <numeric>
+#include <offscreen.h>
+#include <profiler.h>
 #include <renderer.h>
 #include <seagull_internal.h>
 #include <stdexcept>
@@ -50,26 +57,487 @@ Game::~Game() {
   glfwSetErrorCallback(nullptr);
 }
 
-GameObject &Game::createGameObject(TexturedMesh mesh, bool addToScene) {
-  if (addToScene) {
-    gameContext->gameObjects.push_back(GameObject(std::move(mesh)));
-    return gameContext->gameObjects.back();
-  } else {
-    gameContext->templateGameObjects.push_back(GameObject(std::move(mesh)));
-    return gameContext->templateGameObjects.back();
+// Anything which uses OpenGL, or changes which game objects exist, has to run
+// on the render thread (and not in a tick or on a worker: see
+// runOnRenderThread).
+static void requireRenderThread(const GameContext &gameContext,
+                                const char *action) {
+  if (std::this_thread::get_id() != gameContext.renderThread) {
+    throw std::logic_error(std::string("Can't ") + action +
+                           " off the render thread (use runOnRenderThread)");
+  }
+}
+
+static GameObject createPreparedGameObject(GameContext &gameContext,
+                                           PreparedGeometry prepared,
+                                           bool addToScene) {
+  // We also have to build the texture (unless another object already uses the
+  // same image).
+  auto gpuTexture = getGpuTexture(gameContext, prepared.mesh.getSharedImage());
+  addVertexCacheStats(gameContext.vertexCacheStats, prepared.vertexCacheStats);
+  return addGameObject(gameContext,
+                       createGeometry(gameContext.geometryArena,
+                                      std::move(prepared),
+                                      std::move(gpuTexture),
+                                      gameContext.retainMeshData),
+                       addToScene);
+}
+
+GameObject Game::createGameObject(TexturedMesh mesh, bool addToScene) {
+  requireRenderThread(*gameContext, "create a game object");
+  return createPreparedGameObject(*gameContext,
+                                  prepareGeometry(std::move(mesh),
+                                                  gameContext->geometryOptions,
+                                                  &gameContext->jobs),
+                                  addToScene);
+}
+
+GameObject Game::createGameObject(IndexedMesh mesh, bool addToScene) {
+  requireRenderThread(*gameContext, "create a game object");
+  return createPreparedGameObject(
+      *gameContext,
+      prepareGeometry(std::move(mesh), gameContext->geometryOptions),
+      addToScene);
+}
+
+GameObject Game::duplicateGameObject(const GameObject &original) {
+  requireRenderThread(*gameContext, "duplicate a game object");
+  GameObjectState state = original.getState();
+  state.transformSlot = state.transforms->duplicate(state.transformSlot);
+  SlotMap<GameObjectState> &gameObjects = gameContext->gameObjects;
+  gameContext->sceneChanges++;
+  if (gameContext->simulation.isRunning()) {
+    gameContext->newTransformSlots.push_back(state.transformSlot);
   }
+  return GameObject(gameObjects, gameObjects.insert(std::move(state)));
+}
+
+bool Game::destroyGameObject(const GameObject &gameObject) {
+  requireRenderThread(*gameContext, "destroy a game object");
+  if (!gameObject.isValid()) {
+    return false;
+  }
+  GameObjectState &state = gameObject.getState();
+  state.transforms->release(state.transformSlot);
+  gameContext->sceneChanges++;
+  return gameObject.objects->erase(gameObject.handle);
+}
+
+void Game::setRetainMeshData(bool retain) {
+  gameContext->retainMeshData = retain;
+}
+
+void Game::setShaderCacheDirectory(const std::string &directory) {
+  gameContext->shaders.setCacheDirectory(directory);
+}
+
+void Game::setGenerateLods(bool generate) {
+  gameContext->geometryOptions.generateLods = generate;
 }
 
-GameObject &Game::duplicateGameObject(const GameObject &original) {
-  gameContext->gameObjects.push_back(GameObject(*original.state));
-  return gameContext->gameObjects.back();
+void Game::setOptimizeOverdraw(bool optimize) {
+  gameContext->geometryOptions.optimizeOverdraw = optimize;
 }
 
-void Game::addUpdateFunction(std::function<void()> updateFunction) {
+void Game::setRaycastable(bool raycastable) {
+  gameContext->geometryOptions.buildRaycastBvh = raycastable;
+}
+
+std::optional<RaycastHit> Game::raycast(const Ray &ray) {
+  return raycast(std::vector<Ray>{ray})[0];
+}
+
+std::vector<std::optional<RaycastHit>>
+Game::raycast(const std::vector<Ray> &rays) {
+  GameContext &context = *gameContext;
+  context.raycaster.update(context.gameObjects, context.sceneChanges,
+                           context.transforms.getChangeCount());
+  std::vector<std::optional<RaycastHit>> hits(rays.size());
+  auto castRay = [&](size_t i) {
+    const Ray &ray = rays[i];
+    Eigen::Vector3f direction(ray.direction.x, ray.direction.y,
+                              ray.direction.z);
+    float length = direction.norm();
+    if (!(length > 0)) {
+      return;
+    }
+    std::optional<SceneRaycaster::Hit> hit = context.raycaster.raycast(
+        Eigen::Vector3f(ray.origin.x, ray.origin.y, ray.origin.z),
+        direction / length, ray.maxDistance);
+    if (hit) {
+      hits[i] = RaycastHit{GameObject(context.gameObjects, hit->handle),
+                           hit->triangle, hit->distance};
+    }
+  };
+  // Below this, handing the rays out to the workers costs more than it saves.
+  static constexpr size_t PARALLEL_RAY_COUNT = 64;
+  if (rays.size() < PARALLEL_RAY_COUNT) {
+    for (size_t i = 0; i < rays.size(); i++) {
+      castRay(i);
+    }
+    return hits;
+  }
+  context.jobs.parallelFor(rays.size(), PARALLEL_RAY_COUNT,
+                           [&](size_t begin, size_t end) {
+                             for (size_t i = begin; i < end; i++) {
+                               castRay(i);
+                             }
+                           });
+  return hits;
+}
+
+TexturedMesh Game::readBackMesh(const GameObject &gameObject) const {
+  requireRenderThread(*gameContext, "read back a mesh");
+  return readBackGeometry(*gameObject.getState().geometry).toTexturedMesh();
+}
+
+UpdateFunctionId Game::addUpdateFunction(std::function<void()> updateFunction,
+                                         UpdateOptions options) {
+  UpdateFunctionId id = gameContext->updateFunctions.size();
+  for (UpdateFunctionId dependency : options.dependencies) {
+    if (dependency >= id) {
+      throw std::invalid_argument(
+          "Update functions can only depend on earlier ones");
+    }
+  }
   gameContext->updateFunctions.push_back(std::move(updateFunction));
+  gameContext->updateOptions.push_back(std::move(options));
+  return id;
+}
+
+void Game::parallelFor(size_t count, const std::function<void(size_t)> &body) {
+  gameContext->jobs.parallelFor(count, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      body(i);
+    }
+  });
+}
+
+void Game::runOnRenderThread(std::function<void()> function) {
+  std::lock_guard lock(gameContext->renderThreadFunctionsMutex);
+  gameContext->renderThreadFunctions.push_back(std::move(function));
+}
+
+void Game::setTickRate(double ticksPerSecond) {
+  if (!(ticksPerSecond >= 0)) {
+    throw std::invalid_argument("The tick rate can't be negative");
+  }
+  gameContext->tickInterval =
+      ticksPerSecond == 0
+          ? SimulationClock::duration::zero()
+          : std::chrono::duration_cast<SimulationClock::duration>(
+                std::chrono::duration<double>(1 / ticksPerSecond));
+}
+
+double Game::getTickRate() const {
+  if (gameContext->tickInterval == SimulationClock::duration::zero()) {
+    return 0;
+  }
+  return 1 / std::chrono::duration<double>(gameContext->tickInterval).count();
+}
+
+static void runUpdateFunctions(GameContext &gameContext) {
+  JobSystem &jobs = gameContext.jobs;
+  std::vector<JobHandle> &updateJobs = gameContext.updateJobs;
+  // Serial update functions have no job (they have already finished by the
+  // time anything could depend on them), so their entries stay null.
+  updateJobs.assign(gameContext.updateFunctions.size(), nullptr);
+  for (size_t i = 0; i < gameContext.updateFunctions.size(); i++) {
+    const UpdateOptions &options = gameContext.updateOptions[i];
+    std::vector<JobHandle> dependencies;
+    for (UpdateFunctionId dependency : options.dependencies) {
+      if (updateJobs[dependency]) {
+        dependencies.push_back(updateJobs[dependency]);
+      }
+    }
+    const std::function<void()> &updateFunction =
+        gameContext.updateFunctions[i];
+    if (options.parallelSafe) {
+      updateJobs[i] = jobs.submit(updateFunction, dependencies);
+    } else {
+      for (const JobHandle &dependency : dependencies) {
+        jobs.wait(dependency);
+      }
+      updateFunction();
+    }
+  }
+  for (const JobHandle &job : updateJobs) {
+    if (job) {
+      jobs.wait(job);
+    }
+  }
+}
+
+PendingGameObject
+Game::loadGameObject(std::function<TexturedMesh()> loadMesh, bool addToScene,
+                     std::function<void(GameObject &)> onLoaded) {
+  JobSystem *jobs = &gameContext->jobs;
+  GeometryOptions options = gameContext->geometryOptions;
+  return gameContext->assetLoader.load(
+      [loadMesh = std::move(loadMesh), options, jobs]() {
+        return prepareGeometry(loadMesh(), options, jobs);
+      },
+      addToScene, std::move(onLoaded));
+}
+
+PendingGameObject
+Game::loadGameObject(std::function<IndexedMesh()> loadMesh, bool addToScene,
+                     std::function<void(GameObject &)> onLoaded) {
+  GeometryOptions options = gameContext->geometryOptions;
+  return gameContext->assetLoader.load(
+      [loadMesh = std::move(loadMesh), options]() {
+        return prepareGeometry(loadMesh(), options);
+      },
+      addToScene, std::move(onLoaded));
+}
+
+size_t Game::getPendingLoadCount() const {
+  return gameContext->assetLoader.getPendingCount();
+}
+
+void Game::openAssetPack(const std::string &fileName) {
+  gameContext->assetPacks.push_back(std::make_unique<AssetPack>(fileName));
+}
+
+GameObject Game::createGameObjectFromPack(const std::string &meshName,
+                                          bool addToScene) {
+  requireRenderThread(*gameContext, "create a game object");
+  for (const auto &pack : gameContext->assetPacks) {
+    const PackedMesh *mesh = pack->findMesh(meshName);
+    if (!mesh) {
+      continue;
+    }
+    return addGameObject(*gameContext,
+                         getPackedGeometry(*gameContext, *pack, *mesh),
+                         addToScene);
+  }
+  throw std::runtime_error("No asset pack has a mesh called " + meshName);
+}
+
+TransformStats Game::getTransformStats() const {
+  const TransformStore &transforms = gameContext->transforms;
+  return {transforms.getChangeCount(), transforms.getRecomputationCount()};
+}
+
+CullingStats Game::getCullingStats() const {
+  return gameContext->cullingStats;
+}
+
+VertexCacheStats Game::getVertexCacheStats() const {
+  return gameContext->vertexCacheStats;
+}
+
+SimulationStats Game::getSimulationStats() const {
+  const SimulationThread &simulation = gameContext->simulation;
+  return {simulation.getTickCount(), simulation.getSkippedTickCount()};
+}
+
+GeometryBufferStats Game::getGeometryBufferStats() const {
+  GeometryBufferStats stats = gameContext->geometryArena.getStats();
+  stats.drawCalls = gameContext->drawCalls;
+  stats.drawCommands = gameContext->drawCommands.getCommands().size();
+  return stats;
+}
+
+FrameProfile Game::getFrameProfile() const {
+  return gameContext->profiler.getLatestFrame();
+}
+
+void Game::writeChromeTrace(const std::string &fileName) const {
+  std::ofstream stream(fileName);
+  if (!stream) {
+    throw std::runtime_error("Failed to open " + fileName);
+  }
+  gameContext->profiler.writeChromeTrace(stream);
+}
+
+static void setUpRendering(GameContext &gameContext, int width, int height) {
+  glViewport(0, 0, width, height);
+  gameContext.viewportHeight = height;
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnable(GL_DEPTH_TEST);
+
+  // This is only compiled the first time (and on later runs, probably not
+  // even then: see setShaderCacheDirectory).
+  Shaders &shaders = gameContext.shaders.use(ShaderVariant::INSTANCED);
+  shaders.setUniformInt(Uniform::TEXTURE_UNIT, 0);
+
+  static constexpr float fovRadians = toRadians(90);
+  static constexpr float zNear = 0.1f;
+  static constexpr float zFar = 100.0f;
+  float aspectRatio = (float)width / (float)height;
+  gameContext.zNear = zNear;
+  gameContext.zFar = zFar;
+  gameContext.projectionMatrix =
+      getPerspectiveProjectionMatrix(fovRadians, zNear, zFar, aspectRatio);
+
+  // TODO: add a camera and change this.
+  gameContext.viewMatrix = Eigen::Matrix4f::Identity();
+  // There are no view or projection uniforms: they are folded into each
+  // object's model-view-projection matrix when the frame is drawn.
+}
+
+// Run whatever runOnRenderThread has queued up.
+static void runRenderThreadFunctions(GameContext &gameContext) {
+  std::vector<std::function<void()>> functions;
+  {
+    std::lock_guard lock(gameContext.renderThreadFunctionsMutex);
+    functions.swap(gameContext.renderThreadFunctions);
+  }
+  for (const std::function<void()> &function : functions) {
+    function();
+  }
+}
+
+// If there is a tick rate, start running the update functions (and the
+// transform updates) in ticks on the simulation thread, rather than in each
+// frame.
+static void startSimulation(GameContext &gameContext) {
+  if (gameContext.tickInterval == SimulationClock::duration::zero()) {
+    return;
+  }
+  gameContext.transforms.update(&gameContext.jobs);
+  SimulationClock::time_point now = SimulationClock::now();
+  gameContext.transformSnapshots.reset(gameContext.transforms.worldMatrices,
+                                       now);
+  gameContext.newTransformSlots.clear();
+  gameContext.simulation.start(
+      gameContext.tickInterval, now + gameContext.tickInterval,
+      [&gameContext](SimulationClock::time_point time) {
+        runUpdateFunctions(gameContext);
+        gameContext.transforms.update(&gameContext.jobs);
+        gameContext.transformSnapshots.publish(
+            gameContext.transforms.worldMatrices, time);
+      });
+}
+
+// Stops the simulation thread however the game loop ends. If it ends
+// normally, stop it first to hear about anything a tick threw.
+struct SimulationGuard {
+  SimulationThread &simulation;
+  ~SimulationGuard() {
+    try {
+      simulation.stop();
+    } catch (...) {
+      // Something else has already gone wrong.
+    }
+  }
+};
+
+// The start of a frame while the simulation thread runs the update functions.
+static void interpolateFrame(GameContext &gameContext) {
+  Profiler &profiler = gameContext.profiler;
+  SimulationThread &simulation = gameContext.simulation;
+  if (simulation.hasFailed()) {
+    simulation.stop(); // Rethrows whatever the tick threw
+  }
+  {
+    // The scene can only be changed between ticks, so if one is running,
+    // this waits for the next frame.
+    Profiler::Scope scope(profiler, "asset loading");
+    std::unique_lock lock = simulation.tryLockScene();
+    if (lock.owns_lock()) {
+      runRenderThreadFunctions(gameContext);
+      gameContext.assetLoader.update(gameContext);
+      for (uint32_t slot : gameContext.newTransformSlots) {
+        gameContext.transformSnapshots.patch(
+            slot, gameContext.transforms.getWorldMatrix(slot));
+      }
+      gameContext.newTransformSlots.clear();
+    }
+  }
+  Profiler::Scope scope(profiler, "interpolate");
+  gameContext.transformSnapshots.interpolate(
+      SimulationClock::now(), gameContext.gameObjects,
+      gameContext.interpolatedMatrices, gameContext.jobs);
+  gameContext.renderMatrices = &gameContext.interpolatedMatrices;
+}
+
+// Everything in a frame apart from presenting it. The profiler's frame must
+// already have begun.
+static void runFrame(GameContext &gameContext) {
+  Profiler &profiler = gameContext.profiler;
+  {
+    Profiler::Scope scope(profiler, "poll events");
+    glfwPollEvents();
+  }
+  if (gameContext.simulation.isRunning()) {
+    interpolateFrame(gameContext);
+  } else {
+    {
+      // Anything which finished loading is added before the update functions
+      // run, so they see it straight away.
+      Profiler::Scope scope(profiler, "asset loading");
+      runRenderThreadFunctions(gameContext);
+      gameContext.assetLoader.update(gameContext);
+    }
+    {
+      Profiler::Scope scope(profiler, "update functions");
+      runUpdateFunctions(gameContext);
+    }
+    {
+      Profiler::Scope scope(profiler, "transforms");
+      gameContext.transforms.update(&gameContext.jobs);
+      gameContext.renderMatrices = &gameContext.transforms.worldMatrices;
+    }
+  }
+  Profiler::Scope scope(profiler, "render");
+  profiler.beginGpuTimer();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  renderScene(gameContext);
+  profiler.endGpuTimer();
+}
+
+static void writeTraceIfRequested(const GameContext &gameContext) {
+  if (const char *fileName = std::getenv("SEAGULL_TRACE_FILE")) {
+    std::ofstream stream(fileName);
+    gameContext.profiler.writeChromeTrace(stream);
+  }
+}
+
+static FrameTimeStats summarizeFrameTimes(std::vector<double> frameTimes) {
+  FrameTimeStats stats{frameTimes.size()};
+  if (frameTimes.empty()) {
+    return stats;
+  }
+  std::sort(frameTimes.begin(), frameTimes.end());
+  // Nearest-rank percentiles.
+  auto percentile = [&](double fraction) {
+    size_t rank = (size_t)std::ceil(fraction * frameTimes.size());
+    return frameTimes[std::clamp<size_t>(rank, 1, frameTimes.size()) - 1];
+  };
+  stats.mean = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) /
+               frameTimes.size();
+  stats.p50 = percentile(0.5);
+  stats.p95 = percentile(0.95);
+  stats.p99 = percentile(0.99);
+  stats.max = frameTimes.back();
+  return stats;
 }
 
 void Game::run(const std::string &title, int width, int height) {
+  if (const char *benchmarkFrames = std::getenv("SEAGULL_BENCHMARK_FRAMES")) {
+    if (width == 0 && height == 0) {
+      // There might not be a monitor to take the size from.
+      width = 1280;
+      height = 720;
+    }
+    FrameTimeStats stats =
+        benchmark(std::stoul(benchmarkFrames), width, height);
+    std::cout << "Benchmark (" << width << "x" << height << "): "
+              << stats.frames << " frames, mean " << stats.mean << " ms, p50 "
+              << stats.p50 << " ms, p95 " << stats.p95 << " ms, p99 "
+              << stats.p99 << " ms, max " << stats.max << " ms" << std::endl;
+    VertexCacheStats cacheStats = getVertexCacheStats();
+    std::cout << "Vertex cache: ACMR " << cacheStats.acmrBefore() << " -> "
+              << cacheStats.acmrAfter() << " over " << cacheStats.meshes
+              << " meshes (" << cacheStats.triangles << " triangles)"
+              << std::endl;
+    return;
+  }
+
   GLFWmonitor *primaryMonitor = glfwGetPrimaryMonitor();
   if (width == 0 && height == 0) {
     const GLFWvidmode *videoMode = glfwGetVideoMode(primaryMonitor);
@@ -88,43 +556,56 @@ void Game::run(const std::string &title, int width, int height) {
   glfwSwapInterval(1); // Vsync
   glfwShowWindow(window);
   glfwFocusWindow(window); // Not sure this is necessary, but it can't hurt.
-  glViewport(0, 0, width, height);
-
-  glEnable(GL_BLEND);
-  glEnable(GL_DEPTH_TEST);
-
-  std::unique_ptr<Shaders> &shaders = gameContext->shaders;
-  shaders = std::make_unique<Shaders>();
-  shaders->use();
-
-  unsigned modelUniform = shaders->getUniformLocation("model");
-  unsigned viewUniform = shaders->getUniformLocation("view");
-  unsigned projectionUniform = shaders->getUniformLocation("projection");
-
-  static constexpr float fovRadians = toRadians(90);
-  static constexpr float zNear = 0.1f;
-  static constexpr float zFar = 100.0f;
-  float aspectRatio = (float)width / (float)height;
-  auto projectionMatrix =
-      getPerspectiveProjectionMatrix(fovRadians, zNear, zFar, aspectRatio);
-  shaders->setUniformMatrix4(projectionUniform, projectionMatrix);
-
-  // TODO: add a camera and change this.
-  Eigen::Matrix4f viewMatrix = Eigen::Matrix4f::Identity();
-  shaders->setUniformMatrix4(viewUniform, viewMatrix);
+  setUpRendering(*gameContext, width, height);
 
+  Profiler &profiler = gameContext->profiler;
+  SimulationGuard simulationGuard{gameContext->simulation};
+  startSimulation(*gameContext);
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
-    for (const auto &updateFunction : gameContext->updateFunctions) {
-      updateFunction();
+    profiler.beginFrame();
+    runFrame(*gameContext);
+    {
+      Profiler::Scope scope(profiler, "swap");
+      glfwSwapBuffers(window);
     }
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    for (const auto &gameObject : gameContext->gameObjects) {
-      shaders->setUniformMatrix4(modelUniform,
-                                 gameObject.state->totalTransformationMatrix);
-      render(*gameObject.state, *gameContext, true);
+    profiler.endFrame();
+  }
+  gameContext->simulation.stop();
+  writeTraceIfRequested(*gameContext);
+}
+
+FrameTimeStats Game::benchmark(unsigned frameCount, int width, int height) {
+  if (width <= 0 || height <= 0) {
+    throw std::invalid_argument("The benchmark size must be positive");
+  }
+  // The window stays hidden, so nothing is ever presented. Vsync would only
+  // get in the way.
+  glfwSwapInterval(0);
+  OffscreenTarget target(width, height);
+  setUpRendering(*gameContext, width, height);
+
+  Profiler &profiler = gameContext->profiler;
+  std::vector<double> frameTimes;
+  frameTimes.reserve(frameCount);
+  SimulationGuard simulationGuard{gameContext->simulation};
+  startSimulation(*gameContext);
+  for (unsigned frame = 0; frame < frameCount; frame++) {
+    auto frameStart = std::chrono::steady_clock::now();
+    profiler.beginFrame();
+    runFrame(*gameContext);
+    {
+      // Without a swap to throttle us, the driver would happily queue up
+      // frames and we would only be measuring how fast we can submit them.
+      Profiler::Scope scope(profiler, "finish");
+      glFinish();
     }
-    glfwSwapBuffers(window);
+    profiler.endFrame();
+    frameTimes.push_back(std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - frameStart)
+                             .count());
   }
+  gameContext->simulation.stop();
+  writeTraceIfRequested(*gameContext);
+  return summarizeFrameTimes(std::move(frameTimes));
 }
 } // namespace seagull
@@ -1,7 +1,31 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <random>
+#include <seagull/assetPackFormat.h>
 #include <shaders.h>
+#include <vector>
 
 namespace seagull {
+// Indexed by Uniform.
+static constexpr const char *UNIFORM_NAMES[] = {"model", "view", "projection",
+                                                "textureUnit"};
+static_assert(std::size(UNIFORM_NAMES) == (size_t)Uniform::COUNT);
+
+static constexpr char PROGRAM_BINARY_MAGIC[8] = {'S', 'G', 'L', 'P',
+                                                 'R', 'O', 'G', '\0'};
+
+// At the start of every cached program binary.
+struct ProgramBinaryHeader {
+  char magic[8];
+  uint32_t format; // As given by glGetProgramBinary
+  uint32_t size;
+};
+
 void compileShader(const std::string &source, unsigned int shader) {
   const char *sourcePointer = source.c_str();
   glShaderSource(shader, 1, &sourcePointer, nullptr);
@@ -15,15 +39,19 @@ void compileShader(const std::string &source, unsigned int shader) {
   }
 }
 
-Shaders::Shaders(const std::string &vertexShaderSource,
-                 const std::string &fragmentShaderSource) {
-  shaderProgram = glCreateProgram();
-  vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+void Shaders::link(const std::string &vertexShaderSource,
+                   const std::string &fragmentShaderSource,
+                   bool retrievable) {
+  unsigned vertexShader = glCreateShader(GL_VERTEX_SHADER);
+  unsigned fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
   compileShader(vertexShaderSource, vertexShader);
   compileShader(fragmentShaderSource, fragmentShader);
   glAttachShader(shaderProgram, vertexShader);
   glAttachShader(shaderProgram, fragmentShader);
+  if (retrievable) {
+    glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
   glLinkProgram(shaderProgram);
   int success;
   glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
@@ -34,9 +62,125 @@ Shaders::Shaders(const std::string &vertexShaderSource,
   }
   // We don't need the individual shaders anymore since they are now linked into
   // the shader program.
+  glDetachShader(shaderProgram, vertexShader);
+  glDetachShader(shaderProgram, fragmentShader);
   glDeleteShader(vertexShader);
   glDeleteShader(fragmentShader);
 }
+
+bool Shaders::loadBinary(const std::string &fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::vector<char> bytes(std::istreambuf_iterator<char>(file), {});
+  ProgramBinaryHeader header;
+  if (bytes.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic, PROGRAM_BINARY_MAGIC,
+                  sizeof(PROGRAM_BINARY_MAGIC)) ||
+      header.size != bytes.size() - sizeof(header)) {
+    return false;
+  }
+  glProgramBinary(shaderProgram, header.format, bytes.data() + sizeof(header),
+                  header.size);
+  // The driver is free to reject binaries from other versions of itself,
+  // even though the driver string is part of the key.
+  int success;
+  glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+  return success;
+}
+
+void Shaders::saveBinary(const std::string &fileName) const {
+  int size = 0;
+  glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0) {
+    return;
+  }
+  std::vector<char> bytes(sizeof(ProgramBinaryHeader) + size);
+  ProgramBinaryHeader header{};
+  std::memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC));
+  GLenum format;
+  glGetProgramBinary(shaderProgram, size, &size, &format,
+                     bytes.data() + sizeof(header));
+  header.format = format;
+  header.size = size;
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  // Write to a temporary file first, so that another instance of the game
+  // never reads half a binary. Its name is random, so that instances saving
+  // at the same time don't write into the same one.
+  std::random_device random;
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+  std::string temporaryName = fileName + suffix;
+  std::error_code error;
+  bool written;
+  {
+    std::ofstream file(temporaryName, std::ios::binary);
+    file.write(bytes.data(), sizeof(header) + size);
+    written = (bool)file;
+  }
+  if (written) {
+    std::filesystem::rename(temporaryName, fileName, error);
+  }
+  if (!written || error) {
+    std::filesystem::remove(temporaryName, error);
+  }
+}
+
+// Identifies the driver, since binaries only work with the one which made
+// them.
+static std::string getDriverString() {
+  std::string driver;
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    if (const GLubyte *value = glGetString(name)) {
+      driver += (const char *)value;
+    }
+    driver += '\n';
+  }
+  return driver;
+}
+
+Shaders::Shaders(const std::string &vertexShaderSource,
+                 const std::string &fragmentShaderSource,
+                 const std::string &cacheDirectory) {
+  shaderProgram = glCreateProgram();
+  // Some drivers (notably macOS's) support the extension without supporting
+  // any binary formats.
+  int binaryFormatCount = 0;
+  if (GLEW_ARB_get_program_binary) {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+  }
+  std::string cacheFile;
+  if (!cacheDirectory.empty() && binaryFormatCount > 0) {
+    std::string driver = getDriverString();
+    uint64_t hash = hashAssetSource(driver.data(), driver.size());
+    hash = hashAssetSource(vertexShaderSource.data(),
+                           vertexShaderSource.size(), hash);
+    // The separator stops the sources running into each other.
+    hash = hashAssetSource("\0", 1, hash);
+    hash = hashAssetSource(fragmentShaderSource.data(),
+                           fragmentShaderSource.size(), hash);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin",
+                  (unsigned long long)hash);
+    cacheFile = (std::filesystem::path(cacheDirectory) / name).string();
+    fromCache = loadBinary(cacheFile);
+  }
+  if (!fromCache) {
+    link(vertexShaderSource, fragmentShaderSource, !cacheFile.empty());
+    if (!cacheFile.empty()) {
+      std::error_code error;
+      std::filesystem::create_directories(cacheDirectory, error);
+      saveBinary(cacheFile);
+    }
+  }
+  for (size_t i = 0; i < uniformLocations.size(); i++) {
+    uniformLocations[i] = glGetUniformLocation(shaderProgram, UNIFORM_NAMES[i]);
+  }
+}
 static const char *defaultVertexShader = R"(
 #version 330 core
 layout (location = 0) in vec3 position;
@@ -54,6 +198,24 @@ void main() {
 }
 )";
 
+// This is the same as the default vertex shader, except that the matrices come
+// from the instance ring so that many objects can be drawn at once. The
+// model-view-projection matrix is worked out once per object on the CPU, rather
+// than once per vertex here.
+static const char *instancedVertexShader = R"(
+#version 330 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 inTextureCoordinate;
+layout (location = 2) in mat4 modelViewProjection;
+
+out vec2 textureCoordinate;
+
+void main() {
+  gl_Position = modelViewProjection * vec4(position, 1.0f);
+  textureCoordinate = inTextureCoordinate;
+}
+)";
+
 static const char *defaultFragmentShader = R"(
 #version 330 core
 out vec4 color;
@@ -67,10 +229,54 @@ void main() {
 }
 )";
 
-Shaders::Shaders() : Shaders(defaultVertexShader, defaultFragmentShader) {}
+Shaders::Shaders(ShaderVariant variant, const std::string &cacheDirectory)
+    : Shaders(variant == ShaderVariant::INSTANCED ? instancedVertexShader
+                                                  : defaultVertexShader,
+              defaultFragmentShader, cacheDirectory) {}
 
 Shaders::~Shaders() {
   glUseProgram(0);
   glDeleteProgram(shaderProgram);
 }
+
+// Where the user's own caches go (or an empty path if we can't tell). Nobody
+// else can write there, unlike the temporary directory, so nobody else can
+// plant a program binary for us to load.
+static std::filesystem::path getUserCacheDirectory() {
+#ifdef _WIN32
+  if (const char *localAppData = std::getenv("LOCALAPPDATA")) {
+    return localAppData;
+  }
+#else
+  const char *cacheHome = std::getenv("XDG_CACHE_HOME");
+  // The spec says to ignore relative paths.
+  if (cacheHome && cacheHome[0] == '/') {
+    return cacheHome;
+  }
+  const char *home = std::getenv("HOME");
+  if (home && home[0]) {
+#ifdef __APPLE__
+    return std::filesystem::path(home) / "Library" / "Caches";
+#else
+    return std::filesystem::path(home) / ".cache";
+#endif
+  }
+#endif
+  return {};
+}
+
+ShaderManager::ShaderManager() {
+  std::filesystem::path userCache = getUserCacheDirectory();
+  if (!userCache.empty()) {
+    cacheDirectory = (userCache / "seagull" / "shaders").string();
+  }
+}
+
+Shaders &ShaderManager::get(ShaderVariant variant) {
+  std::unique_ptr<Shaders> &program = programs[(size_t)variant];
+  if (!program) {
+    program = std::make_unique<Shaders>(variant, cacheDirectory);
+  }
+  return *program;
+}
 } // namespace seagull
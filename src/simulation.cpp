@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cassert>
+#include <gameObject_internal.h>
+#include <simulation.h>
+#include <slotMap.h>
+
+namespace seagull {
+void TransformSnapshots::reset(const std::vector<Eigen::Matrix4f> &matrices,
+                               SimulationClock::time_point time) {
+  std::lock_guard lock(mutex);
+  snapshots[previous] = {matrices, time};
+  snapshots[current] = {matrices, time};
+}
+
+void TransformSnapshots::publish(const std::vector<Eigen::Matrix4f> &matrices,
+                                 SimulationClock::time_point time) {
+  {
+    // A frame which started two ticks ago might still be reading the spare.
+    std::unique_lock lock(mutex);
+    readingFinished.wait(lock, [this]() { return !reading[spare]; });
+  }
+  // Only the simulation thread touches the spare, and the render thread won't
+  // start reading it until it is swapped in, so this copy doesn't need the
+  // lock (and the spare's storage is reused from tick to tick).
+  snapshots[spare].matrices.assign(matrices.begin(), matrices.end());
+  snapshots[spare].time = time;
+  std::lock_guard lock(mutex);
+  std::swap(previous, spare);
+  std::swap(previous, current);
+}
+
+void TransformSnapshots::patch(uint32_t slot, const Eigen::Matrix4f &matrix) {
+  std::lock_guard lock(mutex);
+  for (size_t index : {previous, current}) {
+    std::vector<Eigen::Matrix4f> &matrices = snapshots[index].matrices;
+    if (slot >= matrices.size()) {
+      matrices.resize(slot + 1, Eigen::Matrix4f::Identity());
+    }
+    matrices[slot] = matrix;
+  }
+}
+
+// Interpolate between two affine matrices with uniform scales.
+static Eigen::Matrix4f interpolateMatrix(const Eigen::Matrix4f &from,
+                                         const Eigen::Matrix4f &to,
+                                         float t) {
+  float fromScale = from.col(0).head<3>().norm();
+  float toScale = to.col(0).head<3>().norm();
+  if (fromScale == 0 || toScale == 0) {
+    return from + (to - from) * t; // There's no rotation to speak of.
+  }
+  Eigen::Quaternionf fromRotation(
+      Eigen::Matrix3f(from.topLeftCorner<3, 3>() / fromScale));
+  Eigen::Quaternionf toRotation(
+      Eigen::Matrix3f(to.topLeftCorner<3, 3>() / toScale));
+  Eigen::Matrix4f result = Eigen::Matrix4f::Identity();
+  result.topLeftCorner<3, 3>() =
+      fromRotation.slerp(t, toRotation).toRotationMatrix() *
+      (fromScale + (toScale - fromScale) * t);
+  result.topRightCorner<3, 1>() =
+      from.topRightCorner<3, 1>() +
+      (to.topRightCorner<3, 1>() - from.topRightCorner<3, 1>()) * t;
+  return result;
+}
+
+void TransformSnapshots::interpolate(
+    SimulationClock::time_point time,
+    const SlotMap<GameObjectState> &gameObjects,
+    std::vector<Eigen::Matrix4f> &matrices, JobSystem &jobs) {
+  size_t fromIndex, toIndex;
+  {
+    std::lock_guard lock(mutex);
+    fromIndex = previous;
+    toIndex = current;
+    reading[fromIndex] = reading[toIndex] = true;
+  }
+  // Neither of these is written to until they are released, so they can be
+  // read without the lock.
+  struct ReadingGuard {
+    TransformSnapshots &snapshots;
+    size_t fromIndex, toIndex;
+
+    ~ReadingGuard() {
+      {
+        std::lock_guard lock(snapshots.mutex);
+        snapshots.reading[fromIndex] = snapshots.reading[toIndex] = false;
+      }
+      snapshots.readingFinished.notify_one();
+    }
+  } guard{*this, fromIndex, toIndex};
+  const Snapshot &from = snapshots[fromIndex];
+  const Snapshot &to = snapshots[toIndex];
+  float t = 1;
+  if (to.time > from.time) {
+    t = std::chrono::duration<float>(time - to.time) /
+        std::chrono::duration<float>(to.time - from.time);
+    t = std::clamp(t, 0.0f, 1.0f);
+  }
+  matrices.resize(to.matrices.size());
+  static constexpr size_t MINIMUM_BATCH_SIZE = 1024;
+  jobs.parallelFor(
+      gameObjects.size(), MINIMUM_BATCH_SIZE, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          uint32_t slot = gameObjects.begin()[i].transformSlot;
+          // Every game object is in the snapshots (see patch).
+          assert(slot < to.matrices.size());
+          // Most objects don't move.
+          if (slot >= from.matrices.size() ||
+              from.matrices[slot] == to.matrices[slot]) {
+            matrices[slot] = to.matrices[slot];
+          } else {
+            matrices[slot] =
+                interpolateMatrix(from.matrices[slot], to.matrices[slot], t);
+          }
+        }
+      });
+}
+
+void SimulationThread::start(SimulationClock::duration interval,
+                             SimulationClock::time_point firstTick,
+                             Tick tick) {
+  stopping = false;
+  failed = false;
+  thread = std::thread([this, interval, firstTick, tick = std::move(tick)]() {
+    loop(interval, firstTick, tick);
+  });
+}
+
+void SimulationThread::loop(SimulationClock::duration interval,
+                            SimulationClock::time_point firstTick,
+                            const Tick &tick) {
+  SimulationClock::time_point nextTick = firstTick;
+  while (true) {
+    {
+      std::unique_lock lock(stopMutex);
+      if (stopCondition.wait_until(lock, nextTick,
+                                   [this]() { return stopping; })) {
+        return;
+      }
+    }
+    try {
+      std::lock_guard lock(sceneMutex);
+      tick(nextTick);
+    } catch (...) {
+      error = std::current_exception();
+      failed = true;
+      return;
+    }
+    tickCount++;
+    nextTick += interval;
+    // If a tick took far too long, catching up would only make the next ones
+    // late too.
+    SimulationClock::time_point now = SimulationClock::now();
+    if (now - nextTick > interval * MAX_TICKS_BEHIND) {
+      uint64_t behind = (now - nextTick) / interval;
+      skippedTickCount += behind;
+      nextTick += interval * behind;
+    }
+  }
+}
+
+SimulationThread::~SimulationThread() {
+  try {
+    stop();
+  } catch (...) {
+    // Nobody is left to hear about it.
+  }
+}
+
+void SimulationThread::stop() {
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard lock(stopMutex);
+    stopping = true;
+  }
+  stopCondition.notify_all();
+  thread.join();
+  if (error) {
+    std::exception_ptr thrown = std::move(error);
+    error = nullptr;
+    std::rethrow_exception(thrown);
+  }
+}
+} // namespace seagull
@@ -1,22 +1,262 @@
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <lodepng.h>
+#include <seagull/assetPackFormat.h>
+#include <seagull/compressedTextureFormat.h>
 #include <seagull/texture.h>
+#include <stdexcept>
 
 namespace seagull {
-Image loadPngImage(const std::string &fileName) {
-  std::vector<unsigned char> image;
+static Color8 expand565(uint16_t color) {
+  // Copying the top bits into the bottom ones maps the ends of the range to 0
+  // and 255 exactly.
+  uint8_t r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+  return {(uint8_t)(r << 3 | r >> 2), (uint8_t)(g << 2 | g >> 4),
+          (uint8_t)(b << 3 | b >> 2), 255};
+}
+
+// The colour half of a block: two 5:6:5 endpoints, then a 2-bit index per
+// pixel choosing between them and the colours in between.
+static void decodeColorBlock(const unsigned char *block, bool isBc1,
+                             Color8 (&pixels)[16]) {
+  uint16_t color0 = block[0] | block[1] << 8;
+  uint16_t color1 = block[2] | block[3] << 8;
+  Color8 palette[4] = {expand565(color0), expand565(color1)};
+  auto mix = [&](int weight0, int weight1) {
+    int total = weight0 + weight1;
+    Color8 a = palette[0], b = palette[1];
+    return Color8{(uint8_t)((a.r * weight0 + b.r * weight1) / total),
+                  (uint8_t)((a.g * weight0 + b.g * weight1) / total),
+                  (uint8_t)((a.b * weight0 + b.b * weight1) / total), 255};
+  };
+  // BC1 has a second mode (chosen by the order of the endpoints) with only
+  // one colour in between, and transparent black. BC3 doesn't.
+  if (!isBc1 || color0 > color1) {
+    palette[2] = mix(2, 1);
+    palette[3] = mix(1, 2);
+  } else {
+    palette[2] = mix(1, 1);
+    palette[3] = {0, 0, 0, 0};
+  }
+  uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 |
+                     (uint32_t)block[7] << 24;
+  for (int i = 0; i < 16; i++) {
+    pixels[i] = palette[(indices >> (i * 2)) & 3];
+  }
+}
+
+// The alpha half of a BC3 block: two 8-bit endpoints, then a 3-bit index per
+// pixel.
+static void decodeAlphaBlock(const unsigned char *block,
+                             Color8 (&pixels)[16]) {
+  int alpha0 = block[0], alpha1 = block[1];
+  uint8_t palette[8] = {(uint8_t)alpha0, (uint8_t)alpha1};
+  if (alpha0 > alpha1) {
+    for (int i = 1; i < 7; i++) {
+      palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+    }
+  } else {
+    for (int i = 1; i < 5; i++) {
+      palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++) {
+    indices |= (uint64_t)block[2 + i] << (i * 8);
+  }
+  for (int i = 0; i < 16; i++) {
+    pixels[i].a = palette[(indices >> (i * 3)) & 7];
+  }
+}
+
+static void decodeBlock(PixelFormat format, const unsigned char *block,
+                        Color8 (&pixels)[16]) {
+  if (format == PixelFormat::BC1) {
+    decodeColorBlock(block, true, pixels);
+  } else {
+    decodeColorBlock(block + 8, false, pixels);
+    decodeAlphaBlock(block, pixels);
+  }
+}
+
+Image::Image(size_t width, size_t height, const std::vector<Color8> &pixels)
+    : width(width), height(height), format(PixelFormat::RGBA8),
+      data(pixels.size() * sizeof(Color8)) {
+  static_assert(sizeof(Color8) == 4, "Color8 must be 4 packed bytes");
+  std::memcpy(data.data(), pixels.data(), data.size());
+}
+
+Image::Image(size_t width, size_t height, const std::vector<Color> &pixels)
+    : width(width), height(height), format(PixelFormat::RGBA_FLOAT),
+      data(pixels.size() * sizeof(Color)) {
+  static_assert(sizeof(Color) == 4 * sizeof(float),
+                "Color struct must be 4 packed floats");
+  std::memcpy(data.data(), pixels.data(), data.size());
+}
+
+Color Image::getPixel(size_t index) const {
+  if (isCompressed()) {
+    size_t x = index % width, y = index / width;
+    size_t block = y / 4 * ((width + 3) / 4) + x / 4;
+    Color8 pixels[16];
+    decodeBlock(format, &data[block * getBytesPerBlock(format)], pixels);
+    Color8 pixel = pixels[y % 4 * 4 + x % 4];
+    return Color(pixel.r / 255.0f, pixel.g / 255.0f, pixel.b / 255.0f,
+                 pixel.a / 255.0f);
+  }
+  if (format == PixelFormat::RGBA8) {
+    const unsigned char *pixel = &data[index * sizeof(Color8)];
+    return Color(pixel[0] / 255.0f, pixel[1] / 255.0f, pixel[2] / 255.0f,
+                 pixel[3] / 255.0f);
+  } else {
+    Color pixel;
+    std::memcpy(&pixel, &data[index * sizeof(Color)], sizeof(Color));
+    return pixel;
+  }
+}
+
+bool Image::hasTransparency() const {
+  if (format == PixelFormat::RGBA8) {
+    // Every fourth byte is the alpha channel.
+    for (size_t i = 3; i < data.size(); i += 4) {
+      if (data[i] != 255) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if (isCompressed()) {
+    return compressedTransparency;
+  }
+  for (size_t i = 0; i < getPixelCount(); i++) {
+    if (getPixel(i).a < 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Image loadPngImage(const std::string &fileName, PixelFormat format) {
+  // LodePNG gives us 8 bits per channel RGBA, which is exactly the RGBA8
+  // layout, so it can decode straight into the image.
+  Image image;
   unsigned width, height;
-  unsigned error = lodepng::decode(image, width, height, fileName);
+  unsigned error = lodepng::decode(image.data, width, height, fileName);
   if (error) {
     throw std::runtime_error("Error loading PNG image: " + fileName);
   }
-  // Our image expects colors, which are composed of floats from 0-1.
-  // LodePNG returns colors as bytes from 0-255.
-  std::vector<Color> pixels;
-  for (size_t i = 0; i < image.size(); i += 4) {
-    pixels.push_back(Color(image[i] / 255.0f, image[i + 1] / 255.0f,
-                           image[i + 2] / 255.0f, image[i + 3] / 255.0f));
+  image.width = width;
+  image.height = height;
+  if (format == PixelFormat::RGBA_FLOAT) {
+    // Colors are composed of floats from 0-1, whereas LodePNG returns colors as
+    // bytes from 0-255.
+    std::vector<Color> pixels(image.getPixelCount());
+    for (size_t i = 0; i < pixels.size(); i++) {
+      pixels[i] = image.getPixel(i);
+    }
+    return Image(width, height, pixels);
+  }
+  return image;
+}
+
+Image loadCompressedImage(const std::string &fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Error loading compressed image: " + fileName);
+  }
+  std::vector<unsigned char> bytes(std::istreambuf_iterator<char>(file), {});
+  auto fail = [&](const std::string &reason) {
+    throw std::runtime_error("Invalid compressed image " + fileName + ": " +
+                             reason);
+  };
+  CompressedTextureHeader header;
+  if (bytes.size() < sizeof(header)) {
+    fail("too small");
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic, COMPRESSED_TEXTURE_MAGIC,
+                  sizeof(COMPRESSED_TEXTURE_MAGIC))) {
+    fail("not a compressed texture");
+  }
+  if (header.version != COMPRESSED_TEXTURE_VERSION) {
+    fail("version " + std::to_string(header.version) + " (expected " +
+         std::to_string(COMPRESSED_TEXTURE_VERSION) + ")");
+  }
+  if (header.format != COMPRESSED_TEXTURE_BC1 &&
+      header.format != COMPRESSED_TEXTURE_BC3) {
+    fail("unknown format " + std::to_string(header.format));
+  }
+  size_t expectedSize = 0;
+  for (unsigned level = 0; level < header.mipLevelCount; level++) {
+    expectedSize += getCompressedLevelSize(
+        header.format, getMipLevelSize(header.width, level),
+        getMipLevelSize(header.height, level));
+  }
+  if (header.width == 0 || header.height == 0 || header.mipLevelCount == 0 ||
+      header.mipLevelCount > 32 ||
+      bytes.size() - sizeof(header) != expectedSize) {
+    fail("bad size");
+  }
+  bytes.erase(bytes.begin(), bytes.begin() + sizeof(header));
+  return Image(header.width, header.height,
+               header.format == COMPRESSED_TEXTURE_BC1 ? PixelFormat::BC1
+                                                       : PixelFormat::BC3,
+               header.mipLevelCount, std::move(bytes), header.transparent);
+}
+
+Image decompressImage(const Image &image) {
+  if (!image.isCompressed()) {
+    return image;
+  }
+  std::vector<Color8> pixels(image.getPixelCount());
+  size_t blocksWide = (image.width + 3) / 4;
+  size_t blocksHigh = (image.height + 3) / 4;
+  size_t blockSize = Image::getBytesPerBlock(image.format);
+  for (size_t blockY = 0; blockY < blocksHigh; blockY++) {
+    for (size_t blockX = 0; blockX < blocksWide; blockX++) {
+      Color8 block[16];
+      decodeBlock(image.format,
+                  &image.data[(blockY * blocksWide + blockX) * blockSize],
+                  block);
+      // The padding in partial blocks is dropped.
+      for (size_t y = 0; y < 4 && blockY * 4 + y < image.height; y++) {
+        for (size_t x = 0; x < 4 && blockX * 4 + x < image.width; x++) {
+          pixels[(blockY * 4 + y) * image.width + blockX * 4 + x] =
+              block[y * 4 + x];
+        }
+      }
+    }
+  }
+  return Image(image.width, image.height, pixels);
+}
+
+Image downsampleImage(const Image &image) {
+  if (image.format != PixelFormat::RGBA8) {
+    throw std::invalid_argument("Only RGBA8 images can be downsampled");
+  }
+  size_t width = image.width, height = image.height;
+  size_t nextWidth = std::max<size_t>(1, width / 2);
+  size_t nextHeight = std::max<size_t>(1, height / 2);
+  std::vector<unsigned char> result(nextWidth * nextHeight * 4);
+  for (size_t y = 0; y < nextHeight; y++) {
+    for (size_t x = 0; x < nextWidth; x++) {
+      for (size_t channel = 0; channel < 4; channel++) {
+        unsigned total = 0;
+        for (size_t dy = 0; dy < 2; dy++) {
+          for (size_t dx = 0; dx < 2; dx++) {
+            size_t sourceX = std::min(width - 1, x * 2 + dx);
+            size_t sourceY = std::min(height - 1, y * 2 + dy);
+            total += image.data[(sourceY * width + sourceX) * 4 + channel];
+          }
+        }
+        result[(y * nextWidth + x) * 4 + channel] = (total + 2) / 4;
+      }
+    }
   }
-  return Image{std::move(pixels), width, height};
+  return Image(nextWidth, nextHeight, std::move(result));
 }
 } // namespace seagull
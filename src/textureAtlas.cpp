@@ -0,0 +1,61 @@
+#include <cassert>
+#include <seagull/textureAtlas.h>
+
+namespace seagull {
+size_t TextureAtlas::addImage(Image image) {
+  assert(!atlasImage && "Images must be added before the atlas is built");
+  if (image.isCompressed()) {
+    image = decompressImage(image);
+  }
+  if (image.format != PixelFormat::RGBA8) {
+    // The atlas is always RGBA8, so convert anything else.
+    std::vector<Color8> pixels(image.getPixelCount());
+    for (size_t i = 0; i < pixels.size(); i++) {
+      Color color = image.getPixel(i);
+      pixels[i] = {(uint8_t)(color.r * 255.0f + 0.5f),
+                   (uint8_t)(color.g * 255.0f + 0.5f),
+                   (uint8_t)(color.b * 255.0f + 0.5f),
+                   (uint8_t)(color.a * 255.0f + 0.5f)};
+    }
+    image = Image(image.width, image.height, pixels);
+  }
+  images.push_back(std::move(image));
+  return images.size() - 1;
+}
+
+void TextureAtlas::build() {
+  std::vector<AtlasSize> sizes;
+  sizes.reserve(images.size());
+  for (const Image &image : images) {
+    sizes.push_back({image.width, image.height});
+  }
+  layout = packAtlas(sizes, padding);
+  Image atlas(layout.width, layout.height,
+              std::vector<unsigned char>(layout.width * layout.height *
+                                         sizeof(Color8)));
+  for (size_t i = 0; i < images.size(); i++) {
+    blitIntoAtlas(atlas.data.data(), atlas.width, images[i].data.data(),
+                  layout.rects[i], padding);
+  }
+  atlasImage = std::make_shared<const Image>(std::move(atlas));
+  images.clear();
+}
+
+Point2d TextureAtlas::mapCoordinate(size_t entry, Point2d coordinate) const {
+  const AtlasRect &rect = layout.rects[entry];
+  return {(rect.x + coordinate.x * rect.width) / layout.width,
+          (rect.y + coordinate.y * rect.height) / layout.height};
+}
+
+Texture TextureAtlas::remapTexture(const Texture &texture,
+                                   size_t entry) const {
+  assert(atlasImage && "The atlas must be built before it can be used");
+  Texture result(atlasImage);
+  for (const Triangle2d &triangle : texture) {
+    result.addTriangle({mapCoordinate(entry, triangle.a),
+                        mapCoordinate(entry, triangle.b),
+                        mapCoordinate(entry, triangle.c)});
+  }
+  return result;
+}
+} // namespace seagull
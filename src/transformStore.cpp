@@ -0,0 +1,209 @@
+#include <cmath>
+#include <transformStore.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SEAGULL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace seagull {
+uint32_t TransformStore::allocate() {
+  if (!freeSlots.empty()) {
+    uint32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    translateX[slot] = translateY[slot] = translateZ[slot] = 0;
+    rotateX[slot] = rotateY[slot] = rotateZ[slot] = 0;
+    scale[slot] = 1;
+    worldMatrices[slot] = Eigen::Matrix4f::Identity();
+    dirty[slot] = false;
+    return slot;
+  }
+  uint32_t slot = size();
+  translateX.push_back(0);
+  translateY.push_back(0);
+  translateZ.push_back(0);
+  rotateX.push_back(0);
+  rotateY.push_back(0);
+  rotateZ.push_back(0);
+  scale.push_back(1);
+  worldMatrices.push_back(Eigen::Matrix4f::Identity());
+  dirty.push_back(false);
+  return slot;
+}
+
+uint32_t TransformStore::duplicate(uint32_t original) {
+  uint32_t slot = allocate();
+  translateX[slot] = translateX[original];
+  translateY[slot] = translateY[original];
+  translateZ[slot] = translateZ[original];
+  rotateX[slot] = rotateX[original];
+  rotateY[slot] = rotateY[original];
+  rotateZ[slot] = rotateZ[original];
+  scale[slot] = scale[original];
+  worldMatrices[slot] = worldMatrices[original];
+  dirty[slot] = dirty[original];
+  return slot;
+}
+
+void TransformStore::release(uint32_t slot) {
+  // There's no point working out a world matrix nobody will look at.
+  dirty[slot] = false;
+  freeSlots.push_back(slot);
+}
+
+// The world matrix is translate * rotate * scale. This is the same rotation
+// matrix as getRotateMatrix, but we only work out each sin and cos once. Since
+// the scale is uniform, it just multiplies the rotation part.
+void TransformStore::composeSlot(uint32_t slot) {
+  recomputationCount.fetch_add(1, std::memory_order_relaxed);
+  float sx = std::sin(rotateX[slot]), cx = std::cos(rotateX[slot]);
+  float sy = std::sin(rotateY[slot]), cy = std::cos(rotateY[slot]);
+  float sz = std::sin(rotateZ[slot]), cz = std::cos(rotateZ[slot]);
+  float s = scale[slot];
+  float sxsy = sx * sy, cxsy = cx * sy;
+  Eigen::Matrix4f &matrix = worldMatrices[slot];
+  matrix(0, 0) = s * cy * cz;
+  matrix(0, 1) = s * cy * sz;
+  matrix(0, 2) = s * -sy;
+  matrix(0, 3) = translateX[slot];
+  matrix(1, 0) = s * (sxsy * cz - cx * sz);
+  matrix(1, 1) = s * (sxsy * sz + cx * cz);
+  matrix(1, 2) = s * sx * cy;
+  matrix(1, 3) = translateY[slot];
+  matrix(2, 0) = s * (cxsy * cz + sx * sz);
+  matrix(2, 1) = s * (cxsy * sz - sx * cz);
+  matrix(2, 2) = s * cx * cy;
+  matrix(2, 3) = translateZ[slot];
+  matrix.row(3) << 0, 0, 0, 1;
+}
+
+#ifdef SEAGULL_SSE2
+// Works out the sin and cos of four floats at once. This is the Cephes
+// single-precision algorithm: reduce the angle to [-pi/4, pi/4] and then use
+// whichever of the sin and cos polynomials is appropriate for the octant.
+static inline void sinCos4(__m128 x, __m128 &sinOut, __m128 &cosOut) {
+  const __m128 signMask = _mm_set1_ps(-0.0f);
+  __m128 sinSign = _mm_and_ps(x, signMask);
+  x = _mm_andnot_ps(signMask, x);
+
+  // j is the octant, rounded up to an even number.
+  __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+  j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+  __m128 y = _mm_cvtepi32_ps(j);
+
+  __m128i sinSwap = _mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29);
+  __m128i cosSwap = _mm_slli_epi32(
+      _mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)),
+      29);
+  __m128 usePolynomialAsIs = _mm_castsi128_ps(_mm_cmpeq_epi32(
+      _mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+  sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(sinSwap));
+  __m128 cosSign = _mm_castsi128_ps(cosSwap);
+
+  // Subtract y * pi/4 in three parts to keep the precision.
+  x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+  __m128 z = _mm_mul_ps(x, x);
+
+  __m128 cosPolynomial = _mm_set1_ps(2.443315711809948e-5f);
+  cosPolynomial = _mm_add_ps(_mm_mul_ps(cosPolynomial, z),
+                             _mm_set1_ps(-1.388731625493765e-3f));
+  cosPolynomial = _mm_add_ps(_mm_mul_ps(cosPolynomial, z),
+                             _mm_set1_ps(4.166664568298827e-2f));
+  cosPolynomial = _mm_mul_ps(_mm_mul_ps(cosPolynomial, z), z);
+  cosPolynomial = _mm_sub_ps(cosPolynomial, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+  cosPolynomial = _mm_add_ps(cosPolynomial, _mm_set1_ps(1.0f));
+
+  __m128 sinPolynomial = _mm_set1_ps(-1.9515295891e-4f);
+  sinPolynomial = _mm_add_ps(_mm_mul_ps(sinPolynomial, z),
+                             _mm_set1_ps(8.3321608736e-3f));
+  sinPolynomial = _mm_add_ps(_mm_mul_ps(sinPolynomial, z),
+                             _mm_set1_ps(-1.6666654611e-1f));
+  sinPolynomial = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPolynomial, z), x), x);
+
+  __m128 sinResult =
+      _mm_or_ps(_mm_and_ps(usePolynomialAsIs, sinPolynomial),
+                _mm_andnot_ps(usePolynomialAsIs, cosPolynomial));
+  __m128 cosResult =
+      _mm_or_ps(_mm_and_ps(usePolynomialAsIs, cosPolynomial),
+                _mm_andnot_ps(usePolynomialAsIs, sinPolynomial));
+  sinOut = _mm_xor_ps(sinResult, sinSign);
+  cosOut = _mm_xor_ps(cosResult, cosSign);
+}
+#endif
+
+void TransformStore::composeSlots(const uint32_t *dirtySlots,
+                                  size_t dirtyCount) {
+  size_t i = 0;
+#ifdef SEAGULL_SSE2
+  // Compose four matrices at a time, with one object in each lane.
+  for (; i + 4 <= dirtyCount; i += 4) {
+    const uint32_t *slots = &dirtySlots[i];
+    recomputationCount.fetch_add(4, std::memory_order_relaxed);
+    auto gather = [slots](const std::vector<float> &column) {
+      return _mm_setr_ps(column[slots[0]], column[slots[1]], column[slots[2]],
+                         column[slots[3]]);
+    };
+    __m128 sx, cx, sy, cy, sz, cz;
+    sinCos4(gather(rotateX), sx, cx);
+    sinCos4(gather(rotateY), sy, cy);
+    sinCos4(gather(rotateZ), sz, cz);
+    __m128 s = gather(scale);
+    __m128 sxsy = _mm_mul_ps(sx, sy), cxsy = _mm_mul_ps(cx, sy);
+    // The columns of the rotate/scale part, each one laid out as three rows
+    // plus the zero at the bottom.
+    __m128 columns[4][4] = {
+        {_mm_mul_ps(s, _mm_mul_ps(cy, cz)),
+         _mm_mul_ps(s, _mm_sub_ps(_mm_mul_ps(sxsy, cz), _mm_mul_ps(cx, sz))),
+         _mm_mul_ps(s, _mm_add_ps(_mm_mul_ps(cxsy, cz), _mm_mul_ps(sx, sz))),
+         _mm_setzero_ps()},
+        {_mm_mul_ps(s, _mm_mul_ps(cy, sz)),
+         _mm_mul_ps(s, _mm_add_ps(_mm_mul_ps(sxsy, sz), _mm_mul_ps(cx, cz))),
+         _mm_mul_ps(s, _mm_sub_ps(_mm_mul_ps(cxsy, sz), _mm_mul_ps(sx, cz))),
+         _mm_setzero_ps()},
+        {_mm_mul_ps(s, _mm_sub_ps(_mm_setzero_ps(), sy)),
+         _mm_mul_ps(s, _mm_mul_ps(sx, cy)), _mm_mul_ps(s, _mm_mul_ps(cx, cy)),
+         _mm_setzero_ps()},
+        {gather(translateX), gather(translateY), gather(translateZ),
+         _mm_set1_ps(1)},
+    };
+    // Each lane belongs to a different object, so we transpose to get one
+    // object's column in each register before writing it out.
+    for (unsigned column = 0; column < 4; column++) {
+      auto &rows = columns[column];
+      _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+      for (unsigned lane = 0; lane < 4; lane++) {
+        _mm_storeu_ps(worldMatrices[slots[lane]].data() + column * 4,
+                      rows[lane]);
+      }
+    }
+  }
+#endif
+  for (; i < dirtyCount; i++) {
+    composeSlot(dirtySlots[i]);
+  }
+}
+
+void TransformStore::update(JobSystem *jobs) {
+  // Scanning a byte per slot is cheap, and means marking a slot as dirty never
+  // has to touch anything shared.
+  dirtySlots.clear();
+  for (uint32_t slot = 0; slot < dirty.size(); slot++) {
+    if (dirty[slot]) {
+      dirtySlots.push_back(slot);
+      dirty[slot] = false;
+    }
+  }
+  // Every slot is written by exactly one batch, so they can run in parallel.
+  static constexpr size_t MINIMUM_BATCH_SIZE = 4096;
+  if (jobs) {
+    jobs->parallelFor(dirtySlots.size(), MINIMUM_BATCH_SIZE,
+                      [this](size_t begin, size_t end) {
+                        composeSlots(&dirtySlots[begin], end - begin);
+                      });
+  } else {
+    composeSlots(dirtySlots.data(), dirtySlots.size());
+  }
+}
+} // namespace seagull
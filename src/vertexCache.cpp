@@ -0,0 +1,313 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vertexCache.h>
+
+namespace seagull {
+// The size of the least recently used cache which the optimiser models. This
+// is bigger than most real caches, which Forsyth found works well for all of
+// them.
+static constexpr size_t OPTIMIZED_CACHE_SIZE = 32;
+// Scoring constants from Forsyth's article.
+static constexpr float CACHE_DECAY_POWER = 1.5f;
+static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+// The size of the first-in first-out cache which misses are counted on.
+static constexpr uint32_t SIMULATED_CACHE_SIZE = 16;
+// A cluster is cut short once its average cache miss ratio so far is at most
+// this much worse than the whole cluster's. Bigger values give more, smaller
+// clusters (so less overdraw, but more cache misses).
+static constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+static constexpr uint32_t NO_TRIANGLE = UINT32_MAX;
+
+static float getVertexScore(int cachePosition, uint32_t remainingTriangles) {
+  if (remainingTriangles == 0) {
+    return -1; // Nothing left to draw with it
+  }
+  float score = 0;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      // It was used by the last triangle. This is deliberately not the
+      // highest score, so we don't keep drawing thin strips.
+      score = LAST_TRIANGLE_SCORE;
+    } else {
+      float scale = 1.0f / (OPTIMIZED_CACHE_SIZE - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+    }
+  }
+  // Favour vertices with few triangles left, so that lone triangles don't get
+  // left behind to be drawn with a cold cache later.
+  return score + VALENCE_BOOST_SCALE *
+                     std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount,
+                         std::vector<size_t> *clusterStarts) {
+  if (indices.size() % 3 != 0) {
+    throw std::invalid_argument("Every triangle must have 3 indices");
+  }
+  size_t triangleCount = indices.size() / 3;
+  if (clusterStarts) {
+    clusterStarts->clear();
+  }
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // The triangles around each vertex, packed one vertex after the other.
+  // Drawn triangles are swapped to the end of their vertex's range, past
+  // remainingTriangles.
+  std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+  for (uint32_t index : indices) {
+    remainingTriangles[index]++;
+  }
+  std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+  std::inclusive_scan(remainingTriangles.begin(), remainingTriangles.end(),
+                      firstTriangle.begin() + 1);
+  std::vector<uint32_t> vertexTriangles(indices.size());
+  {
+    std::vector<uint32_t> filled(firstTriangle.begin(), firstTriangle.end());
+    for (size_t i = 0; i < indices.size(); i++) {
+      vertexTriangles[filled[indices[i]]++] = i / 3;
+    }
+  }
+
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+    vertexScores[vertex] = getVertexScore(-1, remainingTriangles[vertex]);
+  }
+  auto getTriangleScore = [&](uint32_t triangle) {
+    const uint32_t *corners = &indices[triangle * 3];
+    return vertexScores[corners[0]] + vertexScores[corners[1]] +
+           vertexScores[corners[2]];
+  };
+  std::vector<uint8_t> drawn(triangleCount, 0);
+  uint32_t bestTriangle = 0;
+  float bestScore = getTriangleScore(0);
+  for (size_t triangle = 1; triangle < triangleCount; triangle++) {
+    float score = getTriangleScore(triangle);
+    if (score > bestScore) {
+      bestTriangle = triangle;
+      bestScore = score;
+    }
+  }
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  std::vector<uint32_t> cache, nextCache;
+  cache.reserve(OPTIMIZED_CACHE_SIZE + 3);
+  nextCache.reserve(OPTIMIZED_CACHE_SIZE + 3);
+  // Triangles before this have all been drawn. It's only used when the cache
+  // has nothing left to offer, and only ever moves forwards.
+  size_t nextUndrawn = 0;
+  if (clusterStarts) {
+    clusterStarts->push_back(0);
+  }
+  for (size_t drawnCount = 0; drawnCount < triangleCount; drawnCount++) {
+    if (bestTriangle == NO_TRIANGLE) {
+      // None of the cached vertices have any triangles left, so start again
+      // somewhere else.
+      while (drawn[nextUndrawn]) {
+        nextUndrawn++;
+      }
+      bestTriangle = nextUndrawn;
+      if (clusterStarts) {
+        clusterStarts->push_back(drawnCount);
+      }
+    }
+    const uint32_t *corners = &indices[bestTriangle * 3];
+    output.insert(output.end(), corners, corners + 3);
+    drawn[bestTriangle] = 1;
+
+    // Take the triangle off its vertices' lists, and move them to the front of
+    // the cache.
+    nextCache.clear();
+    for (int i = 0; i < 3; i++) {
+      uint32_t vertex = corners[i];
+      uint32_t *triangles = &vertexTriangles[firstTriangle[vertex]];
+      uint32_t &remaining = remainingTriangles[vertex];
+      uint32_t *found = std::find(triangles, triangles + remaining,
+                                  bestTriangle);
+      std::swap(*found, triangles[remaining - 1]);
+      remaining--;
+      nextCache.push_back(vertex);
+    }
+    for (uint32_t vertex : cache) {
+      if (vertex != corners[0] && vertex != corners[1] &&
+          vertex != corners[2]) {
+        nextCache.push_back(vertex);
+      }
+    }
+    std::swap(cache, nextCache);
+
+    // Only the vertices which were in the cache (and so their triangles) have
+    // changed score. The next triangle is the best of those.
+    for (size_t i = 0; i < cache.size(); i++) {
+      uint32_t vertex = cache[i];
+      int position = i < OPTIMIZED_CACHE_SIZE ? (int)i : -1;
+      vertexScores[vertex] =
+          getVertexScore(position, remainingTriangles[vertex]);
+    }
+    bestTriangle = NO_TRIANGLE;
+    for (uint32_t vertex : cache) {
+      const uint32_t *triangles = &vertexTriangles[firstTriangle[vertex]];
+      for (uint32_t i = 0; i < remainingTriangles[vertex]; i++) {
+        uint32_t triangle = triangles[i];
+        float score = getTriangleScore(triangle);
+        if (bestTriangle == NO_TRIANGLE || score > bestScore) {
+          bestTriangle = triangle;
+          bestScore = score;
+        }
+      }
+    }
+    if (cache.size() > OPTIMIZED_CACHE_SIZE) {
+      cache.resize(OPTIMIZED_CACHE_SIZE);
+    }
+  }
+  indices = std::move(output);
+}
+
+namespace {
+// A first-in first-out cache, using timestamps so that resetting it is free.
+class CacheSimulator {
+private:
+  std::vector<uint32_t> timestamps;
+  uint32_t now = SIMULATED_CACHE_SIZE + 1;
+
+public:
+  CacheSimulator(size_t vertexCount) : timestamps(vertexCount, 0) {}
+
+  // Whether the vertex had to be transformed (that is, it missed).
+  bool access(uint32_t vertex) {
+    if (now - timestamps[vertex] > SIMULATED_CACHE_SIZE) {
+      timestamps[vertex] = now++;
+      return true;
+    }
+    return false;
+  }
+
+  void reset() { now += SIMULATED_CACHE_SIZE + 1; }
+};
+} // namespace
+
+uint64_t countVertexCacheMisses(const std::vector<uint32_t> &indices,
+                                size_t vertexCount) {
+  CacheSimulator cache(vertexCount);
+  uint64_t misses = 0;
+  for (uint32_t index : indices) {
+    misses += cache.access(index);
+  }
+  return misses;
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+                      const std::vector<float> &positions,
+                      const std::vector<size_t> &clusterStarts) {
+  if (indices.size() % 3 != 0) {
+    throw std::invalid_argument("Every triangle must have 3 indices");
+  }
+  size_t triangleCount = indices.size() / 3;
+  size_t vertexCount = positions.size() / 3;
+  // The clusters from the cache optimiser are often few and large (a closed
+  // mesh can be one cluster), so split them further wherever the cache is
+  // doing nearly as well as it does over the whole cluster. Starting a new
+  // cluster there costs a few misses.
+  std::vector<size_t> starts;
+  CacheSimulator cache(vertexCount);
+  for (size_t cluster = 0; cluster < clusterStarts.size(); cluster++) {
+    size_t begin = clusterStarts[cluster];
+    size_t end = cluster + 1 < clusterStarts.size()
+                     ? clusterStarts[cluster + 1]
+                     : triangleCount;
+    cache.reset();
+    size_t clusterMisses = 0;
+    for (size_t i = begin * 3; i < end * 3; i++) {
+      clusterMisses += cache.access(indices[i]);
+    }
+    float clusterRatio = (float)clusterMisses / (end - begin);
+
+    cache.reset();
+    starts.push_back(begin);
+    size_t misses = 0, start = begin;
+    for (size_t triangle = begin; triangle < end; triangle++) {
+      for (int i = 0; i < 3; i++) {
+        misses += cache.access(indices[triangle * 3 + i]);
+      }
+      float ratio = (float)misses / (triangle + 1 - start);
+      if (triangle + 1 < end && ratio <= clusterRatio * OVERDRAW_THRESHOLD) {
+        starts.push_back(triangle + 1);
+        cache.reset();
+        misses = 0;
+        start = triangle + 1;
+      }
+    }
+  }
+  if (starts.size() < 2) {
+    return;
+  }
+
+  // Work out which way each cluster faces, relative to the middle of the mesh.
+  auto getPosition = [&](uint32_t vertex) {
+    return Eigen::Vector3f(&positions[vertex * 3]);
+  };
+  struct Cluster {
+    size_t begin, end;
+    Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+    Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+    float sortKey;
+  };
+  std::vector<Cluster> clusters;
+  clusters.reserve(starts.size());
+  Eigen::Vector3f meshCentroid = Eigen::Vector3f::Zero();
+  float meshArea = 0;
+  for (size_t i = 0; i < starts.size(); i++) {
+    Cluster &cluster = clusters.emplace_back();
+    cluster.begin = starts[i];
+    cluster.end = i + 1 < starts.size() ? starts[i + 1] : triangleCount;
+    float area = 0;
+    for (size_t triangle = cluster.begin; triangle < cluster.end;
+         triangle++) {
+      Eigen::Vector3f a = getPosition(indices[triangle * 3]);
+      Eigen::Vector3f b = getPosition(indices[triangle * 3 + 1]);
+      Eigen::Vector3f c = getPosition(indices[triangle * 3 + 2]);
+      // Twice the area, pointing along the normal.
+      Eigen::Vector3f cross = (b - a).cross(c - a);
+      float triangleArea = cross.norm();
+      cluster.centroid += (a + b + c) / 3 * triangleArea;
+      cluster.normal += cross;
+      area += triangleArea;
+    }
+    meshCentroid += cluster.centroid;
+    meshArea += area;
+    if (area > 0) {
+      cluster.centroid /= area;
+    }
+    if (cluster.normal.squaredNorm() > 0) {
+      cluster.normal.normalize();
+    }
+  }
+  if (meshArea > 0) {
+    meshCentroid /= meshArea;
+  }
+  for (Cluster &cluster : clusters) {
+    cluster.sortKey = (cluster.centroid - meshCentroid).dot(cluster.normal);
+  }
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster &a, const Cluster &b) {
+                     return a.sortKey > b.sortKey;
+                   });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (const Cluster &cluster : clusters) {
+    output.insert(output.end(), indices.begin() + cluster.begin * 3,
+                  indices.begin() + cluster.end * 3);
+  }
+  indices = std::move(output);
+}
+} // namespace seagull
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vertexIndexer.h>
+
+namespace seagull {
+// Meshes smaller than this aren't worth splitting up.
+static constexpr size_t MIN_TRIANGLES_PER_THREAD = 16384;
+
+namespace {
+struct VertexKey {
+  uint32_t bits[5];
+
+  bool operator==(const VertexKey &other) const {
+    return std::equal(std::begin(bits), std::end(bits),
+                      std::begin(other.bits));
+  }
+};
+
+struct VertexKeyHash {
+  size_t operator()(const VertexKey &key) const {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (uint32_t word : key.bits) {
+      hash ^= word;
+      hash *= 0x9e3779b97f4a7c15;
+      hash ^= hash >> 29;
+    }
+    return hash;
+  }
+};
+
+struct UniqueVertex {
+  Point3d position;
+  Point2d textureCoordinate;
+  VertexKey key;
+  // The old linear search compared the floats with ==, which means NaNs never
+  // matched anything. We keep that behaviour by never welding them.
+  bool weldable;
+};
+
+// The result of indexing a contiguous range of triangles. The indices refer to
+// uniqueVertices, not to the final vertex buffer.
+struct PartialIndex {
+  std::vector<UniqueVertex> uniqueVertices;
+  std::vector<unsigned> indices;
+};
+} // namespace
+
+static uint32_t keyBits(float value) {
+  // Adding zero turns -0 into +0, since they compare equal but have different
+  // bit patterns.
+  return std::bit_cast<uint32_t>(value + 0.0f);
+}
+
+static UniqueVertex makeVertex(const Point3d &position,
+                               const Point2d &textureCoordinate) {
+  UniqueVertex vertex{position, textureCoordinate};
+  vertex.key = {keyBits(position.x), keyBits(position.y), keyBits(position.z),
+                keyBits(textureCoordinate.x), keyBits(textureCoordinate.y)};
+  vertex.weldable = !std::isnan(position.x) && !std::isnan(position.y) &&
+                    !std::isnan(position.z) &&
+                    !std::isnan(textureCoordinate.x) &&
+                    !std::isnan(textureCoordinate.y);
+  return vertex;
+}
+
+static PartialIndex indexRange(const Mesh &mesh, const Texture &texture,
+                               size_t begin, size_t end) {
+  PartialIndex result;
+  result.indices.reserve((end - begin) * 3);
+  std::unordered_map<VertexKey, unsigned, VertexKeyHash> knownVertices;
+  knownVertices.reserve(end - begin);
+  for (size_t i = begin; i < end; i++) {
+    const Triangle3d &meshTriangle = mesh[i];
+    const Triangle2d &textureTriangle = texture[i];
+    const Point3d meshPoints[3] = {meshTriangle.a, meshTriangle.b,
+                                   meshTriangle.c};
+    const Point2d texturePoints[3] = {textureTriangle.a, textureTriangle.b,
+                                      textureTriangle.c};
+    for (size_t pointIndex = 0; pointIndex < 3; pointIndex++) {
+      UniqueVertex vertex =
+          makeVertex(meshPoints[pointIndex], texturePoints[pointIndex]);
+      unsigned newIndex = result.uniqueVertices.size();
+      if (vertex.weldable) {
+        auto [existing, inserted] =
+            knownVertices.try_emplace(vertex.key, newIndex);
+        if (!inserted) {
+          result.indices.push_back(existing->second);
+          continue;
+        }
+      }
+      result.indices.push_back(newIndex);
+      result.uniqueVertices.push_back(vertex);
+    }
+  }
+  return result;
+}
+
+// The asset packer indexes its meshes with this (see
+// ASSET_PACK_MESHER_VERSION).
+IndexedVertices indexVertices(const Mesh &mesh, const Texture &texture,
+                              JobSystem *jobs) {
+  assert(mesh.size() == texture.size());
+  size_t triangleCount = mesh.size();
+  size_t threadCount =
+      jobs ? std::clamp<size_t>(triangleCount / MIN_TRIANGLES_PER_THREAD, 1,
+                                jobs->getWorkerCount() + 1)
+           : 1;
+  std::vector<PartialIndex> partials(threadCount);
+  if (threadCount == 1) {
+    partials[0] = indexRange(mesh, texture, 0, triangleCount);
+  } else {
+    size_t trianglesPerThread =
+        (triangleCount + threadCount - 1) / threadCount;
+    jobs->parallelFor(threadCount, 1, [&](size_t first, size_t last) {
+      for (size_t i = first; i < last; i++) {
+        size_t begin = std::min(triangleCount, i * trianglesPerThread);
+        size_t end = std::min(triangleCount, begin + trianglesPerThread);
+        partials[i] = indexRange(mesh, texture, begin, end);
+      }
+    });
+  }
+
+  // Merging the partial results in order means each vertex ends up where it
+  // first appears in the mesh, which is exactly where the old linear search
+  // would have put it.
+  IndexedVertices result;
+  result.indices.reserve(triangleCount * 3);
+  std::unordered_map<VertexKey, unsigned, VertexKeyHash> knownVertices;
+  if (threadCount > 1) {
+    knownVertices.reserve(triangleCount);
+  }
+  std::vector<unsigned> remap;
+  for (const PartialIndex &partial : partials) {
+    remap.clear();
+    remap.reserve(partial.uniqueVertices.size());
+    for (const UniqueVertex &vertex : partial.uniqueVertices) {
+      unsigned newIndex = result.vertexCount();
+      if (threadCount > 1 && vertex.weldable) {
+        auto [existing, inserted] =
+            knownVertices.try_emplace(vertex.key, newIndex);
+        if (!inserted) {
+          remap.push_back(existing->second);
+          continue;
+        }
+      }
+      remap.push_back(newIndex);
+      result.vertices.push_back(vertex.position.x);
+      result.vertices.push_back(vertex.position.y);
+      result.vertices.push_back(vertex.position.z);
+      result.textureCoordinates.push_back(vertex.textureCoordinate.x);
+      result.textureCoordinates.push_back(vertex.textureCoordinate.y);
+    }
+    for (unsigned index : partial.indices) {
+      result.indices.push_back(remap[index]);
+    }
+  }
+  return result;
+}
+} // namespace seagull
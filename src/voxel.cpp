@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cmath>
+#include <cubeHelper.h>
+#include <seagull/textureAtlas.h>
+#include <seagull/voxel.h>
+
+namespace seagull {
+VoxelGrid::VoxelGrid(unsigned width, unsigned height, unsigned depth)
+    : width(width), height(height), depth(depth),
+      words(((size_t)width * height * depth + 63) / 64) {}
+
+void VoxelGrid::setChunk(unsigned x, unsigned y, unsigned z,
+                         const VoxelChunk &chunk) {
+  static constexpr unsigned SIZE = VoxelChunk::SIZE;
+  for (unsigned j = 0; j < SIZE && y + j < height; j++) {
+    for (unsigned k = 0; k < SIZE && z + k < depth; k++) {
+      for (unsigned i = 0; i < SIZE && x + i < width; i++) {
+        setSolid(x + i, y + j, z + k, chunk.isSolid(i, j, k));
+      }
+    }
+  }
+}
+
+std::optional<VoxelHit> VoxelGrid::raycast(const Ray &ray) const {
+  float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+  float size[3] = {(float)width, (float)height, (float)depth};
+  float length = std::sqrt(direction[0] * direction[0] +
+                           direction[1] * direction[1] +
+                           direction[2] * direction[2]);
+  if (!(length > 0)) {
+    return std::nullopt;
+  }
+  // Clip the ray to the grid's box, so that the traversal never wanders
+  // outside it.
+  float enter = 0, exit = ray.maxDistance;
+  for (int axis = 0; axis < 3; axis++) {
+    float d = direction[axis] / length;
+    if (d == 0) {
+      if (origin[axis] < 0 || origin[axis] > size[axis]) {
+        return std::nullopt;
+      }
+      continue;
+    }
+    float t0 = -origin[axis] / d, t1 = (size[axis] - origin[axis]) / d;
+    enter = std::max(enter, std::min(t0, t1));
+    exit = std::min(exit, std::max(t0, t1));
+  }
+  if (enter > exit) {
+    return std::nullopt;
+  }
+  // Start just outside the grid rather than right on its edge, so that the
+  // first block inside is entered through the right face.
+  float start = std::max(enter - 1, 0.0f);
+  Ray clipped{{origin[0] + direction[0] / length * start,
+               origin[1] + direction[1] / length * start,
+               origin[2] + direction[2] / length * start},
+              ray.direction, exit - start};
+  std::optional<VoxelHit> hit = raycastVoxels(
+      clipped, [this](int x, int y, int z) { return isSolid(x, y, z); });
+  if (hit) {
+    hit->distance += start;
+  }
+  return hit;
+}
+
+BlockId BlockPalette::addBlockType(CubeTextureType textureType,
+                                   TextureRegion imageRegion) {
+  std::array<TextureRegion, CUBE_FACE_COUNT> regions;
+  for (unsigned face = 0; face < CUBE_FACE_COUNT; face++) {
+    regions[face] =
+        getCubeFaceRegion(textureType, (CubeFace)face, imageRegion);
+  }
+  faceRegions.push_back(regions);
+  return faceRegions.size() - 1;
+}
+
+BlockId BlockPalette::addBlockType(CubeTextureType textureType,
+                                   const TextureAtlas &atlas,
+                                   size_t atlasEntry) {
+  return addBlockType(textureType, {atlas.mapCoordinate(atlasEntry, {0, 0}),
+                                    atlas.mapCoordinate(atlasEntry, {1, 1})});
+}
+
+// Whether the block next to the given one (in the direction of the face) is
+// solid, looking into the neighbouring chunk if necessary.
+static bool isNeighbourSolid(const VoxelChunk &chunk,
+                             const ChunkNeighbours &neighbours, CubeFace face,
+                             const unsigned position[3]) {
+  static constexpr unsigned SIZE = VoxelChunk::SIZE;
+  const CubeFaceFrame &frame = getCubeFaceFrame(face);
+  unsigned neighbour[3] = {position[0], position[1], position[2]};
+  unsigned &axis = neighbour[frame.normalAxis];
+  const VoxelChunk *neighbourChunk = &chunk;
+  if (frame.normalPositive) {
+    if (axis == SIZE - 1) {
+      neighbourChunk = neighbours[(unsigned)face];
+      axis = 0;
+    } else {
+      axis++;
+    }
+  } else {
+    if (axis == 0) {
+      neighbourChunk = neighbours[(unsigned)face];
+      axis = SIZE - 1;
+    } else {
+      axis--;
+    }
+  }
+  return neighbourChunk &&
+         neighbourChunk->isSolid(neighbour[0], neighbour[1], neighbour[2]);
+}
+
+IndexedMesh meshChunk(const VoxelChunk &chunk, const BlockPalette &palette,
+                      const ChunkNeighbours &neighbours,
+                      const ChunkFaces &faces) {
+  static constexpr unsigned SIZE = VoxelChunk::SIZE;
+  // The quads never share corners (neighbouring ones have different texture
+  // coordinates), but each quad's two triangles do, so writing them out
+  // indexed saves a third of the vertices and the welding.
+  IndexedMesh mesh(palette.getImage());
+  // For each slice of the chunk, this holds the block whose face is visible at
+  // each position (or air if there isn't one), indexed by [v][u].
+  std::array<BlockId, SIZE * SIZE> mask;
+  for (unsigned faceNumber = 0; faceNumber < CUBE_FACE_COUNT; faceNumber++) {
+    if (!faces[faceNumber]) {
+      continue;
+    }
+    CubeFace face = (CubeFace)faceNumber;
+    const CubeFaceFrame &frame = getCubeFaceFrame(face);
+    for (unsigned slice = 0; slice < SIZE; slice++) {
+      unsigned position[3];
+      position[frame.normalAxis] = slice;
+      for (unsigned v = 0; v < SIZE; v++) {
+        position[frame.vAxis] = v;
+        for (unsigned u = 0; u < SIZE; u++) {
+          position[frame.uAxis] = u;
+          BlockId block = chunk.get(position[0], position[1], position[2]);
+          if (block != AIR &&
+              isNeighbourSolid(chunk, neighbours, face, position)) {
+            block = AIR; // The face is hidden.
+          }
+          mask[v * SIZE + u] = block;
+        }
+      }
+      // Now merge the visible faces into rectangles, growing each one along u
+      // as far as possible and then along v.
+      for (unsigned v = 0; v < SIZE; v++) {
+        for (unsigned u = 0; u < SIZE; u++) {
+          BlockId block = mask[v * SIZE + u];
+          if (block == AIR) {
+            continue;
+          }
+          const TextureRegion &region = palette.getFaceRegion(block, face);
+          bool canGrowU = region.min.x == 0 && region.max.x == 1;
+          bool canGrowV = region.min.y == 0 && region.max.y == 1;
+          unsigned width = 1;
+          while (canGrowU && u + width < SIZE &&
+                 mask[v * SIZE + u + width] == block) {
+            width++;
+          }
+          unsigned height = 1;
+          while (canGrowV && v + height < SIZE) {
+            bool rowMatches = true;
+            for (unsigned i = 0; i < width; i++) {
+              if (mask[(v + height) * SIZE + u + i] != block) {
+                rowMatches = false;
+                break;
+              }
+            }
+            if (!rowMatches) {
+              break;
+            }
+            height++;
+          }
+          for (unsigned j = 0; j < height; j++) {
+            for (unsigned i = 0; i < width; i++) {
+              mask[(v + j) * SIZE + u + i] = AIR;
+            }
+          }
+          position[frame.uAxis] = u;
+          position[frame.vAxis] = v;
+          addCubeFaceQuad(mesh, face, position, width, height, region,
+                          {0, 0, 0}, 1);
+        }
+      }
+    }
+  }
+  return mesh;
+}
+} // namespace seagull
@@ -0,0 +1,345 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <lodepng.h>
+#include <seagull/assetPackFormat.h>
+#include <seagull/cube.h>
+#include <seagull/texture.h>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vertexIndexer.h>
+
+// Builds an asset pack from a manifest, which has one asset per line:
+//
+//   texture <name> <png file>
+//   cube <name> <texture name> <sides|tbs|net>
+//
+// Lines starting with # are ignored. If the output file is already an asset
+// pack, any entry whose sources haven't changed (according to its content
+// hash) is copied across rather than rebuilt.
+
+using namespace seagull;
+
+// An entry, along with the data it points to (the offsets are filled in once
+// everything has been built).
+struct TextureEntry {
+  PackedTexture header;
+  std::vector<unsigned char> data;
+};
+struct MeshEntry {
+  PackedMesh header;
+  std::vector<float> vertices;
+  std::vector<uint32_t> indices;
+};
+
+struct OldPack {
+  std::vector<unsigned char> bytes;
+  std::unordered_map<std::string, const PackedTexture *> textures;
+  std::unordered_map<std::string, const PackedMesh *> meshes;
+};
+
+static bool fitsIn(uint64_t offset, uint64_t size, size_t fileSize) {
+  return offset <= fileSize && size <= fileSize - offset;
+}
+
+// Reads the previous version of the pack, if there is a valid one.
+static OldPack readOldPack(const std::string &fileName) {
+  OldPack pack;
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file) {
+    return pack;
+  }
+  pack.bytes.assign(std::istreambuf_iterator<char>(file), {});
+  if (pack.bytes.size() < sizeof(AssetPackHeader)) {
+    return {};
+  }
+  // The vector's storage comes from operator new, which is aligned enough for
+  // any of the structures.
+  const AssetPackHeader &header = *(const AssetPackHeader *)pack.bytes.data();
+  if (std::memcmp(header.magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC)) ||
+      header.version != ASSET_PACK_VERSION ||
+      !fitsIn(sizeof(header),
+              (uint64_t)header.textureCount * sizeof(PackedTexture) +
+                  (uint64_t)header.meshCount * sizeof(PackedMesh),
+              pack.bytes.size())) {
+    return {};
+  }
+  auto *textures =
+      (const PackedTexture *)(pack.bytes.data() + sizeof(AssetPackHeader));
+  auto *meshes = (const PackedMesh *)(textures + header.textureCount);
+  for (uint32_t i = 0; i < header.textureCount; i++) {
+    if (fitsIn(textures[i].dataOffset, textures[i].dataSize,
+               pack.bytes.size())) {
+      pack.textures[std::string(getPackedName(textures[i].name))] =
+          &textures[i];
+    }
+  }
+  for (uint32_t i = 0; i < header.meshCount; i++) {
+    const PackedMesh &mesh = meshes[i];
+    if (fitsIn(mesh.vertexOffset,
+               (uint64_t)mesh.vertexCount * ASSET_PACK_FLOATS_PER_VERTEX *
+                   sizeof(float),
+               pack.bytes.size()) &&
+        fitsIn(mesh.indexOffset, (uint64_t)mesh.indexCount * sizeof(uint32_t),
+               pack.bytes.size())) {
+      pack.meshes[std::string(getPackedName(mesh.name))] = &mesh;
+    }
+  }
+  return pack;
+}
+
+// Each level is a box filtered version of the one before it (with the same
+// filter as the texture composer's compressed textures).
+static std::vector<unsigned char>
+buildMipLevels(std::vector<unsigned char> image, size_t width, size_t height,
+               uint32_t &levelCount) {
+  Image level(width, height, std::move(image));
+  std::vector<unsigned char> result = level.data;
+  levelCount = 1;
+  while (level.width > 1 || level.height > 1) {
+    level = downsampleImage(level);
+    result.insert(result.end(), level.data.begin(), level.data.end());
+    levelCount++;
+  }
+  return result;
+}
+
+static bool parseCubeTextureType(const std::string &name,
+                                 CubeTextureType &type) {
+  if (name == "sides") {
+    type = CubeTextureType::SIDES;
+  } else if (name == "tbs") {
+    type = CubeTextureType::TOP_BOTTOM_SIDES;
+  } else if (name == "net") {
+    type = CubeTextureType::TOP_BOTTOM_FRONT_BACK_LEFT_RIGHT;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cout << "Usage: asset-packer <manifest> <output pack>" << std::endl;
+    return 1;
+  }
+  std::string manifestName = argv[1];
+  std::string outputName = argv[2];
+  std::ifstream manifest(manifestName);
+  if (!manifest) {
+    std::cout << "Error opening manifest " << manifestName << std::endl;
+    return 1;
+  }
+  OldPack oldPack = readOldPack(outputName);
+
+  std::vector<TextureEntry> textures;
+  std::vector<MeshEntry> meshes;
+  std::unordered_map<std::string, size_t> textureIndices; // By name
+  size_t reusedCount = 0, rebuiltCount = 0;
+
+  std::string line;
+  size_t lineNumber = 0;
+  while (std::getline(manifest, line)) {
+    lineNumber++;
+    std::istringstream words(line);
+    std::string kind, name;
+    if (!(words >> kind) || kind[0] == '#') {
+      continue;
+    }
+    if (!(words >> name) || name.size() >= ASSET_PACK_NAME_LENGTH) {
+      std::cout << manifestName << ":" << lineNumber
+                << ": missing or overlong name" << std::endl;
+      return 1;
+    }
+    if (kind == "texture") {
+      std::string fileName;
+      words >> fileName;
+      std::ifstream file(fileName, std::ios::binary);
+      if (!file) {
+        std::cout << "Error opening texture " << fileName << std::endl;
+        return 1;
+      }
+      std::vector<unsigned char> png(std::istreambuf_iterator<char>(file),
+                                     {});
+      TextureEntry entry{};
+      setPackedName(entry.header.name, name);
+      entry.header.contentHash = hashAssetSource(png.data(), png.size());
+      auto old = oldPack.textures.find(name);
+      if (old != oldPack.textures.end() &&
+          old->second->contentHash == entry.header.contentHash) {
+        entry.header = *old->second;
+        const unsigned char *data =
+            oldPack.bytes.data() + old->second->dataOffset;
+        entry.data.assign(data, data + old->second->dataSize);
+        reusedCount++;
+      } else {
+        std::vector<unsigned char> image;
+        unsigned width, height;
+        unsigned error = lodepng::decode(image, width, height, png);
+        if (error) {
+          std::cout << "Error loading texture " << fileName << ": "
+                    << lodepng_error_text(error) << std::endl;
+          return 1;
+        }
+        entry.header.width = width;
+        entry.header.height = height;
+        entry.header.transparent = 0;
+        for (size_t i = 3; i < image.size(); i += 4) {
+          if (image[i] != 255) {
+            entry.header.transparent = 1;
+            break;
+          }
+        }
+        entry.data = buildMipLevels(std::move(image), width, height,
+                                    entry.header.mipLevelCount);
+        entry.header.dataSize = entry.data.size();
+        rebuiltCount++;
+      }
+      textureIndices[name] = textures.size();
+      textures.push_back(std::move(entry));
+    } else if (kind == "cube") {
+      std::string textureName, typeName;
+      words >> textureName >> typeName;
+      CubeTextureType type;
+      auto texture = textureIndices.find(textureName);
+      if (texture == textureIndices.end() ||
+          !parseCubeTextureType(typeName, type)) {
+        std::cout << manifestName << ":" << lineNumber
+                  << ": unknown texture or cube texture type" << std::endl;
+        return 1;
+      }
+      const TextureEntry &textureEntry = textures[texture->second];
+      MeshEntry entry{};
+      setPackedName(entry.header.name, name);
+      entry.header.textureIndex = texture->second;
+      // The mesh only depends on the layout, the texture (the image is just
+      // carried along with it) and the engine code which builds it.
+      uint64_t hash = textureEntry.header.contentHash;
+      hash = hashAssetSource(typeName.data(), typeName.size(), hash);
+      hash = hashAssetSource(&ASSET_PACK_MESHER_VERSION,
+                             sizeof(ASSET_PACK_MESHER_VERSION), hash);
+      entry.header.contentHash = hash;
+      auto old = oldPack.meshes.find(name);
+      if (old != oldPack.meshes.end() && old->second->contentHash == hash) {
+        const PackedMesh &oldMesh = *old->second;
+        entry.header = oldMesh;
+        entry.header.textureIndex = texture->second;
+        auto *vertices =
+            (const float *)(oldPack.bytes.data() + oldMesh.vertexOffset);
+        entry.vertices.assign(vertices,
+                              vertices + (size_t)oldMesh.vertexCount *
+                                             ASSET_PACK_FLOATS_PER_VERTEX);
+        auto *indices =
+            (const uint32_t *)(oldPack.bytes.data() + oldMesh.indexOffset);
+        entry.indices.assign(indices, indices + oldMesh.indexCount);
+        reusedCount++;
+      } else {
+        // The image itself doesn't affect the mesh, so any image will do.
+        TexturedMesh mesh = createCubeMesh(
+            std::make_shared<const Image>(1, 1, std::vector<Color8>(1)),
+            type);
+        IndexedVertices indexed = indexVertices(mesh.mesh, mesh.texture);
+        size_t vertexCount = indexed.vertexCount();
+        for (size_t i = 0; i < vertexCount; i++) {
+          entry.vertices.insert(entry.vertices.end(),
+                                {indexed.vertices[i * 3],
+                                 indexed.vertices[i * 3 + 1],
+                                 indexed.vertices[i * 3 + 2],
+                                 indexed.textureCoordinates[i * 2],
+                                 indexed.textureCoordinates[i * 2 + 1]});
+        }
+        entry.indices.assign(indexed.indices.begin(), indexed.indices.end());
+        entry.header.vertexCount = vertexCount;
+        entry.header.indexCount = entry.indices.size();
+        // The same bounds as Bounds::fromMesh: a box around every vertex, and
+        // a sphere around the middle of the box.
+        float *min = entry.header.boundsMin, *max = entry.header.boundsMax;
+        for (int axis = 0; axis < 3; axis++) {
+          min[axis] = vertexCount ? INFINITY : 0;
+          max[axis] = vertexCount ? -INFINITY : 0;
+        }
+        for (size_t i = 0; i < vertexCount; i++) {
+          for (int axis = 0; axis < 3; axis++) {
+            min[axis] = std::min(min[axis], indexed.vertices[i * 3 + axis]);
+            max[axis] = std::max(max[axis], indexed.vertices[i * 3 + axis]);
+          }
+        }
+        float radiusSquared = 0;
+        for (int axis = 0; axis < 3; axis++) {
+          entry.header.sphereCenter[axis] = (min[axis] + max[axis]) / 2;
+        }
+        for (size_t i = 0; i < vertexCount; i++) {
+          float distanceSquared = 0;
+          for (int axis = 0; axis < 3; axis++) {
+            float offset = indexed.vertices[i * 3 + axis] -
+                           entry.header.sphereCenter[axis];
+            distanceSquared += offset * offset;
+          }
+          radiusSquared = std::max(radiusSquared, distanceSquared);
+        }
+        entry.header.sphereRadius = std::sqrt(radiusSquared);
+        rebuiltCount++;
+      }
+      meshes.push_back(std::move(entry));
+    } else {
+      std::cout << manifestName << ":" << lineNumber << ": unknown asset type "
+                << kind << std::endl;
+      return 1;
+    }
+  }
+
+  // Now that everything is built, lay out the file.
+  AssetPackHeader header{};
+  std::memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC));
+  header.version = ASSET_PACK_VERSION;
+  header.textureCount = textures.size();
+  header.meshCount = meshes.size();
+  size_t offset = sizeof(AssetPackHeader) +
+                  textures.size() * sizeof(PackedTexture) +
+                  meshes.size() * sizeof(PackedMesh);
+  for (TextureEntry &entry : textures) {
+    offset = alignAssetPackOffset(offset);
+    entry.header.dataOffset = offset;
+    offset += entry.data.size();
+  }
+  for (MeshEntry &entry : meshes) {
+    offset = alignAssetPackOffset(offset);
+    entry.header.vertexOffset = offset;
+    offset += entry.vertices.size() * sizeof(float);
+    offset = alignAssetPackOffset(offset);
+    entry.header.indexOffset = offset;
+    offset += entry.indices.size() * sizeof(uint32_t);
+  }
+  std::vector<unsigned char> pack(offset);
+  auto write = [&](size_t at, const void *data, size_t size) {
+    std::memcpy(pack.data() + at, data, size);
+  };
+  write(0, &header, sizeof(header));
+  size_t tableOffset = sizeof(AssetPackHeader);
+  for (const TextureEntry &entry : textures) {
+    write(tableOffset, &entry.header, sizeof(PackedTexture));
+    tableOffset += sizeof(PackedTexture);
+    write(entry.header.dataOffset, entry.data.data(), entry.data.size());
+  }
+  for (const MeshEntry &entry : meshes) {
+    write(tableOffset, &entry.header, sizeof(PackedMesh));
+    tableOffset += sizeof(PackedMesh);
+    write(entry.header.vertexOffset, entry.vertices.data(),
+          entry.vertices.size() * sizeof(float));
+    write(entry.header.indexOffset, entry.indices.data(),
+          entry.indices.size() * sizeof(uint32_t));
+  }
+  std::ofstream output(outputName, std::ios::binary);
+  output.write((const char *)pack.data(), pack.size());
+  if (!output) {
+    std::cout << "Error writing " << outputName << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << outputName << ": " << rebuiltCount
+            << " entries rebuilt, " << reusedCount << " up to date"
+            << std::endl;
+  return 0;
+}
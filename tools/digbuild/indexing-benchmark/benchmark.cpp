@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <jobSystem.h>
+#include <memory>
+#include <seagull/mesh.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vertexIndexer.h>
+
+// Welds the vertices of ever larger grids, both on one thread and split
+// across the job system, and prints how long each took per triangle. If the
+// welding is linear, the time per triangle stays about the same however big
+// the grid gets.
+//
+// Usage: indexing-benchmark [largest grid size] [repetitions]
+
+using namespace seagull;
+
+// A flat grid of size x size quads, with every corner shared by up to six
+// triangles, like most real meshes.
+static TexturedMesh createGrid(unsigned size) {
+  Mesh mesh;
+  Texture texture(Image(1, 1, std::vector<unsigned char>{255, 255, 255, 255}));
+  for (unsigned z = 0; z < size; z++) {
+    for (unsigned x = 0; x < size; x++) {
+      float x0 = x, x1 = x + 1, z0 = z, z1 = z + 1;
+      mesh.addQuad({x0, 0, z0}, {x1, 0, z0}, {x1, 0, z1}, {x0, 0, z1});
+      float u0 = x0 / size, u1 = x1 / size, v0 = z0 / size, v1 = z1 / size;
+      texture.addQuad({u0, v0}, {u1, v0}, {u1, v1}, {u0, v1});
+    }
+  }
+  return TexturedMesh(std::move(mesh), std::move(texture));
+}
+
+// The best of several runs, in nanoseconds per triangle.
+static double timeIndexing(const TexturedMesh &mesh, JobSystem *jobs,
+                           unsigned repetitions, size_t expectedVertices) {
+  double best = INFINITY;
+  for (unsigned i = 0; i < repetitions; i++) {
+    auto start = std::chrono::steady_clock::now();
+    IndexedVertices indexed = indexVertices(mesh.mesh, mesh.texture, jobs);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    if (indexed.vertexCount() != expectedVertices ||
+        indexed.indices.size() != mesh.mesh.size() * 3) {
+      throw std::runtime_error("Welded " +
+                               std::to_string(indexed.vertexCount()) +
+                               " vertices, but expected " +
+                               std::to_string(expectedVertices));
+    }
+    best = std::min(best, seconds * 1e9 / mesh.mesh.size());
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  try {
+    unsigned largestSize = argc > 1 ? std::stoul(argv[1]) : 1024;
+    unsigned repetitions = argc > 2 ? std::stoul(argv[2]) : 3;
+
+    JobSystem jobs;
+    std::cout << "triangles, ns/triangle (1 thread), ns/triangle ("
+              << jobs.getWorkerCount() + 1 << " threads)" << std::endl;
+    double first = 0, last = 0;
+    // Each grid has four times as many triangles as the one before.
+    for (unsigned size = 32; size <= largestSize; size *= 2) {
+      TexturedMesh mesh = createGrid(size);
+      size_t expectedVertices = (size_t)(size + 1) * (size + 1);
+      double serial =
+          timeIndexing(mesh, nullptr, repetitions, expectedVertices);
+      double parallel =
+          timeIndexing(mesh, &jobs, repetitions, expectedVertices);
+      std::cout << mesh.mesh.size() << ", " << serial << ", " << parallel
+                << std::endl;
+      if (!first) {
+        first = serial;
+      }
+      last = serial;
+    }
+    // Anything much over 1 means the welding is worse than linear (although
+    // the biggest meshes also miss the cache more often).
+    std::cout << "Largest / smallest time per triangle (1 thread): "
+              << last / first << std::endl;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,174 @@
+#include <bvh.h>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <seagull/raycast.h>
+#include <seagull/voxel.h>
+#include <string>
+#include <vector>
+
+// Casts the same random rays through a digbuild world twice: once through a
+// voxel grid with the DDA, and once against the triangles of the meshed
+// chunks with a BVH. It prints how many rays per second each manages, and
+// checks that they agree on where the rays hit.
+//
+// Usage: raycast-benchmark [ray count] [max distance]
+
+using namespace seagull;
+
+static constexpr unsigned WORLD_CHUNKS = 16;
+static constexpr unsigned SIZE = VoxelChunk::SIZE;
+static constexpr unsigned WORLD_SIZE = WORLD_CHUNKS * SIZE;
+
+// The same hills as digbuild itself.
+static unsigned getTerrainHeight(unsigned x, unsigned z) {
+  return 4 + (unsigned)(3 * (std::sin(x * 0.1f) + 1) +
+                        3 * (std::cos(z * 0.13f) + 1));
+}
+
+static std::vector<VoxelChunk> generateTerrain(BlockId block) {
+  std::vector<VoxelChunk> chunks(WORLD_CHUNKS * WORLD_CHUNKS);
+  for (unsigned x = 0; x < WORLD_SIZE; x++) {
+    for (unsigned z = 0; z < WORLD_SIZE; z++) {
+      unsigned height = getTerrainHeight(x, z);
+      VoxelChunk &chunk = chunks[(z / SIZE) * WORLD_CHUNKS + x / SIZE];
+      for (unsigned y = 0; y < height; y++) {
+        chunk.set(x % SIZE, y, z % SIZE, block);
+      }
+    }
+  }
+  return chunks;
+}
+
+// Mesh every chunk, and gather all of their triangles into one BVH.
+static MeshBvh buildWorldBvh(const std::vector<VoxelChunk> &chunks,
+                             const BlockPalette &palette) {
+  auto chunkAt = [&](unsigned x, unsigned z) -> const VoxelChunk * {
+    if (x >= WORLD_CHUNKS || z >= WORLD_CHUNKS) {
+      return nullptr; // Also catches -1, since these are unsigned
+    }
+    return &chunks[z * WORLD_CHUNKS + x];
+  };
+  std::vector<float> positions;
+  std::vector<uint32_t> indices;
+  for (unsigned chunkZ = 0; chunkZ < WORLD_CHUNKS; chunkZ++) {
+    for (unsigned chunkX = 0; chunkX < WORLD_CHUNKS; chunkX++) {
+      ChunkNeighbours neighbours{};
+      neighbours[(unsigned)CubeFace::FRONT] = chunkAt(chunkX, chunkZ - 1);
+      neighbours[(unsigned)CubeFace::BACK] = chunkAt(chunkX, chunkZ + 1);
+      neighbours[(unsigned)CubeFace::LEFT] = chunkAt(chunkX - 1, chunkZ);
+      neighbours[(unsigned)CubeFace::RIGHT] = chunkAt(chunkX + 1, chunkZ);
+      IndexedMesh mesh =
+          meshChunk(*chunkAt(chunkX, chunkZ), palette, neighbours);
+      uint32_t firstVertex = positions.size() / 3;
+      const std::vector<float> &chunkPositions = mesh.getPositions();
+      for (size_t i = 0; i < chunkPositions.size(); i += 3) {
+        positions.push_back(chunkPositions[i] + chunkX * SIZE);
+        positions.push_back(chunkPositions[i + 1]);
+        positions.push_back(chunkPositions[i + 2] + chunkZ * SIZE);
+      }
+      for (uint32_t index : mesh.getIndices()) {
+        indices.push_back(firstVertex + index);
+      }
+    }
+  }
+  std::cout << "Meshed " << indices.size() / 3 << " triangles" << std::endl;
+  return MeshBvh(positions.data(), 3, indices.data(), indices.size());
+}
+
+// Rays from just above the hills in every direction, like line of sight
+// checks between things walking around on them.
+static std::vector<Ray> generateRays(size_t count, float maxDistance) {
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> horizontal(0, WORLD_SIZE);
+  std::uniform_real_distribution<float> eyeHeight(0.5f, 2);
+  std::normal_distribution<float> normal;
+  std::vector<Ray> rays(count);
+  for (Ray &ray : rays) {
+    float x = horizontal(random), z = horizontal(random);
+    float y = getTerrainHeight(x, z) + eyeHeight(random);
+    ray.origin = {x, y, z};
+    ray.direction = {normal(random), normal(random), normal(random)};
+    ray.maxDistance = maxDistance;
+  }
+  return rays;
+}
+
+template <typename CastRay>
+static std::vector<float> timeRays(const char *name,
+                                   const std::vector<Ray> &rays,
+                                   CastRay castRay) {
+  std::vector<float> distances(rays.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rays.size(); i++) {
+    distances[i] = castRay(rays[i]);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  size_t hits = 0;
+  for (float distance : distances) {
+    hits += distance >= 0;
+  }
+  double raysPerSecond = rays.size() / seconds;
+  std::cout << name << ": " << raysPerSecond / 1e6 << " million rays/s ("
+            << (size_t)(raysPerSecond / 60) << " per 60 Hz frame on one core, "
+            << 100.0 * hits / rays.size() << "% hit)" << std::endl;
+  return distances;
+}
+
+int main(int argc, char **argv) {
+  try {
+    size_t rayCount = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    float maxDistance = argc > 2 ? std::stof(argv[2]) : 64;
+
+    BlockPalette palette(std::make_shared<const Image>(
+        1, 1, std::vector<unsigned char>{255, 255, 255, 255}));
+    BlockId block = palette.addBlockType(CubeTextureType::SIDES);
+    std::vector<VoxelChunk> chunks = generateTerrain(block);
+    VoxelGrid grid(WORLD_SIZE, SIZE, WORLD_SIZE);
+    for (unsigned chunkZ = 0; chunkZ < WORLD_CHUNKS; chunkZ++) {
+      for (unsigned chunkX = 0; chunkX < WORLD_CHUNKS; chunkX++) {
+        grid.setChunk(chunkX * SIZE, 0, chunkZ * SIZE,
+                      chunks[chunkZ * WORLD_CHUNKS + chunkX]);
+      }
+    }
+    MeshBvh bvh = buildWorldBvh(chunks, palette);
+    std::vector<Ray> rays = generateRays(rayCount, maxDistance);
+
+    // Each returns the distance to the hit, or -1 for a miss.
+    std::vector<float> voxelDistances =
+        timeRays("Voxel DDA", rays, [&](const Ray &ray) {
+          std::optional<VoxelHit> hit = grid.raycast(ray);
+          return hit ? hit->distance : -1.0f;
+        });
+    std::vector<float> bvhDistances =
+        timeRays("Triangle BVH", rays, [&](const Ray &ray) {
+          Eigen::Vector3f direction(ray.direction.x, ray.direction.y,
+                                    ray.direction.z);
+          float distance = ray.maxDistance;
+          uint32_t triangle;
+          return bvh.raycast({ray.origin.x, ray.origin.y, ray.origin.z},
+                             direction.normalized(), distance, triangle)
+                     ? distance
+                     : -1.0f;
+        });
+
+    // A few rays which only just graze an edge, or start right on a face, can
+    // come out differently, but any more than that is a bug.
+    size_t disagreements = 0;
+    for (size_t i = 0; i < rays.size(); i++) {
+      if ((voxelDistances[i] < 0) != (bvhDistances[i] < 0) ||
+          std::abs(voxelDistances[i] - bvhDistances[i]) > 1e-3f) {
+        disagreements++;
+      }
+    }
+    std::cout << disagreements << " rays disagreed" << std::endl;
+    return disagreements <= rays.size() / 10000 ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,407 @@
+#include "blockCompression.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iterator>
+#include <seagull/compressedTextureFormat.h>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define COMPOSER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace seagull;
+
+// A 4x4 block of pixels, with the colour channels split out so that four
+// pixels can be compared against a colour at once.
+struct Block {
+  alignas(16) float r[16];
+  alignas(16) float g[16];
+  alignas(16) float b[16];
+  uint8_t a[16];
+};
+
+struct Rgb {
+  float r, g, b;
+};
+
+static uint16_t quantize565(Rgb color) {
+  auto quantize = [](float value, int maximum) {
+    return (int)std::lround(std::clamp(value, 0.0f, 255.0f) * maximum / 255);
+  };
+  return quantize(color.r, 31) << 11 | quantize(color.g, 63) << 5 |
+         quantize(color.b, 31);
+}
+
+// Exactly what the decoder (and the GPU) expands the endpoints to.
+static Rgb expand565(uint16_t color) {
+  int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+  return {(float)(r << 3 | r >> 2), (float)(g << 2 | g >> 4),
+          (float)(b << 3 | b >> 2)};
+}
+
+static Rgb mix(Rgb a, Rgb b, int weightA, int weightB) {
+  int total = weightA + weightB;
+  auto channel = [&](float x, float y) {
+    return (float)(((int)x * weightA + (int)y * weightB) / total);
+  };
+  return {channel(a.r, b.r), channel(a.g, b.g), channel(a.b, b.b)};
+}
+
+// Choose the nearest palette colour for every pixel which isn't transparent,
+// and return the total squared error.
+static float pickColorIndices(const Block &block, const Rgb *palette,
+                              int paletteSize, const bool *transparent,
+                              uint8_t *indices) {
+  float totalError = 0;
+#ifdef COMPOSER_SSE2
+  for (int i = 0; i < 16; i += 4) {
+    __m128 r = _mm_load_ps(&block.r[i]);
+    __m128 g = _mm_load_ps(&block.g[i]);
+    __m128 b = _mm_load_ps(&block.b[i]);
+    __m128 bestError = _mm_set1_ps(INFINITY);
+    __m128 bestIndex = _mm_setzero_ps();
+    for (int entry = 0; entry < paletteSize; entry++) {
+      __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[entry].r));
+      __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[entry].g));
+      __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[entry].b));
+      __m128 error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr),
+                                           _mm_mul_ps(dg, dg)),
+                                _mm_mul_ps(db, db));
+      __m128 better = _mm_cmplt_ps(error, bestError);
+      bestError = _mm_or_ps(_mm_and_ps(better, error),
+                            _mm_andnot_ps(better, bestError));
+      bestIndex = _mm_or_ps(_mm_and_ps(better, _mm_set1_ps((float)entry)),
+                            _mm_andnot_ps(better, bestIndex));
+    }
+    alignas(16) float errors[4], best[4];
+    _mm_store_ps(errors, bestError);
+    _mm_store_ps(best, bestIndex);
+    for (int lane = 0; lane < 4; lane++) {
+      if (transparent[i + lane]) {
+        indices[i + lane] = 3;
+      } else {
+        indices[i + lane] = (uint8_t)best[lane];
+        totalError += errors[lane];
+      }
+    }
+  }
+#else
+  for (int i = 0; i < 16; i++) {
+    if (transparent[i]) {
+      indices[i] = 3;
+      continue;
+    }
+    float bestError = INFINITY;
+    for (int entry = 0; entry < paletteSize; entry++) {
+      float dr = block.r[i] - palette[entry].r;
+      float dg = block.g[i] - palette[entry].g;
+      float db = block.b[i] - palette[entry].b;
+      float error = dr * dr + dg * dg + db * db;
+      if (error < bestError) {
+        bestError = error;
+        indices[i] = entry;
+      }
+    }
+    totalError += bestError;
+  }
+#endif
+  return totalError;
+}
+
+struct ColorFit {
+  uint16_t color0, color1;
+  uint8_t indices[16];
+  float error;
+};
+
+static ColorFit fitEndpoints(const Block &block, uint16_t color0,
+                             uint16_t color1, bool threeColors,
+                             const bool *transparent) {
+  ColorFit fit{color0, color1};
+  Rgb palette[4] = {expand565(color0), expand565(color1)};
+  if (threeColors) {
+    palette[2] = mix(palette[0], palette[1], 1, 1);
+  } else {
+    palette[2] = mix(palette[0], palette[1], 2, 1);
+    palette[3] = mix(palette[0], palette[1], 1, 2);
+  }
+  fit.error = pickColorIndices(block, palette, threeColors ? 3 : 4,
+                               transparent, fit.indices);
+  return fit;
+}
+
+// Find the endpoints which best fit the pixels for the indices they were given
+// (a linear least squares problem in the two endpoints).
+static bool refineEndpoints(const Block &block, const ColorFit &fit,
+                            bool threeColors, const bool *transparent,
+                            Rgb &endpoint0, Rgb &endpoint1) {
+  static constexpr float FOUR_COLOR_WEIGHTS[4] = {1, 0, 2.0f / 3, 1.0f / 3};
+  static constexpr float THREE_COLOR_WEIGHTS[3] = {1, 0, 0.5f};
+  float aa = 0, ab = 0, bb = 0;
+  Rgb ax{0, 0, 0}, bx{0, 0, 0};
+  for (int i = 0; i < 16; i++) {
+    if (transparent[i]) {
+      continue;
+    }
+    float weight = threeColors ? THREE_COLOR_WEIGHTS[fit.indices[i]]
+                               : FOUR_COLOR_WEIGHTS[fit.indices[i]];
+    float a = weight, b = 1 - weight;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    ax = {ax.r + a * block.r[i], ax.g + a * block.g[i], ax.b + a * block.b[i]};
+    bx = {bx.r + b * block.r[i], bx.g + b * block.g[i], bx.b + b * block.b[i]};
+  }
+  float determinant = aa * bb - ab * ab;
+  if (std::abs(determinant) < 1e-6f) {
+    return false; // Every pixel uses the same index.
+  }
+  float scale = 1 / determinant;
+  auto solve = [&](float x, float y, float &first, float &second) {
+    first = (bb * x - ab * y) * scale;
+    second = (aa * y - ab * x) * scale;
+  };
+  solve(ax.r, bx.r, endpoint0.r, endpoint1.r);
+  solve(ax.g, bx.g, endpoint0.g, endpoint1.g);
+  solve(ax.b, bx.b, endpoint0.b, endpoint1.b);
+  return true;
+}
+
+static void encodeColorBlock(const Block &block, bool isBc1,
+                             unsigned char *output) {
+  // BC1 has a mode with a transparent palette entry, which we use for any
+  // pixels under half opacity.
+  bool transparent[16] = {};
+  bool threeColors = false;
+  int opaqueCount = 0;
+  for (int i = 0; i < 16; i++) {
+    transparent[i] = isBc1 && block.a[i] < 128;
+    threeColors |= transparent[i];
+    opaqueCount += !transparent[i];
+  }
+
+  ColorFit best{};
+  if (opaqueCount == 0) {
+    std::fill(std::begin(best.indices), std::end(best.indices), 3);
+  } else {
+    // The endpoints go at the extremes of the principal axis of the colours,
+    // which is found by power iteration on their covariance.
+    Rgb mean{0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+      if (!transparent[i]) {
+        mean = {mean.r + block.r[i], mean.g + block.g[i],
+                mean.b + block.b[i]};
+      }
+    }
+    mean = {mean.r / opaqueCount, mean.g / opaqueCount, mean.b / opaqueCount};
+    float covariance[6] = {}; // rr, rg, rb, gg, gb, bb
+    for (int i = 0; i < 16; i++) {
+      if (transparent[i]) {
+        continue;
+      }
+      float r = block.r[i] - mean.r, g = block.g[i] - mean.g,
+            b = block.b[i] - mean.b;
+      covariance[0] += r * r;
+      covariance[1] += r * g;
+      covariance[2] += r * b;
+      covariance[3] += g * g;
+      covariance[4] += g * b;
+      covariance[5] += b * b;
+    }
+    Rgb axis{1, 1, 1};
+    for (int iteration = 0; iteration < 8; iteration++) {
+      Rgb next{covariance[0] * axis.r + covariance[1] * axis.g +
+                   covariance[2] * axis.b,
+               covariance[1] * axis.r + covariance[3] * axis.g +
+                   covariance[4] * axis.b,
+               covariance[2] * axis.r + covariance[4] * axis.g +
+                   covariance[5] * axis.b};
+      float length = std::max({std::abs(next.r), std::abs(next.g),
+                               std::abs(next.b)});
+      if (length < 1e-6f) {
+        break; // A flat colour: any axis will do.
+      }
+      axis = {next.r / length, next.g / length, next.b / length};
+    }
+    float axisLengthSquared =
+        axis.r * axis.r + axis.g * axis.g + axis.b * axis.b;
+    float minimum = INFINITY, maximum = -INFINITY;
+    for (int i = 0; i < 16; i++) {
+      if (!transparent[i]) {
+        float t = ((block.r[i] - mean.r) * axis.r +
+                   (block.g[i] - mean.g) * axis.g +
+                   (block.b[i] - mean.b) * axis.b) /
+                  axisLengthSquared;
+        minimum = std::min(minimum, t);
+        maximum = std::max(maximum, t);
+      }
+    }
+    Rgb endpoint0{mean.r + axis.r * maximum, mean.g + axis.g * maximum,
+                  mean.b + axis.b * maximum};
+    Rgb endpoint1{mean.r + axis.r * minimum, mean.g + axis.g * minimum,
+                  mean.b + axis.b * minimum};
+    best = fitEndpoints(block, quantize565(endpoint0), quantize565(endpoint1),
+                        threeColors, transparent);
+    for (int iteration = 0; iteration < 2 && best.error > 0; iteration++) {
+      if (!refineEndpoints(block, best, threeColors, transparent, endpoint0,
+                           endpoint1)) {
+        break;
+      }
+      ColorFit refined =
+          fitEndpoints(block, quantize565(endpoint0), quantize565(endpoint1),
+                       threeColors, transparent);
+      if (refined.error >= best.error) {
+        break;
+      }
+      best = refined;
+    }
+  }
+
+  // The order of the endpoints picks BC1's mode: the first is bigger for four
+  // colours, and not for three (with transparency). BC3 always has four
+  // colours, but we keep to the same order anyway.
+  bool swap = threeColors ? best.color0 > best.color1
+                          : best.color0 < best.color1;
+  if (swap) {
+    std::swap(best.color0, best.color1);
+    for (uint8_t &index : best.indices) {
+      // Swap 0 with 1, and (with four colours) 2 with 3.
+      if (index < 2 || !threeColors) {
+        index ^= 1;
+      }
+    }
+  }
+  if (!threeColors && best.color0 == best.color1) {
+    // That would be read as three colours, and only the first one is safe.
+    std::fill(std::begin(best.indices), std::end(best.indices), 0);
+  }
+  output[0] = best.color0 & 255;
+  output[1] = best.color0 >> 8;
+  output[2] = best.color1 & 255;
+  output[3] = best.color1 >> 8;
+  uint32_t packed = 0;
+  for (int i = 0; i < 16; i++) {
+    packed |= (uint32_t)best.indices[i] << (i * 2);
+  }
+  for (int i = 0; i < 4; i++) {
+    output[4 + i] = packed >> (i * 8);
+  }
+}
+
+struct AlphaFit {
+  uint8_t alpha0, alpha1;
+  uint8_t indices[16];
+  int error;
+};
+
+static AlphaFit fitAlpha(const Block &block, uint8_t alpha0, uint8_t alpha1) {
+  AlphaFit fit{alpha0, alpha1, {}, 0};
+  int palette[8] = {alpha0, alpha1};
+  if (alpha0 > alpha1) {
+    for (int i = 1; i < 7; i++) {
+      palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+    }
+  } else {
+    for (int i = 1; i < 5; i++) {
+      palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+  for (int i = 0; i < 16; i++) {
+    int bestError = INT32_MAX;
+    for (int entry = 0; entry < 8; entry++) {
+      int difference = block.a[i] - palette[entry];
+      if (difference * difference < bestError) {
+        bestError = difference * difference;
+        fit.indices[i] = entry;
+      }
+    }
+    fit.error += bestError;
+  }
+  return fit;
+}
+
+static void encodeAlphaBlock(const Block &block, unsigned char *output) {
+  // Eight interpolated values cover the whole range best, unless there are
+  // fully transparent or opaque pixels, which the six value mode can keep
+  // exact (it also has 0 and 255).
+  uint8_t minimum = 255, maximum = 0;
+  uint8_t innerMinimum = 255, innerMaximum = 0;
+  for (uint8_t alpha : block.a) {
+    minimum = std::min(minimum, alpha);
+    maximum = std::max(maximum, alpha);
+    if (alpha != 0 && alpha != 255) {
+      innerMinimum = std::min(innerMinimum, alpha);
+      innerMaximum = std::max(innerMaximum, alpha);
+    }
+  }
+  AlphaFit best = fitAlpha(block, maximum, minimum);
+  if (innerMinimum <= innerMaximum) {
+    AlphaFit sixValues = fitAlpha(block, innerMinimum, innerMaximum);
+    if (sixValues.error < best.error) {
+      best = sixValues;
+    }
+  }
+  output[0] = best.alpha0;
+  output[1] = best.alpha1;
+  uint64_t packed = 0;
+  for (int i = 0; i < 16; i++) {
+    packed |= (uint64_t)best.indices[i] << (i * 3);
+  }
+  for (int i = 0; i < 6; i++) {
+    output[2 + i] = packed >> (i * 8);
+  }
+}
+
+std::vector<unsigned char> compressImage(const unsigned char *pixels,
+                                         size_t width, size_t height,
+                                         uint32_t format) {
+  size_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+  size_t blockSize = getCompressedBlockSize(format);
+  std::vector<unsigned char> result(blocksWide * blocksHigh * blockSize);
+  auto compressRow = [&](size_t blockY) {
+    for (size_t blockX = 0; blockX < blocksWide; blockX++) {
+      Block block;
+      for (size_t i = 0; i < 16; i++) {
+        // Partial blocks are padded by repeating the edge pixels.
+        size_t x = std::min(blockX * 4 + i % 4, width - 1);
+        size_t y = std::min(blockY * 4 + i / 4, height - 1);
+        const unsigned char *pixel = &pixels[(y * width + x) * 4];
+        block.r[i] = pixel[0];
+        block.g[i] = pixel[1];
+        block.b[i] = pixel[2];
+        block.a[i] = pixel[3];
+      }
+      unsigned char *output =
+          &result[(blockY * blocksWide + blockX) * blockSize];
+      if (format == COMPRESSED_TEXTURE_BC1) {
+        encodeColorBlock(block, true, output);
+      } else {
+        encodeAlphaBlock(block, output);
+        encodeColorBlock(block, false, output + 8);
+      }
+    }
+  };
+  // Every row of blocks is independent, so the workers just take the next one
+  // until there are none left.
+  std::atomic<size_t> nextRow = 0;
+  auto work = [&]() {
+    for (size_t row; (row = nextRow++) < blocksHigh;) {
+      compressRow(row);
+    }
+  };
+  size_t workerCount = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), blocksHigh);
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < workerCount; i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  return result;
+}
@@ -0,0 +1,22 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief compress an RGBA8 image into BC1 or BC3 blocks
+ *
+ * @note the endpoints of each block are fitted along the principal axis of its
+ * colours, then refined by least squares. The blocks are split across every
+ * core.
+ *
+ * @param format COMPRESSED_TEXTURE_BC1 or COMPRESSED_TEXTURE_BC3. BC1 blocks
+ * with pixels under half opacity use its transparent mode.
+ */
+std::vector<unsigned char> compressImage(const unsigned char *pixels,
+                                         size_t width, size_t height,
+                                         uint32_t format);
+
+#endif
@@ -1,7 +1,28 @@
+#include "blockCompression.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <lodepng.h>
+#include <seagull/assetPackFormat.h>
+#include <seagull/atlasPacking.h>
+#include <seagull/compressedTextureFormat.h>
+#include <seagull/texture.h>
 #include <string>
 
+// The peak signal to noise ratio of the decoded image (over every channel), in
+// decibels. Higher is better, and identical images are infinite.
+static double getPsnr(const std::vector<unsigned char> &original,
+                      const seagull::Image &decoded) {
+  double squaredError = 0;
+  for (size_t i = 0; i < original.size(); i++) {
+    double difference = (double)original[i] - decoded.data[i];
+    squaredError += difference * difference;
+  }
+  double meanSquaredError = squaredError / original.size();
+  return 10 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
 int main(int argc, char **argv) {
   if (argc < 2) {
     std::cout << "Missing texture mode" << std::endl;
@@ -53,6 +74,137 @@ int main(int argc, char **argv) {
     result.insert(result.end(), bottom_image.begin(), bottom_image.end());
     // And write them back.
     error = lodepng::encode("result.png", result, top_width, top_height * 3);
+  } else if (mode == "atlas") {
+    // Pack any number of textures into one, using the same packing as the
+    // engine's TextureAtlas. Alongside the image we write out where each
+    // texture ended up (in pixels and in texture coordinates).
+    if (argc < 3) {
+      std::cout << "Missing texture files" << std::endl;
+      return 1;
+    }
+    static constexpr size_t PADDING = 4;
+    std::vector<std::vector<unsigned char>> images;
+    std::vector<seagull::AtlasSize> sizes;
+    for (int i = 2; i < argc; i++) {
+      std::vector<unsigned char> image;
+      unsigned width, height;
+      unsigned error = lodepng::decode(image, width, height, argv[i]);
+      if (error) {
+        std::cout << "Error loading texture " << argv[i] << ": "
+                  << lodepng_error_text(error) << std::endl;
+        return 1;
+      }
+      images.push_back(std::move(image));
+      sizes.push_back({width, height});
+    }
+    seagull::AtlasLayout layout = seagull::packAtlas(sizes, PADDING);
+    std::vector<unsigned char> result(layout.width * layout.height * 4);
+    for (size_t i = 0; i < images.size(); i++) {
+      seagull::blitIntoAtlas(result.data(), layout.width, images[i].data(),
+                             layout.rects[i], PADDING);
+    }
+    unsigned error =
+        lodepng::encode("result.png", result, layout.width, layout.height);
+    if (error) {
+      std::cout << "Error writing atlas: " << lodepng_error_text(error)
+                << std::endl;
+      return 1;
+    }
+    std::ofstream layoutFile("result.txt");
+    layoutFile << "# file x y width height u0 v0 u1 v1" << std::endl;
+    for (size_t i = 0; i < images.size(); i++) {
+      const seagull::AtlasRect &rect = layout.rects[i];
+      layoutFile << argv[i + 2] << " " << rect.x << " " << rect.y << " "
+                 << rect.width << " " << rect.height << " "
+                 << (float)rect.x / layout.width << " "
+                 << (float)rect.y / layout.height << " "
+                 << (float)(rect.x + rect.width) / layout.width << " "
+                 << (float)(rect.y + rect.height) / layout.height << std::endl;
+    }
+  } else if (mode == "compress") {
+    // Block-compress textures (with every mip level) into files which the
+    // engine uploads as they are (see loadCompressedImage). Each one is
+    // written next to its source, with a .sgtex extension.
+    if (argc < 4) {
+      std::cout << "Missing format (bc1, bc3 or auto) or texture files"
+                << std::endl;
+      return 1;
+    }
+    std::string formatName = argv[2];
+    if (formatName != "bc1" && formatName != "bc3" && formatName != "auto") {
+      std::cout << "Unknown compressed format " << formatName << std::endl;
+      return 1;
+    }
+    for (int i = 3; i < argc; i++) {
+      std::string fileName = argv[i];
+      std::vector<unsigned char> image;
+      unsigned width, height;
+      unsigned error = lodepng::decode(image, width, height, fileName);
+      if (error) {
+        std::cout << "Error loading texture " << fileName << ": "
+                  << lodepng_error_text(error) << std::endl;
+        return 1;
+      }
+      // BC1 only has on/off transparency, so anything in between needs BC3.
+      bool transparent = false, partlyTransparent = false;
+      for (size_t j = 3; j < image.size(); j += 4) {
+        transparent |= image[j] != 255;
+        partlyTransparent |= image[j] != 255 && image[j] != 0;
+      }
+      uint32_t format = formatName == "bc3" ||
+                                (formatName == "auto" && partlyTransparent)
+                            ? seagull::COMPRESSED_TEXTURE_BC3
+                            : seagull::COMPRESSED_TEXTURE_BC1;
+
+      seagull::CompressedTextureHeader header{};
+      std::memcpy(header.magic, seagull::COMPRESSED_TEXTURE_MAGIC,
+                  sizeof(seagull::COMPRESSED_TEXTURE_MAGIC));
+      header.version = seagull::COMPRESSED_TEXTURE_VERSION;
+      header.format = format;
+      header.width = width;
+      header.height = height;
+      header.transparent = transparent;
+      std::vector<unsigned char> data;
+      seagull::Image level(width, height, image);
+      size_t uncompressedSize = 0;
+      while (true) {
+        std::vector<unsigned char> blocks = compressImage(
+            level.data.data(), level.width, level.height, format);
+        data.insert(data.end(), blocks.begin(), blocks.end());
+        uncompressedSize += level.data.size();
+        header.mipLevelCount++;
+        if (level.width == 1 && level.height == 1) {
+          break;
+        }
+        level = seagull::downsampleImage(level);
+      }
+
+      std::string outputName =
+          fileName.substr(0, fileName.rfind('.')) + ".sgtex";
+      std::ofstream output(outputName, std::ios::binary);
+      output.write((const char *)&header, sizeof(header));
+      output.write((const char *)data.data(), data.size());
+      if (!output) {
+        std::cout << "Error writing " << outputName << std::endl;
+        return 1;
+      }
+      // Measured on the largest level, decoded the same way as the engine
+      // would if the GPU couldn't.
+      seagull::Image decoded = seagull::decompressImage(seagull::Image(
+          width, height,
+          format == seagull::COMPRESSED_TEXTURE_BC1 ? seagull::PixelFormat::BC1
+                                                    : seagull::PixelFormat::BC3,
+          header.mipLevelCount, data, transparent));
+      size_t compressedSize = sizeof(header) + data.size();
+      std::cout << outputName << ": "
+                << (format == seagull::COMPRESSED_TEXTURE_BC1 ? "BC1" : "BC3")
+                << ", " << width << "x" << height << ", "
+                << header.mipLevelCount << " mip levels, " << compressedSize
+                << " bytes (RGBA8 " << uncompressedSize << " bytes, "
+                << (double)uncompressedSize / compressedSize
+                << "x smaller), PSNR " << getPsnr(image, decoded) << " dB"
+                << std::endl;
+    }
   } else {
     std::cout << "Unknown texture mode" << std::endl;
     return 1;